@@ -1,6 +1,8 @@
 #include "config.h"
 #include <Arduino.h>
 #include <WiFi.h>
+#include "profiler.h"
+#include "log.h"
 
 Config* Config::s_instance = nullptr;
 
@@ -9,10 +11,12 @@ Config::Config()
 {
     s_instance = this;
 
+    load();
+
     // if no LED brightness setting, set default
     if (getLedBrightness() == 0)
     {
-        Serial.println("[CONFIG] Setting default brightness");
+        LOG_INFO("CONFIG", "Setting default brightness");
         setLedBrightness(m_defaultLedBrightness);
     }
 
@@ -20,117 +24,270 @@ Config::Config()
     if (getFriendlyName() == "")
     {
         // get the default friendly name
-        Serial.println("[CONFIG] Setting default friendly name");
+        LOG_INFO("CONFIG", "Setting default friendly name");
         setFriendlyName(getHostName());
     }
+
+    // defaults are stored right away
+    commit();
+}
+
+// reads every setting once, getters are served from RAM afterwards
+void Config::load()
+{
+    PROFILE_SCOPE(Profiler::CONFIG_LOAD);
+
+    m_preferences.begin("general", true);
+    m_settings.ledBrightness = m_preferences.getInt("brightness", 0);
+    m_settings.friendlyName = m_preferences.getString("friendly_name", "");
+    m_preferences.end();
+
+    m_preferences.begin("wifi", true);
+    m_settings.wifiSsid = m_preferences.getString("ssid", "");
+    m_settings.wifiPassword = m_preferences.getString("password", "");
+    m_preferences.end();
+    m_stored = m_settings;
+
+    // the MAC doesn't change, neither does the hostname
+    char dockHostName[] = "YIO-Dock-xxxxxxxxxxxx";
+    uint8_t baseMac[6];
+    esp_read_mac(baseMac, ESP_MAC_WIFI_STA);
+    sprintf(dockHostName, "YIO-Dock-%02X%02X%02X%02X%02X%02X", baseMac[0], baseMac[1], baseMac[2], baseMac[3], baseMac[4], baseMac[5]);
+    m_hostName = dockHostName;
 }
 
 // getter and setter for brightness value
 int Config::getLedBrightness()
 {
-    m_preferences.begin("general", false);
-    int led_brightness = m_preferences.getInt("brightness", 0);
-    m_preferences.end();
-    
-    return led_brightness;
+    PROFILE_SCOPE(Profiler::CONFIG_READ);
+    return m_settings.ledBrightness;
 }
 
 void Config::setLedBrightness(int value)
 {
-    m_preferences.begin("general", false);
-    m_preferences.putInt("brightness", value);
-    m_preferences.end();
+    bool changed = m_settings.ledBrightness != value;
+    m_settings.ledBrightness = value;
+    markDirty(KEY_LED_BRIGHTNESS, changed, m_stored.ledBrightness == value);
 }
 
 // getter and setter for dock friendly name
 String Config::getFriendlyName()
 {
-    m_preferences.begin("general", false);
-    String friendlyName = m_preferences.getString("friendly_name", "");
-    m_preferences.end();
-
-    return friendlyName;
+    PROFILE_SCOPE(Profiler::CONFIG_READ);
+    return m_settings.friendlyName;
 }
 
 void Config::setFriendlyName(String value)
 {
-    m_preferences.begin("general", false);
-    m_preferences.putString("friendly_name", value);
-    m_preferences.end();
+    bool changed = m_settings.friendlyName != value;
+    m_settings.friendlyName = value;
+    markDirty(KEY_FRIENDLY_NAME, changed, m_stored.friendlyName == value);
 }
 
 // getter and setter for wifi credentials
 String Config::getWifiSsid()
 {
-    m_preferences.begin("wifi", false);
-    String ssid = m_preferences.getString("ssid", "");
-    m_preferences.end();
-
-    return ssid;
+    PROFILE_SCOPE(Profiler::CONFIG_READ);
+    return m_settings.wifiSsid;
 }
 
 void Config::setWifiSsid(String value)
 {
-    m_preferences.begin("wifi", false);
-    m_preferences.putString("ssid", value);
-    m_preferences.end();
+    bool changed = m_settings.wifiSsid != value;
+    m_settings.wifiSsid = value;
+    markDirty(KEY_WIFI_SSID, changed, m_stored.wifiSsid == value);
 }
 
 String Config::getWifiPassword()
 {
-    m_preferences.begin("wifi", false);
-    String password = m_preferences.getString("password", "");
-    m_preferences.end();
-
-    return password;
+    PROFILE_SCOPE(Profiler::CONFIG_READ);
+    return m_settings.wifiPassword;
 }
 
 void Config::setWifiPassword(String value)
 {
-    m_preferences.begin("wifi", false);
-    m_preferences.putString("password", value);
-    m_preferences.end();
+    bool changed = m_settings.wifiPassword != value;
+    m_settings.wifiPassword = value;
+    markDirty(KEY_WIFI_PASSWORD, changed, m_stored.wifiPassword == value);
 }
 
 // get hostname
 String Config::getHostName()
 {
-    char dockHostName[] = "YIO-Dock-xxxxxxxxxxxx";
-    uint8_t baseMac[6];
-    esp_read_mac(baseMac, ESP_MAC_WIFI_STA);
-    sprintf(dockHostName, "YIO-Dock-%02X%02X%02X%02X%02X%02X", baseMac[0], baseMac[1], baseMac[2], baseMac[3], baseMac[4], baseMac[5]);
-    return dockHostName;    
+    PROFILE_SCOPE(Profiler::CONFIG_READ);
+    return m_hostName;
+}
+
+void Config::markDirty(Key key, bool changed, bool stored)
+{
+    if (stored)
+    {
+        // back to what is in NVS, e.g. a slider dragged back and forth
+        m_dirty &= ~(1 << key);
+        m_skippedWrites++;
+        return;
+    }
+    if (!changed)
+    {
+        m_skippedWrites++;
+        return;
+    }
+
+    // every change restarts the delay, a burst of changes is written once
+    m_dirty |= 1 << key;
+    m_dirtySince = millis();
+}
+
+uint8_t Config::pendingWrites()
+{
+    uint8_t count = 0;
+    for (uint8_t key = 0; key < KEY_COUNT; key++)
+    {
+        count += (m_dirty >> key) & 1;
+    }
+    return count;
+}
+
+const char* Config::keyName(Key key)
+{
+    switch (key)
+    {
+    case KEY_LED_BRIGHTNESS:
+        return "brightness";
+    case KEY_FRIENDLY_NAME:
+        return "friendly_name";
+    case KEY_WIFI_SSID:
+        return "ssid";
+    case KEY_WIFI_PASSWORD:
+        return "password";
+    default:
+        return "unknown";
+    }
+}
+
+void Config::loop()
+{
+    if (m_dirty != 0 && millis() - m_dirtySince >= kCommitDelay)
+    {
+        commit();
+    }
+}
+
+bool Config::commit()
+{
+    if (m_dirty == 0)
+    {
+        return true;
+    }
+
+    PROFILE_SCOPE(Profiler::CONFIG_COMMIT);
+    bool success = true;
+    if (m_dirty & DIRTY_GENERAL)
+    {
+        success = commitNamespace("general", m_dirty & DIRTY_GENERAL) && success;
+    }
+    if (m_dirty & DIRTY_WIFI)
+    {
+        success = commitNamespace("wifi", m_dirty & DIRTY_WIFI) && success;
+    }
+    return success;
+}
+
+// all changed keys of a namespace in one NVS commit, Preferences commits every put
+bool Config::commitNamespace(const char* name, uint8_t fields)
+{
+    nvs_handle handle;
+    if (nvs_open(name, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        LOG_ERROR("CONFIG", "Failed to open %s", name);
+        return false;
+    }
+
+    esp_err_t err = ESP_OK;
+    uint8_t written = 0;
+    if (err == ESP_OK && (fields & DIRTY_LED_BRIGHTNESS))
+    {
+        err = nvs_set_i32(handle, keyName(KEY_LED_BRIGHTNESS), m_settings.ledBrightness);
+        written |= DIRTY_LED_BRIGHTNESS;
+    }
+    if (err == ESP_OK && (fields & DIRTY_FRIENDLY_NAME))
+    {
+        err = nvs_set_str(handle, keyName(KEY_FRIENDLY_NAME), m_settings.friendlyName.c_str());
+        written |= DIRTY_FRIENDLY_NAME;
+    }
+    if (err == ESP_OK && (fields & DIRTY_WIFI_SSID))
+    {
+        err = nvs_set_str(handle, keyName(KEY_WIFI_SSID), m_settings.wifiSsid.c_str());
+        written |= DIRTY_WIFI_SSID;
+    }
+    if (err == ESP_OK && (fields & DIRTY_WIFI_PASSWORD))
+    {
+        err = nvs_set_str(handle, keyName(KEY_WIFI_PASSWORD), m_settings.wifiPassword.c_str());
+        written |= DIRTY_WIFI_PASSWORD;
+    }
+    for (uint8_t key = 0; key < KEY_COUNT; key++)
+    {
+        if (written & (1 << key))
+        {
+            m_keyWrites[key]++;
+            m_nvsWrites++;
+        }
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    if (err != ESP_OK)
+    {
+        // stays dirty, the next loop tries again
+        LOG_ERROR("CONFIG", "Failed to write %s: %d", name, err);
+        m_dirtySince = millis();
+        return false;
+    }
+
+    m_nvsCommits++;
+    m_dirty &= ~fields;
+    if (fields & DIRTY_LED_BRIGHTNESS) m_stored.ledBrightness = m_settings.ledBrightness;
+    if (fields & DIRTY_FRIENDLY_NAME) m_stored.friendlyName = m_settings.friendlyName;
+    if (fields & DIRTY_WIFI_SSID) m_stored.wifiSsid = m_settings.wifiSsid;
+    if (fields & DIRTY_WIFI_PASSWORD) m_stored.wifiPassword = m_settings.wifiPassword;
+    return true;
 }
 
 // reset config to defaults
 void Config::reset()
 {
-    Serial.println("[CONFIG] Resetting configuration.");
+    LOG_INFO("CONFIG", "Resetting configuration.");
+
+    // nothing pending may be written back after the erase
+    m_dirty = 0;
 
-    Serial.println("[CONFIG] Resetting general.");
+    LOG_INFO("CONFIG", "Resetting general.");
     m_preferences.begin("general", false);
     m_preferences.clear();
     m_preferences.end();
 
-    Serial.println("[CONFIG] Resetting general done.");
+    LOG_INFO("CONFIG", "Resetting general done.");
 
     delay(500);
 
-    Serial.println("[CONFIG] Resetting wifi.");
+    LOG_INFO("CONFIG", "Resetting wifi.");
     m_preferences.begin("wifi", false);
     m_preferences.clear();
     m_preferences.end();
 
-    Serial.println("[CONFIG] Resetting wifi done.");
+    LOG_INFO("CONFIG", "Resetting wifi done.");
 
     delay(500);
 
-    Serial.println("[CONFIG] Erasing flash.");
+    LOG_INFO("CONFIG", "Erasing flash.");
     int err;
     err = nvs_flash_init();
-    Serial.println("[CONFIG] nvs_flash_init: " + err);
+    LOG_INFO("CONFIG", "nvs_flash_init: %d", err);
     err = nvs_flash_erase();
-    Serial.println("[CONFIG] nvs_flash_erase: " + err);
+    LOG_INFO("CONFIG", "nvs_flash_erase: %d", err);
 
     delay(500);
     
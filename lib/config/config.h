@@ -5,6 +5,10 @@
 #include <nvs.h>
 #include <nvs_flash.h>
 
+// Settings are read from NVS once at boot and served from RAM.
+// Setters only change the cached value, changed values are written back together
+// once no setter was called for kCommitDelay ms, or right away with commit().
+// A value set back to what NVS holds isn't written at all.
 class Config
 {
 public:
@@ -30,9 +34,33 @@ public:
     // get hostname
     String      getHostName();
 
+    // writes changed settings once they settled
+    void        loop();
+    // writes changed settings now, one NVS commit per namespace
+    bool        commit();
+
     // reset config to defaults
     void        reset();
 
+    enum Key {
+        KEY_LED_BRIGHTNESS      =   0,
+        KEY_FRIENDLY_NAME,
+        KEY_WIFI_SSID,
+        KEY_WIFI_PASSWORD,
+        KEY_COUNT
+    };
+
+    static const char*  keyName(Key key);
+
+    // NVS values written and commits done since boot
+    uint32_t    nvsWrites() { return m_nvsWrites; }
+    uint32_t    nvsCommits() { return m_nvsCommits; }
+    uint32_t    keyWrites(Key key) { return m_keyWrites[key]; }
+    // setter calls that didn't need a write, the value was already set or stored
+    uint32_t    skippedWrites() { return m_skippedWrites; }
+    // keys waiting for the next commit
+    uint8_t     pendingWrites();
+
     static Config*           getInstance()
     { return s_instance; }
 
@@ -41,10 +69,45 @@ public:
     const String    token = "0";
 
 private:
+    // a bit per Key
+    enum Dirty {
+        DIRTY_LED_BRIGHTNESS    =   1 << KEY_LED_BRIGHTNESS,
+        DIRTY_FRIENDLY_NAME     =   1 << KEY_FRIENDLY_NAME,
+        DIRTY_WIFI_SSID         =   1 << KEY_WIFI_SSID,
+        DIRTY_WIFI_PASSWORD     =   1 << KEY_WIFI_PASSWORD,
+        DIRTY_GENERAL           =   DIRTY_LED_BRIGHTNESS | DIRTY_FRIENDLY_NAME,
+        DIRTY_WIFI              =   DIRTY_WIFI_SSID | DIRTY_WIFI_PASSWORD
+    };
+
+    // the stored settings
+    struct Settings {
+        int             ledBrightness;      // "general" namespace
+        String          friendlyName;
+        String          wifiSsid;           // "wifi" namespace
+        String          wifiPassword;
+    };
+
+    static const uint32_t kCommitDelay = 2000;
+
     Preferences     m_preferences;
     int             m_defaultLedBrightness = 50;
 
+    Settings        m_settings;
+    Settings        m_stored;           // what NVS holds
+    String          m_hostName;
+    uint8_t         m_dirty = 0;
+    unsigned long   m_dirtySince = 0;
+    uint32_t        m_nvsWrites = 0;
+    uint32_t        m_nvsCommits = 0;
+    uint32_t        m_keyWrites[KEY_COUNT] = {};
+    uint32_t        m_skippedWrites = 0;
+
+    void            load();
+    // records a setter call, field is only written when it differs from what NVS holds
+    void            markDirty(Key key, bool changed, bool stored);
+    bool            commitNamespace(const char* name, uint8_t fields);
+
     static Config*  s_instance;
 };
 
-#endif
\ No newline at end of file
+#endif
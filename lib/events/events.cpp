@@ -0,0 +1,56 @@
+#include "events.h"
+
+EventGroupHandle_t Events::s_group = nullptr;
+
+void Events::init()
+{
+    if (s_group == nullptr)
+    {
+        s_group = xEventGroupCreate();
+    }
+}
+
+void Events::post(EventBits_t bits)
+{
+    if (s_group != nullptr)
+    {
+        xEventGroupSetBits(s_group, bits);
+    }
+}
+
+void IRAM_ATTR Events::postFromISR(EventBits_t bits)
+{
+    if (s_group == nullptr)
+    {
+        return;
+    }
+    BaseType_t woken = pdFALSE;
+    // deferred to the timer service task, the main loop wakes right after the ISR
+    if (xEventGroupSetBitsFromISR(s_group, bits, &woken) == pdPASS && woken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+EventBits_t Events::wait(TickType_t timeout)
+{
+    if (s_group == nullptr)
+    {
+        vTaskDelay(timeout);
+        return 0;
+    }
+    return xEventGroupWaitBits(s_group, EVENT_ALL, pdTRUE, pdFALSE, timeout) & EVENT_ALL;
+}
+
+bool Events::every(const char* name, uint32_t period, EventBits_t bits)
+{
+    // the bits ride along as the timer id
+    TimerHandle_t timer = xTimerCreate(name, pdMS_TO_TICKS(period), pdTRUE,
+                                       reinterpret_cast<void*>(static_cast<uintptr_t>(bits)), &Events::timerCallback);
+    return timer != nullptr && xTimerStart(timer, 0) == pdPASS;
+}
+
+void Events::timerCallback(TimerHandle_t timer)
+{
+    post(static_cast<EventBits_t>(reinterpret_cast<uintptr_t>(pvTimerGetTimerID(timer))));
+}
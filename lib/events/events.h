@@ -0,0 +1,41 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <Arduino.h>
+#include <freertos/event_groups.h>
+#include <freertos/timers.h>
+
+// Wakes the main loop when a service has work, instead of polling every service continuously.
+// Services, ISRs and timers set bits, the main loop waits for them and handles what is set.
+class Events
+{
+public:
+    enum Bits {
+        EVENT_WIFI          =   1 << 0,     // WiFi event or reconnect check due
+        EVENT_MDNS          =   1 << 1,     // WiFi got an address or an mDNS retry is due
+        EVENT_API           =   1 << 2,     // IR codes, send results or a learning result for the API
+        EVENT_CHARGING      =   1 << 3,     // charging pin changed
+        EVENT_BUTTON        =   1 << 4,     // button released
+        EVENT_STATE         =   1 << 5,     // the dock state changed
+        EVENT_BLUETOOTH     =   1 << 6,     // data from the bluetooth setup client
+        EVENT_ALL           =   (1 << 7) - 1
+    };
+
+    static void             init();
+
+    static void             post(EventBits_t bits);
+    static void             postFromISR(EventBits_t bits);
+
+    // blocks until a bit is set or the timeout passed, returns and clears the set bits
+    static EventBits_t      wait(TickType_t timeout);
+
+    // posts bits every period ms, from a FreeRTOS timer
+    static bool             every(const char* name, uint32_t period, EventBits_t bits);
+
+private:
+    static EventGroupHandle_t s_group;
+
+    static void             timerCallback(TimerHandle_t timer);
+};
+
+#endif
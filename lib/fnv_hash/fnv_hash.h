@@ -0,0 +1,35 @@
+#ifndef FNV_HASH_H
+#define FNV_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 32 bit FNV-1a, for keying lookup tables by short strings.
+// Both forms give the same hash for the same characters.
+
+static const uint32_t kFnvOffset = 2166136261u;
+static const uint32_t kFnvPrime = 16777619u;
+
+constexpr uint32_t fnvHashStep(const char* str, uint32_t hash)
+{
+    return *str ? fnvHashStep(str + 1, (hash ^ static_cast<uint8_t>(*str)) * kFnvPrime) : hash;
+}
+
+// usable at compile time, for constant keys only: it recurses once per character
+constexpr uint32_t fnvHash(const char* str)
+{
+    return fnvHashStep(str, kFnvOffset);
+}
+
+// iterative, for runtime input of any length
+inline uint32_t fnvHash(const char* data, size_t length)
+{
+    uint32_t hash = kFnvOffset;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * kFnvPrime;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef FRAME_PARSER_H
+#define FRAME_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Cuts JSON objects out of a byte stream that arrives in arbitrary pieces, for the
+// transports without message framing of their own (serial and bluetooth).
+// Braces are counted outside of strings only, so nested objects and braces or escaped
+// quotes inside string values don't end a frame. Bytes between frames are skipped.
+// A complete frame stays in the buffer, null terminated, until the next push, so it can
+// be deserialized in place.
+// Frames may span lines, pretty-printed or typed into a terminal. A pause longer than the idle
+// timeout drops a frame that isn't complete yet, so a truncated frame can't swallow the next
+// one, and so does a newline inside a string, which JSON doesn't allow. A frame that doesn't
+// fit is dropped and skipped up to its closing brace.
+template <size_t N>
+class FrameParser
+{
+    static_assert(N > 2, "FrameParser needs room for a frame");
+
+public:
+    // idleTimeout in ms, 0 waits for the rest of a frame forever
+    explicit FrameParser(uint32_t idleTimeout = 0) : m_idleTimeout(idleTimeout) {}
+
+    // true when this byte completed a frame, now is millis()
+    bool push(uint8_t byte, uint32_t now)
+    {
+        if (m_complete)
+        {
+            m_complete = false;
+            m_length = 0;
+        }
+
+        if (m_idleTimeout > 0 && m_depth > 0 && now - m_lastByteAt > m_idleTimeout)
+        {
+            truncate();
+        }
+        m_lastByteAt = now;
+
+        char c = static_cast<char>(byte);
+        if (m_depth == 0)
+        {
+            if (c != '{')
+            {
+                return false;
+            }
+            m_inString = false;
+            m_escape = false;
+        }
+
+        if (m_inString)
+        {
+            if (c == '\n')
+            {
+                // the sender broke off in the middle of a value
+                truncate();
+                return false;
+            }
+            if (m_escape)
+            {
+                m_escape = false;
+            }
+            else if (c == '\\')
+            {
+                m_escape = true;
+            }
+            else if (c == '"')
+            {
+                m_inString = false;
+            }
+        }
+        else if (c == '"')
+        {
+            m_inString = true;
+        }
+        else if (c == '{')
+        {
+            m_depth++;
+        }
+        else if (c == '}')
+        {
+            m_depth--;
+        }
+
+        if (m_skip)
+        {
+            m_skip = m_depth > 0;
+            return false;
+        }
+
+        // one byte stays free for the terminator
+        if (m_length == N - 1)
+        {
+            m_dropped++;
+            m_length = 0;
+            m_skip = m_depth > 0;
+            return false;
+        }
+        m_buffer[m_length++] = c;
+
+        if (m_depth > 0)
+        {
+            return false;
+        }
+        m_buffer[m_length] = '\0';
+        m_complete = true;
+        return true;
+    }
+
+    // the complete frame, valid until the next push
+    char*       frame() { return m_buffer; }
+    size_t      length() const { return m_length; }
+
+    // frames dropped because they were too long
+    uint32_t    dropped() const { return m_dropped; }
+    // frames dropped because a pause or a newline in a string cut them short
+    uint32_t    truncated() const { return m_truncated; }
+
+    // forgets a partial frame, e.g. when the peer disconnects
+    void reset()
+    {
+        m_depth = 0;
+        m_length = 0;
+        m_complete = false;
+        m_skip = false;
+    }
+
+private:
+    char        m_buffer[N];
+    size_t      m_length = 0;
+    uint32_t    m_depth = 0;
+    uint32_t    m_dropped = 0;
+    uint32_t    m_truncated = 0;
+    uint32_t    m_idleTimeout;
+    uint32_t    m_lastByteAt = 0;
+    bool        m_inString = false;
+    bool        m_escape = false;
+    bool        m_skip = false;         // the rest of a frame that didn't fit
+    bool        m_complete = false;
+
+    void truncate()
+    {
+        // a skipped frame is counted as dropped already
+        if (m_depth > 0 && !m_skip)
+        {
+            m_truncated++;
+        }
+        m_depth = 0;
+        m_length = 0;
+        m_skip = false;
+    }
+};
+
+#endif
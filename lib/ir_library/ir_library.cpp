@@ -0,0 +1,472 @@
+#include "ir_library.h"
+#include "log.h"
+
+IrLibrary* IrLibrary::s_instance = nullptr;
+
+IrLibrary::IrLibrary()
+{
+    s_instance = this;
+}
+
+bool IrLibrary::init()
+{
+    if (!SPIFFS.begin(true))
+    {
+        LOG_ERROR("IRLIB", "Failed to mount SPIFFS");
+        return false;
+    }
+    m_mounted = true;
+
+    recover();
+    if (!m_mounted)
+    {
+        return false;
+    }
+
+    File file = SPIFFS.open(kPath, FILE_READ);
+    if (!file)
+    {
+        LOG_INFO("IRLIB", "No stored codes");
+        return true;
+    }
+
+    // rebuild the index, a record written twice for an id means the later one wins
+    size_t size = file.size();
+    uint32_t offset = 0;
+    bool clean = true;
+
+    while (offset + sizeof(RecordHeader) <= size)
+    {
+        RecordHeader header;
+        if (!readHeader(file, offset, header))
+        {
+            clean = false;
+            break;
+        }
+
+        uint32_t recordSize = sizeof(header) + header.nameLength + header.payloadLength;
+        if (offset + recordSize > size)
+        {
+            clean = false;
+            break;
+        }
+
+        char name[kMaxNameLength];
+        file.read(reinterpret_cast<uint8_t*>(name), header.nameLength);
+        Entry entry = { header.id, offset, fnvHash(name, header.nameLength) };
+
+        int existing = indexOf(header.id);
+        if (existing >= 0)
+        {
+            m_index[existing] = entry;
+            clean = false;
+        }
+        else if (m_count < kMaxCodes)
+        {
+            insert(entry);
+        }
+        else
+        {
+            clean = false;
+        }
+        offset += recordSize;
+    }
+
+    if (offset != size)
+    {
+        clean = false;
+    }
+    file.close();
+
+    // drop stale and truncated records
+    if (!clean)
+    {
+        LOG_INFO("IRLIB", "Compacting code file");
+        compact(0);
+    }
+
+    LOG_INFO("IRLIB", "%u codes loaded", m_count);
+    return true;
+}
+
+uint32_t IrLibrary::store(uint32_t id, const char* name, InfraredService::IrCommand& command)
+{
+    if (!m_mounted)
+    {
+        return 0;
+    }
+
+    if (name == nullptr)
+    {
+        name = "";
+    }
+    size_t nameLength = strnlen(name, kMaxNameLength + 1);
+    if (nameLength > kMaxNameLength)
+    {
+        return 0;
+    }
+
+    // pronto codes are decoded once, here
+    if (command.type == InfraredService::IrCommand::TYPE_PRONTO && !InfraredService::prontoToRaw(command))
+    {
+        return 0;
+    }
+
+    // a second code under a name replaces the first, findByName can only ever return one
+    uint32_t named = nameLength > 0 ? findByName(name) : 0;
+    if (id == 0)
+    {
+        id = named;
+    }
+    else if (named != 0 && named != id)
+    {
+        LOG_WARN("IRLIB", "Name %s is taken by code %u", name, named);
+        return 0;
+    }
+
+    if (id == 0)
+    {
+        id = m_count > 0 ? m_index[m_count - 1].id + 1 : 1;
+    }
+    int existing = indexOf(id);
+    if (existing < 0 && m_count >= kMaxCodes)
+    {
+        return 0;
+    }
+
+    // the old record stays until the new one is written, the later one wins when the index is rebuilt
+    int32_t offset = append(id, name, nameLength, command);
+    if (offset < 0)
+    {
+        // partition full, compacting cuts the partial record off and frees stale ones
+        LOG_WARN("IRLIB", "Failed to write code, compacting");
+        if (!compact(0))
+        {
+            return 0;
+        }
+        existing = indexOf(id);
+        offset = append(id, name, nameLength, command);
+        if (offset < 0)
+        {
+            LOG_ERROR("IRLIB", "Failed to write code");
+            compact(0);
+            return 0;
+        }
+    }
+
+    Entry entry = { id, static_cast<uint32_t>(offset), fnvHash(name, nameLength) };
+    if (existing >= 0)
+    {
+        m_index[existing] = entry;
+    }
+    else
+    {
+        insert(entry);
+    }
+    return id;
+}
+
+bool IrLibrary::remove(uint32_t id)
+{
+    if (indexOf(id) < 0)
+    {
+        return false;
+    }
+    return compact(id);
+}
+
+bool IrLibrary::load(uint32_t id, InfraredService::IrCommand& command)
+{
+    int index = indexOf(id);
+    if (index < 0)
+    {
+        return false;
+    }
+
+    File file = SPIFFS.open(kPath, FILE_READ);
+    RecordHeader header;
+    if (!file || !readHeader(file, m_index[index].offset, header))
+    {
+        return false;
+    }
+    file.seek(m_index[index].offset + sizeof(header) + header.nameLength);
+
+    if (header.type == InfraredService::IrCommand::TYPE_HEX)
+    {
+        HexPayload payload;
+        if (file.read(reinterpret_cast<uint8_t*>(&payload), sizeof(payload)) != sizeof(payload))
+        {
+            return false;
+        }
+        command.type = InfraredService::IrCommand::TYPE_HEX;
+        command.protocol = static_cast<decode_type_t>(payload.protocol);
+        command.bits = payload.bits;
+        command.repeat = payload.repeat;
+        command.value = payload.value;
+        return true;
+    }
+
+    RawPayload payload;
+    if (file.read(reinterpret_cast<uint8_t*>(&payload), sizeof(payload)) != sizeof(payload)
+        || payload.count > InfraredService::kMaxCodeWords
+        || payload.onceCount > payload.count)
+    {
+        return false;
+    }
+    size_t timingsSize = payload.count * sizeof(uint16_t);
+    if (file.read(reinterpret_cast<uint8_t*>(command.words), timingsSize) != timingsSize)
+    {
+        return false;
+    }
+    command.type = InfraredService::IrCommand::TYPE_RAW;
+    command.frequency = payload.frequency;
+    command.onceCount = payload.onceCount;
+    command.count = payload.count;
+    command.repeat = payload.repeat;
+    return true;
+}
+
+uint32_t IrLibrary::findByName(const char* name)
+{
+    if (name == nullptr)
+    {
+        return 0;
+    }
+    size_t nameLength = strnlen(name, kMaxNameLength + 1);
+    if (nameLength > kMaxNameLength)
+    {
+        return 0;
+    }
+    uint32_t hash = fnvHash(name, nameLength);
+
+    for (uint16_t i = 0; i < m_count; i++)
+    {
+        Info candidate;
+        if (m_index[i].nameHash == hash && info(i, candidate) && strcmp(candidate.name, name) == 0)
+        {
+            return candidate.id;
+        }
+    }
+    return 0;
+}
+
+bool IrLibrary::info(uint16_t index, Info& info)
+{
+    if (index >= m_count)
+    {
+        return false;
+    }
+
+    File file = SPIFFS.open(kPath, FILE_READ);
+    RecordHeader header;
+    if (!file || !readHeader(file, m_index[index].offset, header))
+    {
+        return false;
+    }
+
+    info.id = header.id;
+    info.type = header.type;
+    size_t read = file.read(reinterpret_cast<uint8_t*>(info.name), header.nameLength);
+    info.name[read] = '\0';
+    return true;
+}
+
+int IrLibrary::indexOf(uint32_t id)
+{
+    int low = 0;
+    int high = m_count - 1;
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+        if (m_index[middle].id == id)
+        {
+            return middle;
+        }
+        if (m_index[middle].id < id)
+        {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
+
+void IrLibrary::insert(const Entry& entry)
+{
+    uint16_t position = m_count;
+    while (position > 0 && m_index[position - 1].id > entry.id)
+    {
+        m_index[position] = m_index[position - 1];
+        position--;
+    }
+    m_index[position] = entry;
+    m_count++;
+}
+
+bool IrLibrary::readHeader(File& file, uint32_t offset, RecordHeader& header)
+{
+    if (!file.seek(offset)
+        || file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header))
+    {
+        return false;
+    }
+    return header.magic == kRecordMagic
+        && header.nameLength <= kMaxNameLength
+        && (header.type == InfraredService::IrCommand::TYPE_HEX || header.type == InfraredService::IrCommand::TYPE_RAW);
+}
+
+int32_t IrLibrary::append(uint32_t id, const char* name, uint8_t nameLength, const InfraredService::IrCommand& command)
+{
+    File file = SPIFFS.open(kPath, FILE_APPEND);
+    if (!file)
+    {
+        return -1;
+    }
+    int32_t offset = file.size();
+
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.type = command.type;
+    header.nameLength = nameLength;
+    header.id = id;
+
+    size_t expected;
+    size_t written;
+
+    if (command.type == InfraredService::IrCommand::TYPE_HEX)
+    {
+        HexPayload payload;
+        payload.protocol = command.protocol;
+        payload.bits = command.bits;
+        payload.repeat = command.repeat;
+        payload.value = command.value;
+        header.payloadLength = sizeof(payload);
+
+        expected = sizeof(header) + nameLength + sizeof(payload);
+        written = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        written += file.write(reinterpret_cast<const uint8_t*>(name), nameLength);
+        written += file.write(reinterpret_cast<const uint8_t*>(&payload), sizeof(payload));
+    }
+    else
+    {
+        RawPayload payload;
+        payload.frequency = command.frequency;
+        payload.onceCount = command.onceCount;
+        payload.count = command.count;
+        payload.repeat = command.repeat;
+        size_t timingsSize = command.count * sizeof(uint16_t);
+        header.payloadLength = sizeof(payload) + timingsSize;
+
+        expected = sizeof(header) + nameLength + sizeof(payload) + timingsSize;
+        written = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+        written += file.write(reinterpret_cast<const uint8_t*>(name), nameLength);
+        written += file.write(reinterpret_cast<const uint8_t*>(&payload), sizeof(payload));
+        written += file.write(reinterpret_cast<const uint8_t*>(command.words), timingsSize);
+    }
+    file.close();
+
+    return written == expected ? offset : -1;
+}
+
+bool IrLibrary::compact(uint32_t skipId)
+{
+    File in = SPIFFS.open(kPath, FILE_READ);
+    File out = SPIFFS.open(kTempPath, FILE_WRITE);
+    if (!out)
+    {
+        return false;
+    }
+
+    // offsets only change once the new file is in place
+    uint32_t offsets[kMaxCodes];
+    bool kept[kMaxCodes];
+    uint32_t offset = 0;
+    uint8_t buffer[64];
+
+    for (uint16_t i = 0; i < m_count; i++)
+    {
+        kept[i] = false;
+        RecordHeader header;
+        if (m_index[i].id == skipId || !in || !readHeader(in, m_index[i].offset, header))
+        {
+            continue;
+        }
+
+        size_t remaining = sizeof(header) + header.nameLength + header.payloadLength;
+        offsets[i] = offset;
+        offset += remaining;
+
+        in.seek(m_index[i].offset);
+        while (remaining > 0)
+        {
+            size_t chunk = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+            if (in.read(buffer, chunk) != chunk || out.write(buffer, chunk) != chunk)
+            {
+                in.close();
+                out.close();
+                SPIFFS.remove(kTempPath);
+                return false;
+            }
+            remaining -= chunk;
+        }
+        kept[i] = true;
+    }
+
+    if (in)
+    {
+        in.close();
+    }
+    out.close();
+
+    // a reset between the remove and the rename leaves only the new file, init() promotes it
+    if (SPIFFS.exists(kPath) && !SPIFFS.remove(kPath))
+    {
+        SPIFFS.remove(kTempPath);
+        return false;
+    }
+    if (!SPIFFS.rename(kTempPath, kPath))
+    {
+        // the codes are only in the new file now, stop writing until init() gets to recover them
+        LOG_ERROR("IRLIB", "Failed to replace code file");
+        m_mounted = false;
+        m_count = 0;
+        return false;
+    }
+
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < m_count; i++)
+    {
+        if (kept[i])
+        {
+            m_index[count] = m_index[i];
+            m_index[count].offset = offsets[i];
+            count++;
+        }
+    }
+    m_count = count;
+    return true;
+}
+
+void IrLibrary::recover()
+{
+    if (!SPIFFS.exists(kTempPath))
+    {
+        return;
+    }
+
+    // the old file is only removed once the new one is complete
+    if (SPIFFS.exists(kPath))
+    {
+        LOG_INFO("IRLIB", "Dropping unfinished compaction");
+        SPIFFS.remove(kTempPath);
+        return;
+    }
+
+    LOG_INFO("IRLIB", "Finishing compaction");
+    if (!SPIFFS.rename(kTempPath, kPath))
+    {
+        LOG_ERROR("IRLIB", "Failed to restore code file");
+        m_mounted = false;
+    }
+}
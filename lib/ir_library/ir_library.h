@@ -0,0 +1,99 @@
+#ifndef IR_LIBRARY_H
+#define IR_LIBRARY_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <service_ir.h>
+#include <fnv_hash.h>
+
+// IR codes stored on the SPIFFS partition, so clients can send them by id.
+// Codes are appended to one file as binary records, an index in RAM maps ids to file offsets.
+// Pronto codes are stored as raw timings and don't need decoding when they are sent.
+class IrLibrary
+{
+public:
+    explicit IrLibrary();
+    virtual ~IrLibrary() {}
+
+    static IrLibrary*           getInstance() { return s_instance; }
+
+    static const uint16_t       kMaxCodes = 128;
+    static const uint8_t        kMaxNameLength = 32;
+
+    // what ir_list reports for a code
+    struct Info {
+        uint32_t                id;
+        uint8_t                 type;       // InfraredService::IrCommand::Type
+        char                    name[kMaxNameLength + 1];
+    };
+
+    // mounts SPIFFS and builds the index
+    bool                        init();
+
+    // stores the code under id, replacing an existing one; id 0 picks a free id, or the id of
+    // the code with the same name, which it replaces. Names are unique, a name in use by
+    // another id is refused.
+    // returns the id, or 0 when the code couldn't be stored, the name is too long or taken
+    uint32_t                    store(uint32_t id, const char* name, InfraredService::IrCommand& command);
+    bool                        remove(uint32_t id);
+    // fills the code fields of command, the scheduling fields are left alone
+    bool                        load(uint32_t id, InfraredService::IrCommand& command);
+    // 0 when there is no code with that name
+    uint32_t                    findByName(const char* name);
+
+    uint16_t                    count() { return m_count; }
+    bool                        info(uint16_t index, Info& info);
+
+private:
+    static IrLibrary*           s_instance;
+
+    struct __attribute__((packed)) RecordHeader {
+        uint16_t                magic;
+        uint8_t                 type;
+        uint8_t                 nameLength;
+        uint32_t                id;
+        uint16_t                payloadLength;
+    };
+
+    struct __attribute__((packed)) HexPayload {
+        int16_t                 protocol;
+        uint16_t                bits;
+        uint16_t                repeat;
+        uint64_t                value;
+    };
+
+    // followed by count 16 bit timings
+    struct __attribute__((packed)) RawPayload {
+        uint16_t                frequency;
+        uint16_t                onceCount;
+        uint16_t                count;
+        uint16_t                repeat;
+    };
+
+    struct Entry {
+        uint32_t                id;
+        uint32_t                offset;
+        uint32_t                nameHash;
+    };
+
+    static const uint16_t       kRecordMagic = 0x4952;   // "IR"
+    const char*                 kPath = "/ircodes.bin";
+    const char*                 kTempPath = "/ircodes.tmp";
+
+    Entry                       m_index[kMaxCodes];     // sorted by id
+    uint16_t                    m_count = 0;
+    bool                        m_mounted = false;
+
+    int                         indexOf(uint32_t id);
+    void                        insert(const Entry& entry);
+    bool                        readHeader(File& file, uint32_t offset, RecordHeader& header);
+    // appends one record, returns its offset or -1
+    int32_t                     append(uint32_t id, const char* name, uint8_t nameLength, const InfraredService::IrCommand& command);
+    // rewrites the file with the indexed records only, minus the one with skipId
+    bool                        compact(uint32_t skipId);
+    // finishes or rolls back a compaction cut short by a reset
+    void                        recover();
+};
+
+#endif
@@ -6,8 +6,17 @@ LedControl* LedControl::s_instance = nullptr;
 LedControl::LedControl()
 {
   s_instance = this;
-  
-  xTaskCreatePinnedToCore(&LedControl::loopTask, "LedTask", 10000, this, 1, &m_ledTask, 0);
+
+  // the eye sees duty^(1/2.2), so levels map to level^2.2
+  const uint32_t maxDuty = (1 << kResolution) - 1;
+  for (int i = 0; i < 256; i++)
+  {
+    m_gamma[i] = static_cast<uint16_t>(powf(i / 255.0f, 2.2f) * maxDuty + 0.5f);
+  }
+
+  // core 1, away from WiFi; the task only holds a few locals and logs state changes
+  xTaskCreatePinnedToCore(&LedControl::loopTask, "LedTask", 3072, this, 1, &m_ledTask, 1);
+  State::getInstance()->subscribe(m_ledTask);
 }
 
 void LedControl::loopTask(void *pvParameter)
@@ -16,100 +25,213 @@ void LedControl::loopTask(void *pvParameter)
 	led->loop();
 }
 
+void LedControl::refresh()
+{
+  if (m_ledTask != nullptr)
+  {
+    xTaskNotifyGive(m_ledTask);
+  }
+}
+
 void LedControl::loop()
 {
-    // LED setup
-  pinMode(m_ledGPIO, OUTPUT);
+  // LED setup
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = m_ledMode;
+  timer.duty_resolution = static_cast<ledc_timer_bit_t>(kResolution);
+  timer.timer_num = LEDC_TIMER_0;
+  timer.freq_hz = m_ledPWMFreq;
+  ledc_timer_config(&timer);
 
-  ledcSetup(m_ledChannel, m_ledPWMFreq, m_ledResolution);
-  ledcAttachPin(m_ledGPIO, m_ledChannel);
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = m_ledGPIO;
+  channel.speed_mode = m_ledMode;
+  channel.channel = m_ledChannel;
+  channel.intr_type = LEDC_INTR_DISABLE;
+  channel.timer_sel = LEDC_TIMER_0;
+  channel.duty = 0;
+  ledc_channel_config(&channel);
+  ledc_fade_func_install(0);
+
+  loadPattern();
 
   while (1)
   {
-    vTaskDelay(2 / portTICK_PERIOD_MS);
+    TickType_t wait = step();
+    if (wait == 0)
+    {
+      continue;
+    }
 
-    // if the remote is charging, pulsate the LED
-    // normal operation, LED off, turns on when charging
-    if (State::getInstance()->currentState == State::NORMAL_CHARGING)
+    // a state change or refresh cuts the pattern short
+    if (ulTaskNotifyTake(pdTRUE, wait) > 0)
     {
-      m_ledMapDelay = map(m_ledMaxBrightness, 5, 255, 30, 5);
-      m_ledMapPause = map(m_ledMaxBrightness, 5, 255, 800, 0);
+      loadPattern();
+    }
+  }
+}
 
-      for (int dutyCycle = 0; dutyCycle <= m_ledMaxBrightness; dutyCycle++)
-      {
-        // changing the LED brightness with PWM
-        ledcWrite(m_ledChannel, dutyCycle);
-        delay(m_ledMapDelay);
-      }
+void LedControl::loadPattern()
+{
+  int current = State::getInstance()->get();
+  bool changed = current != m_state;
+  m_state = current;
 
-      delay(m_ledMapPause);
+  uint16_t level = m_ledMaxBrightness;
+  uint16_t stepDelay = map(m_ledMaxBrightness, 5, 255, 30, 5);
+  uint16_t pause = map(m_ledMaxBrightness, 5, 255, 800, 0);
+  uint16_t breathe = level * stepDelay;
 
-      // decrease the LED brightness
-      for (int dutyCycle = m_ledMaxBrightness; dutyCycle >= 0; dutyCycle--)
-      {
-        // changing the LED brightness with PWM
-        ledcWrite(m_ledChannel, dutyCycle);
-        delay(m_ledMapDelay);
-      }
-      delay(1000);
-    }
-    // needs setup
-    else if (State::getInstance()->currentState == State::SETUP)
-    {
-      ledcWrite(m_ledChannel, 255);
-      delay(1000);
-      ledcWrite(m_ledChannel, 0);
-      delay(1000);
-    }
-    // connecting to wifi, turning on OTA
-    else if (State::getInstance()->currentState == State::CONNECTING)
-    {
-      ledcWrite(m_ledChannel, 255);
-      delay(200);
-      ledcWrite(m_ledChannel, 0);
-      delay(200);
-    }
-    // successful connection
-    else if (State::getInstance()->currentState == State::CONN_SUCCESS)
-    {
-      // Blink the LED 3 times to indicate successful connection
-      for (int i = 0; i < 4; i++)
-      {
-        ledcWrite(m_ledChannel, 255);
-        delay(100);
-        ledcWrite(m_ledChannel, 0);
-        delay(100);
-      }
-      State::getInstance()->currentState = State::NORMAL;
-    }
-    // LED brightness setup
-    else if (State::getInstance()->currentState == State::LED_SETUP)
+  m_repeat = true;
+  m_scaled = true;
+  uint8_t count = 0;
+  Keyframe* f = m_frames;
+
+  switch (current)
+  {
+  // if the remote is charging, pulsate the LED
+  case State::NORMAL_CHARGING:
+    f[count++] = { 255, breathe, pause };
+    f[count++] = { 0, breathe, 1000 };
+    break;
+
+  // needs setup
+  case State::SETUP:
+    m_scaled = false;
+    f[count++] = { 255, 0, 1000 };
+    f[count++] = { 0, 0, 1000 };
+    break;
+
+  // connecting to wifi, turning on OTA
+  case State::CONNECTING:
+    m_scaled = false;
+    f[count++] = { 255, 0, 200 };
+    f[count++] = { 0, 0, 200 };
+    break;
+
+  // successful connection, blink the LED to indicate it and go back to normal
+  case State::CONN_SUCCESS:
+    m_scaled = false;
+    m_repeat = false;
+    for (int i = 0; i < 4; i++)
     {
-      ledcWrite(m_ledChannel, m_ledMaxBrightness);
-      delay(100);
+      f[count++] = { 255, 0, 100 };
+      f[count++] = { 0, 0, 100 };
     }
-    // normal operation, remote fully charged
-    else if (State::getInstance()->currentState == State::NORMAL_FULLYCHARGED)
+    break;
+
+  // LED brightness setup and normal operation, remote fully charged
+  case State::LED_SETUP:
+  case State::NORMAL_FULLYCHARGED:
+    m_repeat = false;
+    f[count++] = { 255, 0, 0 };
+    break;
+
+  // normal operation, blinks to indicate remote is low battery
+  case State::NORMAL_LOWBATTERY:
+    f[count++] = { 255, 0, 100 };
+    f[count++] = { 0, 0, 100 };
+    f[count++] = { 255, 0, 100 };
+    f[count++] = { 0, 0, 4100 };
+    break;
+
+  // normal operation, LED off
+  default:
+    m_repeat = false;
+    f[count++] = { 0, 0, 0 };
+    break;
+  }
+
+  m_frameCount = count;
+  // a brightness change keeps the pattern position, a new state starts over
+  if (changed || m_frame >= m_frameCount)
+  {
+    m_frame = 0;
+  }
+  m_fading = true;
+  m_fadeFrom = m_level;
+  m_phaseStart = millis();
+}
+
+TickType_t LedControl::step()
+{
+  if (m_frame >= m_frameCount)
+  {
+    // static, sleep until refreshed
+    return portMAX_DELAY;
+  }
+
+  const Keyframe& frame = m_frames[m_frame];
+  uint32_t now = millis();
+  uint32_t elapsed = now - m_phaseStart;
+
+  if (m_fading)
+  {
+    if (elapsed < frame.fade)
     {
-      ledcWrite(m_ledChannel, m_ledMaxBrightness);
-      delay(100);
+      // the next linear piece of the gamma curve
+      uint32_t end = elapsed + kSegmentTime < frame.fade ? elapsed + kSegmentTime : frame.fade;
+      uint8_t level = m_fadeFrom + (static_cast<int32_t>(frame.level) - m_fadeFrom) * static_cast<int32_t>(end) / frame.fade;
+      output(level, end - elapsed);
+      return pdMS_TO_TICKS(end - elapsed) > 0 ? pdMS_TO_TICKS(end - elapsed) : 1;
     }
-    // normal operation, blinks to indicate remote is low battery
-    else if (State::getInstance()->currentState == State::NORMAL_LOWBATTERY)
+    output(frame.level, 0);
+    m_fading = false;
+    m_phaseStart = now;
+    elapsed = 0;
+  }
+
+  if (elapsed < frame.hold)
+  {
+    return pdMS_TO_TICKS(frame.hold - elapsed) > 0 ? pdMS_TO_TICKS(frame.hold - elapsed) : 1;
+  }
+
+  m_frame++;
+  if (m_frame >= m_frameCount)
+  {
+    if (!m_repeat)
     {
-      for (int i = 0; i < 2; i++)
+      if (m_state == State::CONN_SUCCESS)
       {
-        ledcWrite(m_ledChannel, m_ledMaxBrightness);
-        delay(100);
-        ledcWrite(m_ledChannel, 0);
-        delay(100);
+        State* state = State::getInstance();
+        state->compareAndSet(State::CONN_SUCCESS, state->idleState());
+        loadPattern();
+        return 0;
       }
-      delay(4000);
+      return portMAX_DELAY;
     }
+    m_frame = 0;
+  }
+  m_fading = true;
+  m_fadeFrom = m_level;
+  m_phaseStart = now;
+  return 0;
+}
+
+void LedControl::output(uint8_t level, uint32_t fadeTime)
+{
+  m_level = level;
+  uint8_t brightness = m_scaled ? level * m_ledMaxBrightness / 255 : level;
+  uint32_t duty = m_gamma[brightness];
+
+  if (fadeTime == 0)
+  {
+    ledc_set_duty(m_ledMode, m_ledChannel, duty);
+    ledc_update_duty(m_ledMode, m_ledChannel);
+  } else {
+    ledc_set_fade_with_time(m_ledMode, m_ledChannel, duty, fadeTime);
+    ledc_fade_start(m_ledMode, m_ledChannel, LEDC_FADE_NO_WAIT);
   }
 }
 
+void LedControl::write(uint8_t level)
+{
+  ledc_set_duty(m_ledMode, m_ledChannel, m_gamma[level]);
+  ledc_update_duty(m_ledMode, m_ledChannel);
+}
+
 void LedControl::setLedMaxBrightness(int value)
 {
-    m_ledMaxBrightness = value;
-}
\ No newline at end of file
+    m_ledMaxBrightness = constrain(value, 0, 255);
+    refresh();
+}
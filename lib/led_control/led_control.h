@@ -2,7 +2,12 @@
 #define LED_CONTROL_H
 
 #include <Arduino.h>
+#include <driver/ledc.h>
 
+// Plays a keyframe pattern per dock state on the indicator LED.
+// Fades run on the LEDC fade hardware in short gamma corrected segments, the task sleeps
+// in between and not at all while the LED is static. State changes and refresh() make it
+// pick up the new state or brightness right away, also in the middle of a pattern.
 class LedControl
 {
 public:
@@ -14,24 +19,57 @@ public:
     void setLedMaxBrightness(int value);
     int  getLedMaxBrightness() { return m_ledMaxBrightness; }
 
-    const int       m_ledChannel = 0;
+    // replays the pattern with the current settings
+    void refresh();
+
+    // sets the LED directly, for feedback outside the state patterns like a firmware upload
+    void write(uint8_t level);
+
+    // stack the LED task never touched so far, in bytes
+    uint32_t stackFree() { return m_ledTask != nullptr ? uxTaskGetStackHighWaterMark(m_ledTask) : 0; }
 
 private:
     static LedControl*           s_instance;
 
+    // fade to level in fade ms, then stay for hold ms
+    struct Keyframe {
+        uint8_t         level;          // 0..255, scaled by the max brightness for scaled patterns
+        uint16_t        fade;
+        uint16_t        hold;
+    };
+
+    static const uint8_t    kMaxKeyframes = 10;
+    static const uint16_t   kSegmentTime = 40;      // ms, length of one linear piece of a fade
+    static const uint8_t    kResolution = 13;       // bits, enough for the dim end of the gamma curve
+
     const int       m_ledGPIO = 23;
     const int       m_ledPWMFreq = 5000;
-    const int       m_ledResolution = 8;
+    const ledc_mode_t m_ledMode = LEDC_HIGH_SPEED_MODE;
+    const ledc_channel_t m_ledChannel = LEDC_CHANNEL_0;
 
     int             m_ledMaxBrightness = 255;
-    int             m_ledMapDelay = map(m_ledMaxBrightness, 5, 255, 30, 5);
-    int             m_ledMapPause = map(m_ledMaxBrightness, 5, 255, 800, 0);
 
-    TaskHandle_t    m_ledTask;
+    TaskHandle_t    m_ledTask = nullptr;
+    uint16_t        m_gamma[256];
 
-    static void    loopTask(void *pvParameter); 
-    void           loop();     
+    // the running pattern, LED task only
+    Keyframe        m_frames[kMaxKeyframes];
+    uint8_t         m_frameCount = 0;
+    uint8_t         m_frame = 0;
+    bool            m_repeat = false;
+    bool            m_scaled = false;
+    bool            m_fading = false;
+    uint32_t        m_phaseStart = 0;
+    uint8_t         m_fadeFrom = 0;
+    uint8_t         m_level = 0;
+    int             m_state = -1;
 
+    static void     loopTask(void *pvParameter);
+    void            loop();
+    void            loadPattern();
+    // advances the pattern, returns the ticks until it needs the task again
+    TickType_t      step();
+    void            output(uint8_t level, uint32_t fadeTime);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,122 @@
+#include "log.h"
+
+Log::Slot Log::s_slots[Log::kSlots];
+std::atomic<uint32_t> Log::s_head{0};
+uint32_t Log::s_tail = 0;
+std::atomic<uint32_t> Log::s_dropped{0};
+TaskHandle_t Log::s_task = nullptr;
+
+// "<level> [<tag>] <message>\n", cut to fit
+static uint8_t formatLine(char* line, char level, const char* tag, const char* format, va_list args)
+{
+    const size_t size = Log::kLineSize - 1;     // the newline always fits
+    int length = snprintf(line, size, "%c [%s] ", level, tag);
+    if (length >= 0 && static_cast<size_t>(length) < size)
+    {
+        int message = vsnprintf(line + length, size - length, format, args);
+        length = message < 0 ? length : length + message;
+    }
+    if (length < 0)
+    {
+        length = 0;
+    }
+    // snprintf returns the untruncated length
+    if (static_cast<size_t>(length) > size - 1)
+    {
+        length = size - 1;
+    }
+    line[length++] = '\n';
+    return length;
+}
+
+void Log::init()
+{
+    if (s_task != nullptr)
+    {
+        return;
+    }
+    // a slot is free for the writer claiming position i when its sequence is i
+    for (uint32_t i = 0; i < kSlots; i++)
+    {
+        s_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    // below the main loop, it writes whenever nothing else needs the CPU
+    xTaskCreate(&Log::writerTask, "LogTask", 2048, nullptr, tskIDLE_PRIORITY, &s_task);
+}
+
+void Log::write(char level, const char* tag, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+
+    if (s_task == nullptr)
+    {
+        char line[kLineSize];
+        uint8_t length = formatLine(line, level, tag, format, args);
+        Serial.write(reinterpret_cast<uint8_t*>(line), length);
+        va_end(args);
+        return;
+    }
+
+    // claim a slot, several tasks may log at once
+    uint32_t position = s_head.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true)
+    {
+        slot = &s_slots[position & (kSlots - 1)];
+        int32_t diff = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - position);
+        if (diff == 0)
+        {
+            if (s_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // the writer hasn't caught up
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            va_end(args);
+            return;
+        } else {
+            position = s_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->length = formatLine(slot->text, level, tag, format, args);
+    va_end(args);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+bool Log::writeOne()
+{
+    Slot& slot = s_slots[s_tail & (kSlots - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != s_tail + 1)
+    {
+        return false;
+    }
+    Serial.write(reinterpret_cast<uint8_t*>(slot.text), slot.length);
+    // free for the claim one round later
+    slot.sequence.store(s_tail + kSlots, std::memory_order_release);
+    s_tail++;
+    return true;
+}
+
+void Log::writerTask(void* pvParameter)
+{
+    uint32_t reported = 0;
+    while (1)
+    {
+        while (writeOne())
+        {
+        }
+
+        uint32_t dropped = s_dropped.load(std::memory_order_relaxed);
+        if (dropped != reported)
+        {
+            Serial.printf("W [LOG] %u lines dropped\n", dropped - reported);
+            reported = dropped;
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// levels for YIO_LOG_LEVEL, messages above it are compiled out
+#define YIO_LOG_NONE    0
+#define YIO_LOG_ERROR   1
+#define YIO_LOG_WARN    2
+#define YIO_LOG_INFO    3
+#define YIO_LOG_DEBUG   4
+
+#ifndef YIO_LOG_LEVEL
+#define YIO_LOG_LEVEL YIO_LOG_INFO
+#endif
+
+// Leveled log lines, "<level> [<tag>] <message>" on the serial port.
+// Callers only format into a lock-free queue, a low priority task writes the lines out,
+// so logging never waits for the UART. Lines that find the queue full are counted and
+// dropped. Not for ISRs, formatting isn't safe there.
+class Log
+{
+public:
+    static const uint8_t    kSlots = 32;            // a power of two
+    static const uint8_t    kLineSize = 124;        // longer lines are cut
+
+    // starts the writer task, lines logged before go out right away
+    static void             init();
+
+    static void             write(char level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    static uint32_t         dropped() { return s_dropped; }
+
+    // for passwords and tokens, only shown with YIO_LOG_SECRETS
+    static const char*      secret(const char* value)
+    {
+#ifdef YIO_LOG_SECRETS
+        return value;
+#else
+        return value != nullptr && *value != '\0' ? "<redacted>" : "";
+#endif
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        uint8_t             length;
+        char                text[kLineSize];
+    };
+
+    static_assert((kSlots & (kSlots - 1)) == 0, "Log::kSlots must be a power of two");
+
+    static Slot                     s_slots[kSlots];
+    static std::atomic<uint32_t>    s_head;         // next slot to claim
+    static uint32_t                 s_tail;         // next slot to write out, writer task only
+    static std::atomic<uint32_t>    s_dropped;
+    static TaskHandle_t             s_task;
+
+    static void             writerTask(void* pvParameter);
+    static bool             writeOne();
+};
+
+#if YIO_LOG_LEVEL >= YIO_LOG_ERROR
+#define LOG_ERROR(tag, ...) Log::write('E', tag, __VA_ARGS__)
+#else
+#define LOG_ERROR(tag, ...) do {} while (0)
+#endif
+
+#if YIO_LOG_LEVEL >= YIO_LOG_WARN
+#define LOG_WARN(tag, ...) Log::write('W', tag, __VA_ARGS__)
+#else
+#define LOG_WARN(tag, ...) do {} while (0)
+#endif
+
+#if YIO_LOG_LEVEL >= YIO_LOG_INFO
+#define LOG_INFO(tag, ...) Log::write('I', tag, __VA_ARGS__)
+#else
+#define LOG_INFO(tag, ...) do {} while (0)
+#endif
+
+#if YIO_LOG_LEVEL >= YIO_LOG_DEBUG
+#define LOG_DEBUG(tag, ...) Log::write('D', tag, __VA_ARGS__)
+#else
+#define LOG_DEBUG(tag, ...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,217 @@
+#include "profiler.h"
+
+Profiler::Counter Profiler::s_counters[Profiler::COUNTER_COUNT] = {};
+int64_t Profiler::s_resetAt = 0;
+uint32_t Profiler::s_bootTimes[Profiler::BOOT_PHASE_COUNT] = {};
+
+#ifdef YIO_PROFILE
+// Allocation hooks, linked in with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+static volatile uint32_t s_allocations = 0;
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    s_allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    s_allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    s_allocations++;
+    return __real_realloc(ptr, size);
+}
+}
+#endif
+
+void Profiler::record(Counters counter, uint32_t cycles, uint32_t allocations, int32_t heapDelta)
+{
+    Counter& c = s_counters[counter];
+    c.calls++;
+    c.totalCycles += cycles;
+    if (cycles > c.maxCycles)
+    {
+        c.maxCycles = cycles;
+    }
+    c.allocations += allocations;
+    c.heapDelta += heapDelta;
+
+    // bucket b holds [16 << 2(b - 1), 16 << 2b) us
+    uint32_t micros = cycles / ESP.getCpuFreqMHz();
+    uint32_t bits = micros == 0 ? 0 : 32 - __builtin_clz(micros);
+    uint32_t bucket = bits <= 4 ? 0 : (bits - 3) / 2;
+    c.histogram[bucket < kHistogramBuckets ? bucket : kHistogramBuckets - 1]++;
+}
+
+void Profiler::recordMicros(Counters counter, uint32_t micros)
+{
+    uint64_t cycles = static_cast<uint64_t>(micros) * ESP.getCpuFreqMHz();
+    record(counter, cycles > UINT32_MAX ? UINT32_MAX : cycles, 0, 0);
+}
+
+const char* Profiler::name(Counters counter)
+{
+    switch (counter)
+    {
+    case API_PROCESS_DATA:
+        return "api_process_data";
+    case IR_SEND_HEX:
+        return "ir_send_hex";
+    case IR_SEND_PRONTO:
+        return "ir_send_pronto";
+    case IR_RESULT_TO_HEX:
+        return "ir_result_to_hex";
+    case IR_PARSE_PRONTO:
+        return "ir_parse_pronto";
+    case IR_SEND_LATENCY:
+        return "ir_send_latency";
+    case IR_SEND_RAW:
+        return "ir_send_raw";
+    case IR_PARSE_HEX:
+        return "ir_parse_hex";
+    case CONFIG_LOAD:
+        return "config_load";
+    case CONFIG_READ:
+        return "config_read";
+    case CONFIG_COMMIT:
+        return "config_commit";
+    case MAIN_LOOP:
+        return "main_loop";
+    case API_LOOP:
+        return "api_loop";
+    case IR_RECEIVE:
+        return "ir_receive";
+    case IR_DECODE:
+        return "ir_decode";
+    case MDNS_LOOP:
+        return "mdns_loop";
+    case OTA_HANDLE:
+        return "ota_handle";
+    default:
+        return "unknown";
+    }
+}
+
+void Profiler::bootMark(BootPhase phase)
+{
+    if (s_bootTimes[phase] == 0)
+    {
+        int64_t now = esp_timer_get_time();
+        s_bootTimes[phase] = now > UINT32_MAX ? UINT32_MAX : now;
+    }
+}
+
+const char* Profiler::bootName(BootPhase phase)
+{
+    switch (phase)
+    {
+    case BOOT_SETUP:
+        return "setup";
+    case BOOT_CONFIG:
+        return "config";
+    case BOOT_WIFI_START:
+        return "wifi_start";
+    case BOOT_IR:
+        return "ir";
+    case BOOT_API:
+        return "api";
+    case BOOT_IR_LIBRARY:
+        return "ir_library";
+    case BOOT_SETUP_DONE:
+        return "setup_done";
+    case BOOT_WIFI_CONNECTED:
+        return "wifi_connected";
+    case BOOT_FIRST_IR_SEND:
+        return "first_ir_send";
+    default:
+        return "unknown";
+    }
+}
+
+uint32_t Profiler::cyclesToNs(uint64_t cycles)
+{
+    return static_cast<uint32_t>(cycles * 1000 / ESP.getCpuFreqMHz());
+}
+
+uint32_t Profiler::cyclesToUs(uint64_t cycles)
+{
+    return static_cast<uint32_t>(cycles / ESP.getCpuFreqMHz());
+}
+
+uint32_t Profiler::bucketLimit(uint8_t bucket)
+{
+    return bucket + 1 < kHistogramBuckets ? 16UL << (2 * bucket) : 0;
+}
+
+uint32_t Profiler::allocationCount()
+{
+#ifdef YIO_PROFILE
+    return s_allocations;
+#else
+    return 0;
+#endif
+}
+
+void Profiler::reset()
+{
+    memset(s_counters, 0, sizeof(s_counters));
+    s_resetAt = esp_timer_get_time();
+}
+
+float Profiler::busyPercent(Counters counter)
+{
+    int64_t elapsed = esp_timer_get_time() - s_resetAt;
+    if (elapsed <= 0)
+    {
+        return 0;
+    }
+    // totalCycles / MHz is microseconds
+    return static_cast<float>(s_counters[counter].totalCycles) / ESP.getCpuFreqMHz() * 100 / elapsed;
+}
+
+void Profiler::report(Print& out)
+{
+    out.println(F("[PROFILER] counter            calls     ns/op    max ns  allocs/op  heap/op"));
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        const Counter& c = s_counters[i];
+        if (c.calls == 0)
+        {
+            continue;
+        }
+        out.printf("[PROFILER] %-18s %6u %9u %9u %10.2f %8d\n",
+                   name(static_cast<Counters>(i)),
+                   c.calls,
+                   cyclesToNs(c.totalCycles / c.calls),
+                   cyclesToNs(c.maxCycles),
+                   static_cast<float>(c.allocations) / c.calls,
+                   c.heapDelta / static_cast<int32_t>(c.calls));
+    }
+    out.printf("[PROFILER] main loop busy: %.1f%%\n", busyPercent(MAIN_LOOP));
+    out.printf("[PROFILER] free heap: %u, peak heap used: %u\n",
+               ESP.getFreeHeap(), ESP.getHeapSize() - ESP.getMinFreeHeap());
+}
+
+void Profiler::loop()
+{
+#ifdef YIO_PROFILE
+    const unsigned long reportInterval = 10 * 1000UL;
+    static unsigned long lastReport = 0;
+
+    unsigned long now = millis();
+    if (now - lastReport >= reportInterval)
+    {
+        lastReport = now;
+        report(Serial);
+    }
+#endif
+}
@@ -0,0 +1,129 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+// Cheap on-device counters for the API and IR hot paths.
+// Timing uses the CPU cycle counter. Heap sampling, allocation counting and the
+// periodic serial report are only compiled in with -DYIO_PROFILE (env:esp32dev-profile).
+class Profiler
+{
+public:
+    enum Counters {
+        API_PROCESS_DATA    =   0,
+        IR_SEND_HEX         =   1,
+        IR_SEND_PRONTO      =   2,
+        IR_RESULT_TO_HEX    =   3,
+        IR_PARSE_PRONTO     =   4,
+        IR_SEND_LATENCY     =   5,      // ir_send enqueue to emit
+        IR_SEND_RAW         =   6,
+        IR_PARSE_HEX        =   7,
+        CONFIG_LOAD         =   8,      // reading all settings from NVS at boot
+        CONFIG_READ         =   9,      // a Config getter, served from RAM
+        CONFIG_COMMIT       =   10,     // flushing changed settings to NVS
+        MAIN_LOOP           =   11,     // one wake-up of the main loop
+        API_LOOP            =   12,
+        IR_RECEIVE          =   13,     // one poll of the IR receiver
+        IR_DECODE           =   14,     // decoding a capture
+        MDNS_LOOP           =   15,
+        OTA_HANDLE          =   16,
+        COUNTER_COUNT
+    };
+
+    // points of the startup, each kept the first time it's reached
+    enum BootPhase {
+        BOOT_SETUP          =   0,      // setup() entered, after the bootloader and core start
+        BOOT_CONFIG         =   1,      // settings loaded from NVS
+        BOOT_WIFI_START     =   2,      // the radio associates in the background from here
+        BOOT_IR             =   3,      // IR tasks running
+        BOOT_API            =   4,      // websocket server listening
+        BOOT_IR_LIBRARY     =   5,      // stored codes indexed
+        BOOT_SETUP_DONE     =   6,
+        BOOT_WIFI_CONNECTED =   7,      // first address
+        BOOT_FIRST_IR_SEND  =   8,      // first accepted ir_send
+        BOOT_PHASE_COUNT
+    };
+
+    // durations by powers of four, the first bucket holds everything below 16 us
+    static const uint8_t    kHistogramBuckets = 8;
+
+    struct Counter {
+        uint32_t    calls;
+        uint64_t    totalCycles;
+        uint32_t    maxCycles;
+        uint32_t    allocations;    // malloc/calloc/realloc calls, YIO_PROFILE only
+        int32_t     heapDelta;      // accumulated free heap change, YIO_PROFILE only
+        uint32_t    histogram[kHistogramBuckets];
+    };
+
+    static void             record(Counters counter, uint32_t cycles, uint32_t allocations, int32_t heapDelta);
+    // for spans measured with esp_timer_get_time(), e.g. across tasks
+    static void             recordMicros(Counters counter, uint32_t micros);
+    static const Counter&   get(Counters counter) { return s_counters[counter]; }
+    static const char*      name(Counters counter);
+    static uint32_t         cyclesToNs(uint64_t cycles);
+    static uint32_t         cyclesToUs(uint64_t cycles);
+    // upper end of a histogram bucket in us, 0 for the open last one
+    static uint32_t         bucketLimit(uint8_t bucket);
+    static uint32_t         allocationCount();
+    static void             reset();
+
+    // us since the chip started, a phase keeps its first time, reset() doesn't clear them
+    static void             bootMark(BootPhase phase);
+    // 0 until the phase is reached
+    static uint32_t         bootTime(BootPhase phase) { return s_bootTimes[phase]; }
+    static const char*      bootName(BootPhase phase);
+
+    // share of the time since the last reset spent in the counter, in percent
+    static float            busyPercent(Counters counter);
+
+    // prints ns/op, allocations/op and heap figures for every counter
+    static void             report(Print& out);
+
+    // prints the report periodically when profiling is enabled
+    static void             loop();
+
+private:
+    static Counter          s_counters[COUNTER_COUNT];
+    static int64_t          s_resetAt;
+    static uint32_t         s_bootTimes[BOOT_PHASE_COUNT];
+};
+
+// Measures the enclosing scope and adds it to the given counter
+class ProfileScope
+{
+public:
+    explicit ProfileScope(Profiler::Counters counter) : m_counter(counter)
+    {
+#ifdef YIO_PROFILE
+        m_allocations = Profiler::allocationCount();
+        m_freeHeap = ESP.getFreeHeap();
+#endif
+        m_start = ESP.getCycleCount();
+    }
+
+    ~ProfileScope()
+    {
+        uint32_t cycles = ESP.getCycleCount() - m_start;
+#ifdef YIO_PROFILE
+        Profiler::record(m_counter, cycles, Profiler::allocationCount() - m_allocations,
+                         static_cast<int32_t>(m_freeHeap) - static_cast<int32_t>(ESP.getFreeHeap()));
+#else
+        Profiler::record(m_counter, cycles, 0, 0);
+#endif
+    }
+
+private:
+    Profiler::Counters  m_counter;
+    uint32_t            m_start;
+#ifdef YIO_PROFILE
+    uint32_t            m_allocations;
+    uint32_t            m_freeHeap;
+#endif
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(counter) ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(counter)
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef API_SOCKET_SERVER_H
+#define API_SOCKET_SERVER_H
+
+#include <WebSocketsServer.h>
+#include <lwip/sockets.h>
+
+// The websocket server with a look at the client sockets, so the API only writes
+// to a client whose socket can take data and a slow client can't block the others.
+class ApiSocketServer : public WebSocketsServer
+{
+public:
+    using WebSocketsServer::WebSocketsServer;
+
+    // a writable socket takes more than TCP_SNDLOWAT bytes without blocking,
+    // a fragment of this size fits with the largest frame header (10 bytes)
+    static const size_t kWriteChunk = TCP_SNDLOWAT - 10;
+
+    bool connected(uint8_t num)
+    {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+        {
+            return false;
+        }
+        WSclient_t& client = _clients[num];
+        return client.tcp != nullptr && client.status == WSC_CONNECTED;
+    }
+
+    // true when the socket send buffer has room, never waits
+    bool writable(uint8_t num)
+    {
+        if (!connected(num))
+        {
+            return false;
+        }
+        int fd = _clients[num].tcp->fd();
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        struct timeval timeout = { 0, 0 };
+        return select(fd + 1, nullptr, &set, nullptr, &timeout) > 0;
+    }
+
+    // one frame of a message sent in parts: the first carries the opcode, the others continue
+    // it and the last one ends it. Up to kWriteChunk bytes, so it never waits on a writable socket
+    bool sendFragment(uint8_t num, bool binary, const uint8_t* data, size_t length, bool first, bool last)
+    {
+        if (!connected(num))
+        {
+            return false;
+        }
+        WSopcode_t opcode = !first ? WSop_continuation : binary ? WSop_binary : WSop_text;
+        return sendFrame(&_clients[num], opcode, const_cast<uint8_t*>(data), length, last);
+    }
+};
+
+#endif
@@ -1,9 +1,44 @@
 #include "service_api.h"
 #include "service_wifi.h"
 #include "service_mdns.h"
+#include "profiler.h"
+#include "ir_library.h"
+#include "service_blueooth.h"
+#include "trace.h"
+#include "log.h"
 
 API* API::s_instance = nullptr;
 
+// dock commands, looked up by the hash of the "command" field
+const API::Command API::s_commands[] = {
+    { fnvHash("ping"),                  "ping",                 &API::cmdPing },
+    { fnvHash("led_brightness_start"),  "led_brightness_start", &API::cmdLedBrightnessStart },
+    { fnvHash("led_brightness_stop"),   "led_brightness_stop",  &API::cmdLedBrightnessStop },
+    { fnvHash("ir_send"),               "ir_send",              &API::cmdIrSend },
+    { fnvHash("ir_send_batch"),         "ir_send_batch",        &API::cmdIrSendBatch },
+    { fnvHash("ir_send_id"),            "ir_send_id",           &API::cmdIrSend },
+    { fnvHash("ir_send_raw"),           "ir_send_raw",          &API::cmdIrSend },
+    { fnvHash("ir_store"),              "ir_store",             &API::cmdIrStore },
+    { fnvHash("ir_delete"),             "ir_delete",            &API::cmdIrDelete },
+    { fnvHash("ir_list"),               "ir_list",              &API::cmdIrList },
+    { fnvHash("ir_receive_on"),         "ir_receive_on",        &API::cmdIrReceiveOn },
+    { fnvHash("ir_receive_off"),        "ir_receive_off",       &API::cmdIrReceiveOff },
+    { fnvHash("ir_receive_raw"),        "ir_receive_raw",       &API::cmdIrReceiveRaw },
+    { fnvHash("ir_learn_start"),        "ir_learn_start",       &API::cmdIrLearnStart },
+    { fnvHash("ir_learn_cancel"),       "ir_learn_cancel",      &API::cmdIrLearnCancel },
+    { fnvHash("remote_charged"),        "remote_charged",       &API::cmdRemoteCharged },
+    { fnvHash("remote_lowbattery"),     "remote_lowbattery",    &API::cmdRemoteLowBattery },
+    { fnvHash("set_friendly_name"),     "set_friendly_name",    &API::cmdSetFriendlyName },
+    { fnvHash("reboot"),                "reboot",               &API::cmdReboot },
+    { fnvHash("reset"),                 "reset",                &API::cmdReset },
+    { fnvHash("set_protocol"),          "set_protocol",         &API::cmdSetProtocol },
+    { fnvHash("config_stats"),          "config_stats",         &API::cmdConfigStats },
+    { fnvHash("get_state"),             "get_state",            &API::cmdGetState },
+    { fnvHash("client_stats"),          "client_stats",         &API::cmdClientStats },
+    { fnvHash("stats"),                 "stats",                &API::cmdStats },
+    { fnvHash("trace_dump"),            "trace_dump",           &API::cmdTraceDump },
+};
+
 API::API()
 {
     s_instance = this;
@@ -18,35 +53,40 @@ void API::init()
         {
         case WStype_DISCONNECTED:
         {
-            Serial.printf("[API] [%u] Disconnected!\n", num);
-            // remove from connected clients
-            for (int i = 0; i < m_webSocketClientsCount; i++)
-            {
-                if (m_webSocketClients[i] == num)
-                {
-                    m_webSocketClients[i] = -1;
-                }
-            }
+            LOG_INFO("API", "[%u] Disconnected", num);
+            resetClient(num);
         }
             break;
 
         case WStype_CONNECTED:
         {
             IPAddress ip = m_webSocketServer.remoteIP(num);
-            Serial.printf("[API] [%u] Connected from %d.%d.%d.%d url: %s\n", num, ip[0], ip[1], ip[2], ip[3], payload);
+            LOG_INFO("API", "[%u] Connected from %d.%d.%d.%d url: %s", num, ip[0], ip[1], ip[2], ip[3], payload);
+
+            // a new client starts out unauthenticated, whatever the slot held before
+            resetClient(num);
 
             // send auth request message
-            StaticJsonDocument<200> responseDoc;
-            responseDoc["type"] = "auth_required";
-            String message;
-            serializeJson(responseDoc, message);
-            m_webSocketServer.sendTXT(num, message);
+            static const char authRequired[] = "{\"type\":\"auth_required\"}";
+            m_webSocketServer.sendTXT(num, authRequired, sizeof(authRequired) - 1);
         }
             break;
 
         case WStype_TEXT:
         {
-            processData(String((char *)payload), num, "websocket");
+            processData(reinterpret_cast<char *>(payload), length, num, SOURCE_WEBSOCKET);
+        }
+            break;
+
+        case WStype_BIN:
+        {
+            // a msgpack message is a map, it never starts with the raw frame magic
+            if (IrRawCodec::isFrame(payload, length))
+            {
+                processRawFrame(num, payload, length);
+            } else {
+                processData(reinterpret_cast<char *>(payload), length, num, SOURCE_WEBSOCKET, FORMAT_MSGPACK);
+            }
         }
             break;
 
@@ -55,7 +95,6 @@ void API::init()
         case WStype_FRAGMENT_BIN_START:
         case WStype_FRAGMENT:
         case WStype_FRAGMENT_FIN:
-        case WStype_BIN:
         case WStype_PING:
         case WStype_PONG:
             break;
@@ -65,263 +104,1598 @@ void API::init()
 
 void API::loop()
 {
+    PROFILE_SCOPE(Profiler::API_LOOP);
     m_webSocketServer.loop();
     handleSerial();
-    if (InfraredService::getInstance()->messageToAPI != "")
+    // drain decoded IR codes and broadcast them together
+    InfraredService* ir = InfraredService::getInstance();
+    size_t received = 0;
+    while (received < InfraredService::kReceiveQueueSize && ir->takeReceived(m_receivedCodes[received]))
+    {
+        received++;
+    }
+    if (received > 0)
+    {
+        uint32_t dropped = ir->receiveDropped();
+        sendIrReceived(m_receivedCodes, received, dropped - m_receiveDroppedReported);
+        m_receiveDroppedReported = dropped;
+    }
+
+    const InfraredService::RawFrame* frame;
+    while ((frame = ir->frontRawFrame()) != nullptr)
+    {
+        sendRawFrame(*frame);
+        ir->releaseRawFrame();
+    }
+
+    pollLearning();
+
+    InfraredService::IrSendResult result;
+    while (ir->takeResult(result))
     {
-        sendMessage(InfraredService::getInstance()->messageToAPI);
-        InfraredService::getInstance()->messageToAPI = "";
+        sendIrResult(result);
     }
+
+    pushStats();
+    flush();
 }
 
 void API::handleSerial()
 {
-    String receivedSerialData = "";
-    bool interestingData = false; // Data between { and } chars.
-
+    // frames may span several loop passes, the parser keeps the partial one
+    uint32_t now = millis();
     while (Serial.available() > 0)
     {
-        char incomingChar = Serial.read();
-        if (String(incomingChar) == "{")
+        if (m_serialParser.push(Serial.read(), now))
         {
-            interestingData = true;
-            receivedSerialData = "";
+            processData(m_serialParser.frame(), m_serialParser.length(), 0, SOURCE_SERIAL);
         }
-        else if (String(incomingChar) == "}")
+    }
+}
+
+void API::processData(char* data, size_t length, int id, Source source, Format format)
+{
+    PROFILE_SCOPE(Profiler::API_PROCESS_DATA);
+    Trace::record(Trace::TRACE_INGRESS, source, length);
+
+    // never the payload, it may hold the WiFi password or the token
+    LOG_DEBUG("API", "%u bytes of %s from %s", length, format == FORMAT_MSGPACK ? "msgpack" : "json", sourceName(source));
+
+    DeserializationError error;
+    if (format == FORMAT_MSGPACK)
+    {
+        error = deserializeMsgPack(m_requestDoc, data, length);
+    } else {
+        error = deserializeJson(m_requestDoc, data, length);
+    }
+
+    if (error)
+    {
+        LOG_WARN("API", "deserialize failed: %s", error.c_str());
+        // the sender learns its message was dropped, whatever it asked for
+        Request request = { JsonObjectConst(), id, source };
+        m_responseDoc.clear();
+        m_responseDoc["type"] = "dock";
+        m_responseDoc["message"] = "invalid_message";
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = error == DeserializationError::NoMemory ? "message too large" : "invalid message";
+        reply(request, m_responseDoc);
+        return;
+    }
+
+    Request request = { m_requestDoc.as<JsonObjectConst>(), id, source };
+    const char* type = request.json["type"];
+
+    // NEW WIFI SETTINGS
+    if (request.json.containsKey("ssid") && request.json.containsKey("password"))
+    {
+        handleWifiSettings(request);
+    }
+
+    if (type == nullptr)
+    {
+        return;
+    }
+
+    // AUTHENTICATION TO THE API
+    if (strcmp(type, "auth") == 0)
+    {
+        handleAuth(request);
+        return;
+    }
+
+    // COMMANDS TO THE DOCK
+    if (strcmp(type, "dock") != 0 || !isAuthorized(id, source))
+    {
+        return;
+    }
+
+    const Command* command = findCommand(request.json["command"]);
+    if (command != nullptr)
+    {
+        Trace::record(Trace::TRACE_DISPATCH_BEGIN, 0, command->hash);
+        (this->*(command->handler))(request);
+        Trace::record(Trace::TRACE_DISPATCH_END, 0, command->hash);
+    }
+}
+
+bool API::isAuthorized(int id, Source source)
+{
+    // serial and bluetooth need physical access to the dock
+    if (source != SOURCE_WEBSOCKET)
+    {
+        return true;
+    }
+
+    return id >= 0 && id < WEBSOCKETS_SERVER_CLIENT_MAX && (m_authClients & (1UL << id)) != 0;
+}
+
+const API::Command* API::findCommand(const char* name)
+{
+    if (name == nullptr)
+    {
+        return nullptr;
+    }
+
+    // the iterative form, long input can't grow the stack
+    uint32_t hash = fnvHash(name, strlen(name));
+
+    for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++)
+    {
+        if (s_commands[i].hash == hash && strcmp(s_commands[i].name, name) == 0)
         {
-            interestingData = false;
-            receivedSerialData += "}";
-            // process the data
-            processData(receivedSerialData, 0, "serial");
+            return &s_commands[i];
         }
-        if (interestingData)
+    }
+    return nullptr;
+}
+
+void API::reply(const Request& request, JsonDocument& doc)
+{
+    if (request.source == SOURCE_WEBSOCKET)
+    {
+        send(request.id, doc);
+    }
+    else if (request.source == SOURCE_BLUETOOTH)
+    {
+        BluetoothService::getInstance()->send(doc);
+    } else {
+        // one write, so lines of the log task can't end up inside the reply
+        size_t size = measureJson(doc) + 2;
+        Message* message = createMessage(size, false);
+        if (message == nullptr)
         {
-            receivedSerialData += String(incomingChar);
+            return;
         }
+        message->length = serializeJson(doc, message->data, size);
+        message->data[message->length++] = '\n';
+        Serial.write(reinterpret_cast<uint8_t*>(message->data), message->length);
+        releaseMessage(message);
     }
 }
 
-void API::processData(String response, int id, String source)
+void API::send(uint8_t num, JsonDocument& doc, Policy policy)
 {
-    Serial.print("[API] GOT DATA FROM: ");
-    Serial.println(source);
-    Serial.println(response);
-
-    StaticJsonDocument<600> webSocketJsonDocument;
-    DeserializationError error = deserializeJson(webSocketJsonDocument, response);
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        return;
+    }
 
-    if (error)
+    Message* message = createMessage(doc, m_clients[num].format);
+    if (message == nullptr)
     {
-        Serial.print(F("[API] deserializeJson() failed: "));
-        Serial.println(error.c_str());
         return;
     }
+    enqueue(num, message, policy);
+    releaseMessage(message);
+}
 
-    // response json
-    StaticJsonDocument<200> responseDoc;
+bool API::usesFormat(uint8_t num, Format format)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        return false;
+    }
+    return m_clients[num].format == format;
+}
 
-    String type;
-    if (webSocketJsonDocument.containsKey("type")) {
-        type = webSocketJsonDocument["type"].as<String>();
+void API::resetClient(uint8_t num)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        return;
     }
+    m_authClients &= ~(1UL << num);
+    m_statsClients &= ~(1UL << num);
+    unsubscribeRaw(num);
 
-    String command;
-    if (webSocketJsonDocument.containsKey("command")) {
-        command = webSocketJsonDocument["command"].as<String>();
+    // whatever the last client didn't read goes away with it
+    Client& client = m_clients[num];
+    while (client.count > 0)
+    {
+        releaseMessage(client.queue[client.head].message);
+        client.head = (client.head + 1) % kClientQueueDepth;
+        client.count--;
     }
+    client = Client();
+    // the next client in this slot doesn't get the learning session of this one
+    if (m_learnSource == SOURCE_WEBSOCKET && m_learnClient == num)
+    {
+        m_learnClient = -1;
+    }
+}
 
-    // NEW WIFI SETTINGS
-    if (webSocketJsonDocument.containsKey("ssid") && webSocketJsonDocument.containsKey("password"))
+const char* API::sourceName(Source source)
+{
+    switch (source)
     {
-        String ssid = webSocketJsonDocument["ssid"].as<String>();
-        String pass = webSocketJsonDocument["password"].as<String>();
+    case SOURCE_WEBSOCKET:
+        return "websocket";
+    case SOURCE_SERIAL:
+        return "serial";
+    case SOURCE_BLUETOOTH:
+        return "bluetooth";
+    default:
+        return "unknown";
+    }
+}
+
+void API::handleWifiSettings(const Request& request)
+{
+    const char* ssid = request.json["ssid"];
+    const char* pass = request.json["password"];
 
-        Config::getInstance()->setWifiSsid(ssid);
-        Config::getInstance()->setWifiPassword(pass);
+    Config::getInstance()->setWifiSsid(ssid);
+    Config::getInstance()->setWifiPassword(pass);
 
-        Serial.println("[API] Saving SSID:" + ssid + " PASS:" + pass);
+    LOG_INFO("API", "Saving SSID: %s PASS: %s", ssid, Log::secret(pass));
 
-        State::getInstance()->reboot();
-        // Serial.println(F("[API] Disconnecting any current WiFi connections."));
-        // WiFi.disconnect();
-        // delay(1000);
-        // Serial.println(F("[API] Connecting to provided WiFi credentials."));
-        // WifiService::getInstance()->connect(ssid, pass);
-    }
-    
-    // AUTHENTICATION TO THE API
-    if (type == "auth")
+    // the setup client knows the dock took the credentials before it goes away
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "wifi_settings";
+    m_responseDoc["success"] = true;
+    reply(request, m_responseDoc);
+    flush();
+
+    State::getInstance()->reboot();
+    // Serial.println(F("[API] Disconnecting any current WiFi connections."));
+    // WiFi.disconnect();
+    // delay(1000);
+    // Serial.println(F("[API] Connecting to provided WiFi credentials."));
+    // WifiService::getInstance()->connect(ssid, pass);
+}
+
+void API::handleAuth(const Request& request)
+{
+    m_responseDoc.clear();
+
+    if (request.json.containsKey("token"))
     {
-        if (webSocketJsonDocument.containsKey("token"))
+        // tokens sent as numbers are compared by their text
+        char token[32] = "";
+        JsonVariantConst tokenValue = request.json["token"];
+        if (tokenValue.is<const char*>())
         {
-            if (webSocketJsonDocument["token"].as<String>() == Config::getInstance()->token)
-            {
-                // token ok
-                responseDoc["type"] = "auth_ok";
-                String message;
-                serializeJson(responseDoc, message);
+            strlcpy(token, tokenValue.as<const char*>(), sizeof(token));
+        } else {
+            serializeJson(tokenValue, token, sizeof(token));
+        }
 
-                if (source == "websocket")
-                {
-                    m_webSocketServer.sendTXT(id, message);
+        if (Config::getInstance()->token == token)
+        {
+            // token ok
+            m_responseDoc["type"] = "auth_ok";
+            reply(request, m_responseDoc);
 
-                    // add client to authorized clients
-                    m_webSocketClients[m_webSocketClientsCount] = id;
-                    m_webSocketClientsCount++;
-                } else {
-                    Serial.println(message);
-                }
-            }
-            else
+            if (request.source == SOURCE_WEBSOCKET && request.id < WEBSOCKETS_SERVER_CLIENT_MAX)
             {
-                // invalid token
-                responseDoc["type"] = "auth";
-                responseDoc["message"] = "Invalid token";
-                String message;
-                serializeJson(responseDoc, message);
-                if (source == "websocket")
-                {
-                    m_webSocketServer.sendTXT(id, message);
-                } else {
-                    Serial.println(message); 
-                }
+                // add client to authorized clients, authenticating again changes nothing
+                m_authClients |= (1UL << request.id);
             }
         }
         else
         {
-            // token needed
-            responseDoc["type"] = "auth";
-            responseDoc["message"] = "Token needed";
-            String message;
-            serializeJson(responseDoc, message);
-            if (source == "websocket")
-            {
-                m_webSocketServer.sendTXT(id, message);
-            } else {
-                Serial.println(message); 
-            }
+            // invalid token
+            m_responseDoc["type"] = "auth";
+            m_responseDoc["message"] = "Invalid token";
+            reply(request, m_responseDoc);
         }
     }
+    else
+    {
+        // token needed
+        m_responseDoc["type"] = "auth";
+        m_responseDoc["message"] = "Token needed";
+        reply(request, m_responseDoc);
+    }
+}
+
+// Ping pong
+void API::cmdPing(const Request& request)
+{
+    LOG_DEBUG("API", "Sending heartbeat");
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "pong";
+    reply(request, m_responseDoc);
+}
+
+// Change LED brightness
+void API::cmdLedBrightnessStart(const Request& request)
+{
+    State::getInstance()->set(State::LED_SETUP);
+    int maxbrightness = request.json["brightness"].as<int>();
+    LedControl::getInstance()->setLedMaxBrightness(maxbrightness);
+
+    LOG_INFO("API", "Led brightness start, brightness: %d", maxbrightness);
+}
+
+void API::cmdLedBrightnessStop(const Request& request)
+{
+    State* state = State::getInstance();
+    state->compareAndSet(State::LED_SETUP, state->idleState());
+
+    LOG_INFO("API", "Led brightness stop");
+
+    // save settings
+    Config::getInstance()->setLedBrightness(LedControl::getInstance()->getLedMaxBrightness());
+}
+
+// Queue an IR code for the send task
+// "code" is a "<protocol>;<hex>;<bits>;<repeat>" or pronto string as before,
+// or, mostly from msgpack clients, an integer hex code with "protocol", "bits" and "repeat"
+// fields, or an array of pronto words with "repeat".
+// ir_send_raw takes "timings" (microseconds, mark first) with "frequency" in Hz and "repeat".
+// Words and timings are 16 bit integers, the carrier is kMinCarrierFrequency to kMaxCarrierFrequency.
+// The reply acknowledges the queued request with its req_id, an ir_send_done message follows.
+void API::cmdIrSend(const Request& request)
+{
+    LOG_DEBUG("API", "IR Send");
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_send";
+
+    InfraredService* ir = InfraredService::getInstance();
+    InfraredService::IrCommand* command = ir->acquireCommand();
+    if (command == nullptr)
+    {
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = "queue full";
+        reply(request, m_responseDoc);
+        return;
+    }
 
-    // COMMANDS TO THE DOCK
-    for (int i = 0; i < m_webSocketClientsCount; i++)
+    command->origin = request.source;
+    command->clientId = request.id;
+    const char* error = parseIrCode(request.json, *command);
+
+    if (error != nullptr)
+    {
+        ir->releaseCommand(command);
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = error;
+        reply(request, m_responseDoc);
+        return;
+    }
+
+    m_responseDoc["success"] = true;
+    m_responseDoc["req_id"] = ir->enqueue(command);
+    Profiler::bootMark(Profiler::BOOT_FIRST_IR_SEND);
+    reply(request, m_responseDoc);
+}
+
+// Queue a sequence of IR codes that the send task plays back with its own timing, e.g.
+// {"type":"dock","command":"ir_send_batch","steps":[
+//   {"code":"...","format":"hex","delay":800},
+//   {"code":[...],"count":5,"interval":150}]}
+// Each step takes the same code fields as ir_send plus "count" (how often it is sent, 1 to
+// kMaxBatchCount), "interval" (ms between the starts of those sends, up to kMaxBatchInterval)
+// and "delay" (ms before the next step, up to kMaxBatchDelay).
+// An ir_send_batch_step message follows for every step, the last one has "done" set.
+void API::cmdIrSendBatch(const Request& request)
+{
+    LOG_DEBUG("API", "IR Send batch");
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_send_batch";
+
+    InfraredService* ir = InfraredService::getInstance();
+    JsonArrayConst steps = request.json["steps"].as<JsonArrayConst>();
+    size_t stepCount = steps.size();
+
+    if (stepCount == 0 || stepCount > IR_QUEUE_DEPTH)
+    {
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = "invalid batch";
+        reply(request, m_responseDoc);
+        return;
+    }
+
+    if (ir->freeCommands() < stepCount)
+    {
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = "queue full";
+        reply(request, m_responseDoc);
+        return;
+    }
+
+    InfraredService::IrCommand* commands[IR_QUEUE_DEPTH];
+    for (size_t i = 0; i < stepCount; i++)
     {
-        if (m_webSocketClients[i] == id)
+        JsonObjectConst step = steps[i].as<JsonObjectConst>();
+        InfraredService::IrCommand* command = ir->acquireCommand();
+        commands[i] = command;
+
+        command->origin = request.source;
+        command->clientId = request.id;
+        command->step = i;
+        command->stepCount = stepCount;
+
+        const char* error = parseBatchTiming(step, *command);
+        if (error == nullptr)
+        {
+            error = parseIrCode(step, *command);
+        }
+        if (error != nullptr)
         {
-            // it's on the list, let's see what it wants
-            if (type == "dock")
+            for (size_t j = 0; j <= i; j++)
             {
-                // Ping pong
-                if (command == "ping")
-                {
-                    Serial.println(F("[API] Sending heartbeat"));
-                    responseDoc["type"] = "dock";
-                    responseDoc["message"] = "pong";
-                    String message;
-                    serializeJson(responseDoc, message);
-                    m_webSocketServer.sendTXT(id, message);
-                }
+                ir->releaseCommand(commands[j]);
+            }
+            m_responseDoc["success"] = false;
+            m_responseDoc["error"] = error;
+            m_responseDoc["step"] = i;
+            reply(request, m_responseDoc);
+            return;
+        }
+    }
 
-                // Change LED brightness
-                if (command == "led_brightness_start")
-                {
-                    State::getInstance()->currentState = State::LED_SETUP;
-                    int maxbrightness = webSocketJsonDocument["brightness"].as<int>();
-                    LedControl::getInstance()->setLedMaxBrightness(maxbrightness);
+    uint32_t requestId = ir->enqueue(commands[0]);
+    for (size_t i = 1; i < stepCount; i++)
+    {
+        ir->enqueue(commands[i], requestId);
+    }
 
-                    Serial.println(F("[API] Led brightness start"));
-                    Serial.print(F("Brightness: "));
-                    Serial.println(maxbrightness);
-                }
-                if (command == "led_brightness_stop")
-                {
-                    State::getInstance()->currentState = State::NORMAL;
-                    ledcWrite(LedControl::getInstance()->m_ledChannel, 0);
+    m_responseDoc["success"] = true;
+    m_responseDoc["req_id"] = requestId;
+    m_responseDoc["steps"] = stepCount;
+    reply(request, m_responseDoc);
+}
 
-                    Serial.println(F("[API] Led brightness stop"));
+// Fill the count, interval and delay of a batch step, returns an error text or nullptr.
+// Left out fields keep their defaults, anything else has to be an integer in range.
+const char* API::parseBatchTiming(JsonObjectConst step, InfraredService::IrCommand& command)
+{
+    JsonVariantConst count = step["count"];
+    if (!count.isNull())
+    {
+        if (!count.is<uint16_t>() || count.as<uint16_t>() == 0 || count.as<uint16_t>() > kMaxBatchCount)
+        {
+            return "invalid count";
+        }
+        command.times = count.as<uint16_t>();
+    }
 
-                    // save settings
-                    Config::getInstance()->setLedBrightness(LedControl::getInstance()->getLedMaxBrightness());
-                }
+    JsonVariantConst interval = step["interval"];
+    if (!interval.isNull())
+    {
+        if (!interval.is<uint16_t>() || interval.as<uint16_t>() > kMaxBatchInterval)
+        {
+            return "invalid interval";
+        }
+        command.interval = interval.as<uint16_t>();
+    }
 
-                // Send IR code
-                if (command == "ir_send")
-                {
-                    responseDoc["type"] = "dock";
-                    responseDoc["message"] = "ir_send";
-
-                    Serial.println(F("[API] IR Send"));
-                    String code = webSocketJsonDocument["code"].as<String>();
-                    String format = webSocketJsonDocument["format"].as<String>();
-                    bool result = InfraredService::getInstance()->send(code, format);
-                    responseDoc["success"] = result;
-                    
-                    String message;
-                    serializeJson(responseDoc, message);
-                    if (source == "websocket")
-                    {
-                        m_webSocketServer.sendTXT(id, message);
-                    } else {
-                        Serial.println(message); 
-                    }
-                }
+    JsonVariantConst delay = step["delay"];
+    if (!delay.isNull())
+    {
+        if (!delay.is<uint32_t>() || delay.as<uint32_t>() > kMaxBatchDelay)
+        {
+            return "invalid delay";
+        }
+        command.delay = delay.as<uint32_t>();
+    }
+    return nullptr;
+}
 
-                // Turn on IR receiving
-                if (command == "ir_receive_on")
-                {
-                    InfraredService::getInstance()->receiving = true;
-                    Serial.println(F("[API] IR Receive on"));
-                }
+// Fill the repeat count of an IR command, a left out field keeps what the command has
+const char* API::parseRepeat(JsonObjectConst json, InfraredService::IrCommand& command)
+{
+    JsonVariantConst repeat = json["repeat"];
+    if (!repeat.isNull())
+    {
+        if (!repeat.is<uint16_t>())
+        {
+            return "invalid repeat";
+        }
+        command.repeat = repeat.as<uint16_t>();
+    }
+    return nullptr;
+}
 
-                // Turn off IR receiving
-                if (command == "ir_receive_off")
-                {
-                    InfraredService::getInstance()->receiving = false;
-                    Serial.println(F("[API] IR Receive off"));
-                }
+// Fill an IR command from the code fields of an ir_send message or batch step,
+// returns an error text or nullptr. Word arrays are checked element by element,
+// a garbled code is never sent.
+const char* API::parseIrCode(JsonObjectConst json, InfraredService::IrCommand& command)
+{
+    JsonVariantConst code = json["code"];
 
-                // Change state to indicate remote is fully charged
-                if (command == "remote_charged")
-                {
-                    State::getInstance()->currentState = State::NORMAL_FULLYCHARGED;
-                }
+    if (code.is<JsonArrayConst>())
+    {
+        JsonArrayConst words = code.as<JsonArrayConst>();
+        if (words.size() == 0)
+        {
+            return "empty code";
+        }
+        if (words.size() > InfraredService::kMaxCodeWords)
+        {
+            return "code too long";
+        }
 
-                // Change state to indicate remote is low battery
-                if (command == "remote_lowbattery")
-                {
-                    State::getInstance()->currentState = State::NORMAL_LOWBATTERY;
-                }
+        uint16_t count = 0;
+        for (JsonVariantConst word : words)
+        {
+            if (!word.is<uint16_t>())
+            {
+                return "invalid pronto code";
+            }
+            command.words[count++] = word.as<uint16_t>();
+        }
 
-                // Change friendly name
-                if (command == "set_friendly_name")
-                {
-                    String dockFriendlyName = webSocketJsonDocument["friendly_name"].as<String>();
-                    Config::getInstance()->setFriendlyName(dockFriendlyName);
-                    MDNSService::getInstance()->addFriendlyName(dockFriendlyName);     
-                }
+        // the second word is the carrier period in 0.241246 us ticks
+        uint32_t frequency = count > 1 && command.words[1] > 0 ? 4145146UL / command.words[1] : 0;
+        if (frequency < kMinCarrierFrequency || frequency > kMaxCarrierFrequency)
+        {
+            return "invalid frequency";
+        }
+        command.type = InfraredService::IrCommand::TYPE_PRONTO;
+        command.count = count;
+        command.repeat = 0;
+        return parseRepeat(json, command);
+    }
 
-                // Reboot the dock
-                if (command == "reboot")
-                {
-                    Serial.println(F("[API] Rebooting"));
-                    State::getInstance()->reboot();
-                }
+    // raw mark/space timings in microseconds, the whole code is sent repeat + 1 times
+    JsonArrayConst timings = json["timings"].as<JsonArrayConst>();
+    if (code.isNull() && !timings.isNull())
+    {
+        if (timings.size() == 0)
+        {
+            return "empty code";
+        }
+        if (timings.size() > InfraredService::kMaxCodeWords)
+        {
+            return "code too long";
+        }
 
-                // Erase and reset the dock
-                if (command == "reset")
-                {
-                    Serial.println(F("[API] Reset"));
-                    Config::getInstance()->reset();
-                }
+        uint16_t count = 0;
+        for (JsonVariantConst timing : timings)
+        {
+            if (!timing.is<uint16_t>())
+            {
+                return "invalid timings";
             }
+            command.words[count++] = timing.as<uint16_t>();
+        }
+
+        JsonVariantConst frequency = json["frequency"];
+        if (!frequency.isNull() && (!frequency.is<uint16_t>() || frequency.as<uint16_t>() < kMinCarrierFrequency
+                                    || frequency.as<uint16_t>() > kMaxCarrierFrequency))
+        {
+            return "invalid frequency";
+        }
+        command.type = InfraredService::IrCommand::TYPE_RAW;
+        command.count = count;
+        command.onceCount = 0;
+        command.frequency = frequency | 38000;
+        command.repeat = 0;
+        return parseRepeat(json, command);
+    }
+
+    if (code.is<uint64_t>())
+    {
+        command.type = InfraredService::IrCommand::TYPE_HEX;
+        command.protocol = static_cast<decode_type_t>(json["protocol"].as<int>());
+        command.value = code.as<uint64_t>();
+        command.bits = json["bits"].as<uint16_t>();
+        command.repeat = 0;
+        return parseRepeat(json, command);
+    }
+
+    // a code from the library, by "id" or "name"
+    if (code.isNull() && (json.containsKey("id") || json.containsKey("name")))
+    {
+        IrLibrary* library = IrLibrary::getInstance();
+        uint32_t id = json.containsKey("id") ? json["id"].as<uint32_t>() : library->findByName(json["name"].as<const char*>());
+        if (!library->load(id, command))
+        {
+            return "unknown code";
         }
+        return parseRepeat(json, command);
     }
+
+    InfraredService::ParseResult result = InfraredService::getInstance()->parseCode(code.as<const char*>(), json["format"].as<const char*>(), command);
+    return result == InfraredService::PARSE_OK ? nullptr : InfraredService::parseResultText(result);
 }
 
-void API::sendMessage(String msg)
+// Store a code in the library, takes the code fields of ir_send plus "name" and optionally "id".
+// A name already stored without "id" replaces that code, with another "id" it's refused.
+void API::cmdIrStore(const Request& request)
 {
-    for (int i = 0; i < m_webSocketClientsCount; i++)
+    LOG_DEBUG("API", "IR Store");
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_store";
+
+    // a pool slot serves as scratch space for the code
+    InfraredService* ir = InfraredService::getInstance();
+    InfraredService::IrCommand* command = ir->acquireCommand();
+    if (command == nullptr)
     {
-        m_webSocketServer.sendTXT(m_webSocketClients[i], msg);
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = "busy";
+        reply(request, m_responseDoc);
+        return;
     }
-}
\ No newline at end of file
+
+    uint32_t id = 0;
+    const char* name = request.json["name"];
+    bool empty = request.json["code"].isNull() && request.json["timings"].isNull();
+    const char* error = empty ? "empty code" : parseIrCode(request.json, *command);
+    if (error == nullptr && name != nullptr && strlen(name) > IrLibrary::kMaxNameLength)
+    {
+        error = "name too long";
+    }
+    uint32_t requestedId = request.json["id"] | 0u;
+    if (error == nullptr && name != nullptr && *name != '\0' && requestedId != 0)
+    {
+        uint32_t named = IrLibrary::getInstance()->findByName(name);
+        if (named != 0 && named != requestedId)
+        {
+            error = "name in use";
+        }
+    }
+    if (error != nullptr)
+    {
+        m_responseDoc["error"] = error;
+    }
+    else
+    {
+        id = IrLibrary::getInstance()->store(requestedId, name, *command);
+        if (id == 0)
+        {
+            m_responseDoc["error"] = "store failed";
+        }
+    }
+    ir->releaseCommand(command);
+
+    m_responseDoc["success"] = id != 0;
+    if (id != 0)
+    {
+        m_responseDoc["id"] = id;
+    }
+    reply(request, m_responseDoc);
+}
+
+// Delete a code from the library by "id" or "name"
+void API::cmdIrDelete(const Request& request)
+{
+    IrLibrary* library = IrLibrary::getInstance();
+    uint32_t id = request.json.containsKey("id") ? request.json["id"].as<uint32_t>() : library->findByName(request.json["name"].as<const char*>());
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_delete";
+    m_responseDoc["id"] = id;
+    m_responseDoc["success"] = library->remove(id);
+    reply(request, m_responseDoc);
+}
+
+// List the codes in the library
+void API::cmdIrList(const Request& request)
+{
+    IrLibrary* library = IrLibrary::getInstance();
+    uint16_t count = library->count();
+
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(count)
+                            + count * (JSON_OBJECT_SIZE(3) + IrLibrary::kMaxNameLength + 1));
+    doc["type"] = "dock";
+    doc["message"] = "ir_list";
+    JsonArray codes = doc.createNestedArray("codes");
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        IrLibrary::Info info;
+        if (!library->info(i, info))
+        {
+            continue;
+        }
+        JsonObject code = codes.createNestedObject();
+        code["id"] = info.id;
+        code["name"] = static_cast<char*>(info.name);
+        code["format"] = info.type == InfraredService::IrCommand::TYPE_HEX ? "hex" : "raw";
+    }
+
+    reply(request, doc);
+}
+
+// Tell the client that queued the IR code how it went
+void API::sendIrResult(const InfraredService::IrSendResult& result)
+{
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["req_id"] = result.requestId;
+    m_responseDoc["success"] = result.success;
+    m_responseDoc["latency_us"] = result.latency;
+
+    if (result.stepCount > 0)
+    {
+        m_responseDoc["message"] = "ir_send_batch_step";
+        m_responseDoc["step"] = result.step;
+        m_responseDoc["done"] = result.step + 1 == result.stepCount;
+    } else {
+        m_responseDoc["message"] = "ir_send_done";
+    }
+
+    Request request = { JsonObjectConst(), result.clientId, static_cast<Source>(result.origin) };
+    if (isAuthorized(request.id, request.source))
+    {
+        reply(request, m_responseDoc);
+    }
+}
+
+// Turn on IR receiving
+void API::cmdIrReceiveOn(const Request& request)
+{
+    InfraredService::getInstance()->setReceiving(true);
+    LOG_INFO("API", "IR Receive on");
+}
+
+// Turn off IR receiving
+void API::cmdIrReceiveOff(const Request& request)
+{
+    InfraredService::getInstance()->setReceiving(false);
+    LOG_INFO("API", "IR Receive off");
+}
+
+// Stream raw timings of received codes to this client as binary IrRawCodec frames,
+// "mode" is "unknown" (codes no decoder recognized, the default), "all" or "off".
+// The capture mode is shared, the last client to set it wins.
+void API::cmdIrReceiveRaw(const Request& request)
+{
+    const char* mode = request.json["mode"] | "unknown";
+    InfraredService::RawMode rawMode = InfraredService::RAW_UNKNOWN;
+    bool success = true;
+
+    if (strcmp(mode, "all") == 0)
+    {
+        rawMode = InfraredService::RAW_ALL;
+    }
+    else if (strcmp(mode, "off") == 0)
+    {
+        rawMode = InfraredService::RAW_OFF;
+    }
+    else if (strcmp(mode, "unknown") != 0)
+    {
+        success = false;
+    }
+
+    // frames are binary, they only go to websocket clients
+    if (request.source != SOURCE_WEBSOCKET || request.id >= WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        success = false;
+    }
+
+    if (success)
+    {
+        InfraredService* ir = InfraredService::getInstance();
+        if (rawMode == InfraredService::RAW_OFF)
+        {
+            unsubscribeRaw(request.id);
+        } else {
+            m_rawClients |= (1UL << request.id);
+            ir->rawMode = rawMode;
+            ir->setReceiving(true);
+        }
+        LOG_INFO("API", "IR Receive raw %s", mode);
+    }
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_receive_raw";
+    m_responseDoc["success"] = success;
+    reply(request, m_responseDoc);
+}
+
+void API::unsubscribeRaw(uint8_t num)
+{
+    if (num < WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        m_rawClients &= ~(1UL << num);
+    }
+    if (m_rawClients == 0)
+    {
+        InfraredService::getInstance()->rawMode = InfraredService::RAW_OFF;
+    }
+}
+
+void API::sendRawFrame(const InfraredService::RawFrame& frame)
+{
+    uint32_t dropped = InfraredService::getInstance()->rawDropped();
+    if (dropped != m_rawDroppedReported)
+    {
+        LOG_WARN("API", "%u raw captures dropped", dropped - m_rawDroppedReported);
+        m_rawDroppedReported = dropped;
+    }
+
+    // a client keeps its subscription only while it is authenticated
+    uint32_t clients = m_rawClients & m_authClients;
+    if (clients == 0)
+    {
+        return;
+    }
+
+    Message* message = createMessage(frame.length, true);
+    if (message == nullptr)
+    {
+        return;
+    }
+    memcpy(message->data, frame.data, frame.length);
+    message->length = frame.length;
+
+    for (; clients != 0; clients &= clients - 1)
+    {
+        enqueue(__builtin_ctz(clients), message, POLICY_DROP_OLDEST);
+    }
+    releaseMessage(message);
+}
+
+// A binary IrRawCodec frame from a websocket client, sent once like ir_send_raw
+// and acknowledged in the client's format
+void API::processRawFrame(uint8_t num, const uint8_t* data, size_t length)
+{
+    LOG_DEBUG("API", "Raw IR frame, %u bytes", length);
+    if (!isAuthorized(num, SOURCE_WEBSOCKET))
+    {
+        return;
+    }
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_send_raw";
+
+    InfraredService* ir = InfraredService::getInstance();
+    InfraredService::IrCommand* command = ir->acquireCommand();
+    if (command == nullptr)
+    {
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = "queue full";
+        send(num, m_responseDoc);
+        return;
+    }
+
+    uint16_t count;
+    uint32_t frequency;
+    int32_t protocol;
+    if (!IrRawCodec::decode(data, length, command->words, InfraredService::kMaxCodeWords, count, frequency, protocol)
+        || count == 0 || (frequency != 0 && (frequency < kMinCarrierFrequency || frequency > kMaxCarrierFrequency)))
+    {
+        ir->releaseCommand(command);
+        m_responseDoc["success"] = false;
+        m_responseDoc["error"] = "invalid raw frame";
+        send(num, m_responseDoc);
+        return;
+    }
+
+    command->type = InfraredService::IrCommand::TYPE_RAW;
+    command->origin = SOURCE_WEBSOCKET;
+    command->clientId = num;
+    command->count = count;
+    command->onceCount = 0;
+    command->repeat = 0;
+    command->frequency = frequency != 0 ? frequency : 38000;
+
+    m_responseDoc["success"] = true;
+    m_responseDoc["req_id"] = ir->enqueue(command);
+    send(num, m_responseDoc);
+}
+
+// Learn a button from several presses, e.g. {"type":"dock","command":"ir_learn_start","samples":3}
+// "samples" is 2..5 (3 by default), "timeout" the ms to wait for them (30 s by default).
+// An ir_learn_sample message follows for every press, ir_learn_done carries the code:
+// "code" in ir_send form when the presses decoded to one code, otherwise averaged "timings"
+// for ir_send_raw. "confidence" (0..100) says how well the presses agreed.
+void API::cmdIrLearnStart(const Request& request)
+{
+    InfraredService* ir = InfraredService::getInstance();
+    int samples = request.json["samples"] | 3;
+    uint32_t timeout = request.json["timeout"] | 30000u;
+    bool valid = samples >= IrLearning::kMinSamples && samples <= IrLearning::kMaxSamples;
+
+    bool wasReceiving = ir->isReceiving();
+    bool success = valid && ir->learning.start(samples, timeout);
+    if (success)
+    {
+        m_learnSource = request.source;
+        m_learnClient = request.id;
+        m_learnWasReceiving = wasReceiving;
+        m_learnReported = 0;
+        ir->setReceiving(true);
+        LOG_INFO("API", "IR Learn start, %d samples", samples);
+    }
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_learn_start";
+    m_responseDoc["success"] = success;
+    if (!success)
+    {
+        m_responseDoc["error"] = valid ? "busy" : "invalid samples";
+    }
+    reply(request, m_responseDoc);
+}
+
+void API::cmdIrLearnCancel(const Request& request)
+{
+    InfraredService* ir = InfraredService::getInstance();
+    bool success = ir->learning.active();
+    if (success)
+    {
+        ir->learning.cancel();
+        ir->setReceiving(m_learnWasReceiving);
+        LOG_INFO("API", "IR Learn cancelled");
+    }
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "ir_learn_cancel";
+    m_responseDoc["success"] = success;
+    reply(request, m_responseDoc);
+}
+
+// Progress and the outcome of a learning session, to the client that started it
+void API::pollLearning()
+{
+    InfraredService* ir = InfraredService::getInstance();
+    const IrLearning::Result* result = ir->learning.result();
+    if (result == nullptr && !ir->learning.active())
+    {
+        return;
+    }
+
+    Request request = { JsonObjectConst(), m_learnClient, m_learnSource };
+    bool connected = isAuthorized(request.id, request.source);
+    uint8_t collected = result != nullptr ? result->samples : ir->learning.collected();
+
+    while (m_learnReported < collected)
+    {
+        m_learnReported++;
+        if (connected)
+        {
+            m_responseDoc.clear();
+            m_responseDoc["type"] = "dock";
+            m_responseDoc["message"] = "ir_learn_sample";
+            m_responseDoc["sample"] = m_learnReported;
+            reply(request, m_responseDoc);
+        }
+    }
+
+    if (result != nullptr)
+    {
+        if (connected)
+        {
+            sendLearnResult(request, *result);
+        }
+        ir->learning.releaseResult();
+        ir->setReceiving(m_learnWasReceiving);
+    }
+}
+
+void API::sendLearnResult(const Request& request, const IrLearning::Result& result)
+{
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(10) + JSON_ARRAY_SIZE(result.count) + sizeof(result.hex) + 24);
+    doc["type"] = "dock";
+    doc["message"] = "ir_learn_done";
+    doc["success"] = result.success;
+    doc["samples"] = result.samples;
+    doc["used"] = result.used;
+    doc["confidence"] = result.confidence;
+
+    if (!result.success)
+    {
+        doc["error"] = result.error;
+    }
+    else if (result.decoded)
+    {
+        InfraredService::IrReceived code;
+        code.protocol = result.protocol;
+        code.value = result.value;
+        code.bits = result.bits;
+        code.repeat = 0;
+        strlcpy(code.hex, result.hex, sizeof(code.hex));
+
+        char codeString[sizeof(code.hex) + 24];
+        InfraredService::codeToString(code, codeString, sizeof(codeString));
+        doc["format"] = "hex";
+        doc["code"] = static_cast<char*>(codeString);
+    }
+    else
+    {
+        doc["format"] = "raw";
+        doc["frequency"] = 38000;
+        JsonArray timings = doc.createNestedArray("timings");
+        for (uint16_t i = 0; i < result.count; i++)
+        {
+            timings.add(result.timings[i]);
+        }
+    }
+
+    reply(request, doc);
+}
+
+// Change state to indicate remote is fully charged
+void API::cmdRemoteCharged(const Request& request)
+{
+    State::getInstance()->set(State::NORMAL_FULLYCHARGED);
+}
+
+// Change state to indicate remote is low battery
+void API::cmdRemoteLowBattery(const Request& request)
+{
+    State::getInstance()->set(State::NORMAL_LOWBATTERY);
+}
+
+// Change friendly name
+void API::cmdSetFriendlyName(const Request& request)
+{
+    String dockFriendlyName = request.json["friendly_name"].as<const char*>();
+    Config::getInstance()->setFriendlyName(dockFriendlyName);
+    MDNSService::getInstance()->addFriendlyName(dockFriendlyName);
+}
+
+// Reboot the dock
+void API::cmdReboot(const Request& request)
+{
+    LOG_INFO("API", "Rebooting");
+    State::getInstance()->reboot();
+}
+
+// Erase and reset the dock
+void API::cmdReset(const Request& request)
+{
+    LOG_INFO("API", "Reset");
+    Config::getInstance()->reset();
+}
+
+// Switch the wire format of a websocket client, the reply already uses the new format
+void API::cmdSetProtocol(const Request& request)
+{
+    const char* protocol = request.json["protocol"] | "json";
+    bool msgpack = strcmp(protocol, "msgpack") == 0;
+    bool success = msgpack || strcmp(protocol, "json") == 0;
+
+    if (success && request.source == SOURCE_WEBSOCKET && request.id < WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        m_clients[request.id].format = msgpack ? FORMAT_MSGPACK : FORMAT_JSON;
+    }
+
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "set_protocol";
+    m_responseDoc["protocol"] = msgpack ? "msgpack" : "json";
+    m_responseDoc["success"] = success;
+    reply(request, m_responseDoc);
+}
+
+// NVS write counters of the settings, to keep an eye on flash wear
+void API::cmdConfigStats(const Request& request)
+{
+    Config* config = Config::getInstance();
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(7) + JSON_OBJECT_SIZE(Config::KEY_COUNT)> doc;
+    doc["type"] = "dock";
+    doc["message"] = "config_stats";
+    doc["writes"] = config->nvsWrites();
+    doc["commits"] = config->nvsCommits();
+    doc["skipped"] = config->skippedWrites();
+    doc["pending"] = config->pendingWrites();
+
+    JsonObject keys = doc.createNestedObject("keys");
+    for (int key = 0; key < Config::KEY_COUNT; key++)
+    {
+        keys[Config::keyName(static_cast<Config::Key>(key))] = config->keyWrites(static_cast<Config::Key>(key));
+    }
+    reply(request, doc);
+}
+
+// Dock health, e.g. {"type":"dock","command":"stats","interval":5000}
+// Times are in us. The "histogram" of main loop wake-ups counts them by duration, bucket i
+// ends at "histogram_us"[i], the last one is open. "stack_free" is the stack each task never
+// touched so far, in bytes. "interval" (ms, websocket only) also pushes the stats to this
+// client that often, 0 stops it. "reset" starts the counters over after the reply.
+void API::cmdStats(const Request& request)
+{
+    bool success = true;
+    if (request.json.containsKey("interval"))
+    {
+        uint32_t interval = request.json["interval"];
+        if (request.source != SOURCE_WEBSOCKET || request.id >= WEBSOCKETS_SERVER_CLIENT_MAX
+            || (interval != 0 && interval < kMinStatsInterval))
+        {
+            success = false;
+        }
+        else if (interval == 0)
+        {
+            m_statsClients &= ~(1UL << request.id);
+        } else {
+            // shared by all subscribers, the last one to set it wins
+            m_statsClients |= (1UL << request.id);
+            m_statsInterval = interval;
+            m_statsPushedAt = millis();
+        }
+    }
+
+    DynamicJsonDocument doc(kStatsDocSize);
+    fillStats(doc);
+    doc["success"] = success;
+    reply(request, doc);
+
+    if (request.json["reset"] | false)
+    {
+        Profiler::reset();
+    }
+}
+
+void API::pushStats()
+{
+    uint32_t clients = m_statsClients & m_authClients;
+    if (clients == 0 || millis() - m_statsPushedAt < m_statsInterval)
+    {
+        return;
+    }
+    m_statsPushedAt = millis();
+
+    DynamicJsonDocument doc(kStatsDocSize);
+    fillStats(doc);
+    broadcast(doc, FORMAT_JSON, POLICY_DROP_OLDEST, clients);
+    broadcast(doc, FORMAT_MSGPACK, POLICY_DROP_OLDEST, clients);
+}
+
+void API::fillStats(JsonDocument& doc)
+{
+    doc["type"] = "dock";
+    doc["message"] = "stats";
+    doc["uptime"] = millis();
+
+    const Profiler::Counter& loop = Profiler::get(Profiler::MAIN_LOOP);
+    JsonObject loopStats = doc.createNestedObject("loop");
+    addCounter(loopStats, nullptr, Profiler::MAIN_LOOP);
+    loopStats["busy"] = Profiler::busyPercent(Profiler::MAIN_LOOP);
+    JsonArray histogram = loopStats.createNestedArray("histogram");
+    JsonArray limits = doc.createNestedArray("histogram_us");
+    for (uint8_t i = 0; i < Profiler::kHistogramBuckets; i++)
+    {
+        histogram.add(loop.histogram[i]);
+        if (Profiler::bucketLimit(i) != 0)
+        {
+            limits.add(Profiler::bucketLimit(i));
+        }
+    }
+
+    JsonObject services = doc.createNestedObject("services");
+    addCounter(services, "api", Profiler::API_LOOP);
+    addCounter(services, "ir_receive", Profiler::IR_RECEIVE);
+    addCounter(services, "mdns", Profiler::MDNS_LOOP);
+    addCounter(services, "ota", Profiler::OTA_HANDLE);
+
+    InfraredService* ir = InfraredService::getInstance();
+    JsonObject irStats = doc.createNestedObject("ir");
+    addCounter(irStats, "send_latency", Profiler::IR_SEND_LATENCY);
+    addCounter(irStats, "decode", Profiler::IR_DECODE);
+    irStats["queue"] = ir->queueDepth();
+
+    JsonObject clients = doc.createNestedObject("clients");
+    JsonArray queues = clients.createNestedArray("queues");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++)
+    {
+        if (m_webSocketServer.connected(num))
+        {
+            queues.add(m_clients[num].count);
+        }
+    }
+    clients["connected"] = queues.size();
+
+    WifiService* wifi = WifiService::getInstance();
+    JsonObject wifiStats = doc.createNestedObject("wifi");
+    wifiStats["connected"] = wifi->isConnected();
+    wifiStats["rssi"] = WiFi.RSSI();
+    wifiStats["channel"] = WiFi.channel();
+    wifiStats["reconnects"] = wifi->reconnects();
+    wifiStats["connect_ms"] = wifi->lastConnectTime();
+
+    // us since the chip started, phases not reached yet are left out
+    JsonObject boot = doc.createNestedObject("boot_us");
+    for (uint8_t i = 0; i < Profiler::BOOT_PHASE_COUNT; i++)
+    {
+        Profiler::BootPhase phase = static_cast<Profiler::BootPhase>(i);
+        if (Profiler::bootTime(phase) != 0)
+        {
+            boot[Profiler::bootName(phase)] = Profiler::bootTime(phase);
+        }
+    }
+
+    JsonObject heap = doc.createNestedObject("heap");
+    heap["free"] = ESP.getFreeHeap();
+    heap["min_free"] = ESP.getMinFreeHeap();
+    heap["largest_block"] = ESP.getMaxAllocHeap();
+
+    // the API runs on the main loop task
+    JsonObject stacks = doc.createNestedObject("stack_free");
+    stacks["main"] = uxTaskGetStackHighWaterMark(nullptr);
+    stacks["ir_send"] = ir->sendStackFree();
+    stacks["ir_receive"] = ir->receiveStackFree();
+    stacks["led"] = LedControl::getInstance()->stackFree();
+}
+
+// calls, average and longest time of a counter, into a nested object unless key is null
+void API::addCounter(JsonObject object, const char* key, Profiler::Counters counter)
+{
+    const Profiler::Counter& c = Profiler::get(counter);
+    JsonObject target = key != nullptr ? object.createNestedObject(key) : object;
+    target["calls"] = c.calls;
+    target["avg_us"] = c.calls > 0 ? Profiler::cyclesToUs(c.totalCycles / c.calls) : 0;
+    target["max_us"] = Profiler::cyclesToUs(c.maxCycles);
+}
+
+// The trace ring, see Trace::dump() for the layout. Websocket clients get it as a binary
+// message after the reply, serial and bluetooth as hex in the reply's "data".
+void API::cmdTraceDump(const Request& request)
+{
+    size_t size = Trace::dumpSize();
+    Message* message = createMessage(size, true);
+    if (message == nullptr)
+    {
+        m_responseDoc.clear();
+        m_responseDoc["type"] = "dock";
+        m_responseDoc["message"] = "trace_dump";
+        m_responseDoc["success"] = false;
+        reply(request, m_responseDoc);
+        return;
+    }
+    message->length = Trace::dump(reinterpret_cast<uint8_t*>(message->data), size);
+
+    bool binary = request.source == SOURCE_WEBSOCKET && request.id < WEBSOCKETS_SERVER_CLIENT_MAX;
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(5) + (binary ? 0 : message->length * 2 + 1));
+    doc["type"] = "dock";
+    doc["message"] = "trace_dump";
+    doc["success"] = true;
+    doc["length"] = message->length;
+
+    if (binary)
+    {
+        reply(request, doc);
+        enqueue(request.id, message, POLICY_KEEP);
+    } else {
+        // the document keeps its own copy of the text
+        char* hex = reinterpret_cast<char*>(malloc(message->length * 2 + 1));
+        if (hex != nullptr)
+        {
+            static const char digits[] = "0123456789abcdef";
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(message->data);
+            for (size_t i = 0; i < message->length; i++)
+            {
+                hex[i * 2] = digits[data[i] >> 4];
+                hex[i * 2 + 1] = digits[data[i] & 0x0F];
+            }
+            hex[message->length * 2] = '\0';
+            doc["data"] = hex;
+            free(hex);
+        } else {
+            doc["success"] = false;
+        }
+        reply(request, doc);
+    }
+    releaseMessage(message);
+}
+
+// Decoded IR codes, everything that queued up since the last loop goes out in one broadcast.
+// JSON clients get "code" as "<protocol>;<hex>;<bits>;<repeat>", msgpack clients numeric fields.
+// With more than one code "codes" holds all of them, "code" stays the first for older clients.
+void API::sendIrReceived(const InfraredService::IrReceived* codes, size_t count, uint32_t dropped)
+{
+    for (int format = FORMAT_JSON; format <= FORMAT_MSGPACK; format++)
+    {
+        DynamicJsonDocument doc(JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(count)
+                                + count * (JSON_OBJECT_SIZE(4) + sizeof(codes[0].hex) + 24));
+        doc["type"] = "dock";
+        doc["command"] = "ir_receive";
+        if (dropped > 0)
+        {
+            doc["dropped"] = dropped;
+        }
+
+        JsonArray list;
+        if (count > 1)
+        {
+            list = doc.createNestedArray("codes");
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const InfraredService::IrReceived& code = codes[i];
+
+            if (format == FORMAT_JSON)
+            {
+                char codeString[sizeof(code.hex) + 24];
+                InfraredService::codeToString(code, codeString, sizeof(codeString));
+                if (i == 0)
+                {
+                    doc["code"] = codeString;
+                }
+                if (count > 1)
+                {
+                    list.add(codeString);
+                }
+            } else {
+                JsonObject fields = count > 1 ? list.createNestedObject() : doc.as<JsonObject>();
+                fields["protocol"] = static_cast<int>(code.protocol);
+                // AC states are longer than 64 bits, those stay a hex string
+                if (code.bits <= 64)
+                {
+                    fields["code"] = code.value;
+                } else {
+                    fields["code"] = code.hex;
+                }
+                fields["bits"] = code.bits;
+                fields["repeat"] = code.repeat;
+            }
+        }
+
+        broadcast(doc, static_cast<Format>(format), POLICY_DROP_OLDEST);
+    }
+}
+
+void API::sendState()
+{
+    State* state = State::getInstance();
+    m_responseDoc.clear();
+    m_responseDoc["type"] = "dock";
+    m_responseDoc["message"] = "state";
+    m_responseDoc["state"] = State::name(state->get());
+    m_responseDoc["charging"] = state->isCharging();
+    broadcast(m_responseDoc, FORMAT_JSON, POLICY_DROP_OLDEST);
+    broadcast(m_responseDoc, FORMAT_MSGPACK, POLICY_DROP_OLDEST);
+}
+
+// The dock state and its last transitions, ages in ms
+void API::cmdGetState(const Request& request)
+{
+    State* state = State::getInstance();
+    State::Transition transitions[State::kLogSize];
+    uint8_t count = state->history(transitions, State::kLogSize);
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(State::kLogSize) + State::kLogSize * JSON_OBJECT_SIZE(3)> doc;
+    doc["type"] = "dock";
+    doc["message"] = "get_state";
+    doc["state"] = State::name(state->get());
+    doc["charging"] = state->isCharging();
+    doc["rejected"] = state->rejected();
+
+    uint32_t now = millis();
+    JsonArray list = doc.createNestedArray("transitions");
+    for (uint8_t i = 0; i < count; i++)
+    {
+        JsonObject transition = list.createNestedObject();
+        transition["from"] = State::name(static_cast<State::States>(transitions[i].from));
+        transition["to"] = State::name(static_cast<State::States>(transitions[i].to));
+        transition["age"] = now - transitions[i].time;
+    }
+    reply(request, doc);
+}
+
+// Outbound queue figures of the connected websocket clients, since they connected
+void API::cmdClientStats(const Request& request)
+{
+    StaticJsonDocument<JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(WEBSOCKETS_SERVER_CLIENT_MAX)
+                       + WEBSOCKETS_SERVER_CLIENT_MAX * JSON_OBJECT_SIZE(7)> doc;
+    doc["type"] = "dock";
+    doc["message"] = "client_stats";
+    doc["queue_size"] = kClientQueueDepth;
+
+    JsonArray list = doc.createNestedArray("clients");
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++)
+    {
+        if (!m_webSocketServer.connected(num))
+        {
+            continue;
+        }
+        const Client& client = m_clients[num];
+        JsonObject entry = list.createNestedObject();
+        entry["id"] = num;
+        entry["authenticated"] = isAuthorized(num, SOURCE_WEBSOCKET);
+        entry["format"] = client.format == FORMAT_MSGPACK ? "msgpack" : "json";
+        entry["queued"] = client.count;
+        entry["peak"] = client.peak;
+        entry["sent"] = client.sent;
+        entry["dropped"] = client.dropped;
+    }
+    reply(request, doc);
+}
+
+void API::sendMessage(JsonDocument& doc)
+{
+    broadcast(doc, FORMAT_JSON);
+    broadcast(doc, FORMAT_MSGPACK);
+}
+
+void API::broadcast(JsonDocument& doc, Format format, Policy policy, uint32_t clients)
+{
+    Message* message = nullptr;
+
+    for (clients &= m_authClients; clients != 0; clients &= clients - 1)
+    {
+        uint8_t num = __builtin_ctz(clients);
+        if (!usesFormat(num, format))
+        {
+            continue;
+        }
+
+        // serialized once, on the first client that needs it
+        if (message == nullptr)
+        {
+            message = createMessage(doc, format);
+            if (message == nullptr)
+            {
+                return;
+            }
+        }
+        enqueue(num, message, policy);
+    }
+
+    if (message != nullptr)
+    {
+        releaseMessage(message);
+    }
+}
+
+// The caller holds the first reference, every queue holding the message another one
+API::Message* API::createMessage(size_t size, bool binary)
+{
+    Message* message = reinterpret_cast<Message*>(malloc(sizeof(Message) + size));
+    if (message == nullptr)
+    {
+        LOG_ERROR("API", "Out of memory, message dropped");
+        return nullptr;
+    }
+    message->refs = 1;
+    message->binary = binary;
+    message->length = 0;
+    message->data = reinterpret_cast<char*>(message + 1);
+    return message;
+}
+
+API::Message* API::createMessage(JsonDocument& doc, Format format)
+{
+    bool msgpack = format == FORMAT_MSGPACK;
+    size_t size = (msgpack ? measureMsgPack(doc) : measureJson(doc)) + 1;
+    Message* message = createMessage(size, msgpack);
+    if (message != nullptr)
+    {
+        message->length = msgpack ? serializeMsgPack(doc, message->data, size) : serializeJson(doc, message->data, size);
+    }
+    return message;
+}
+
+void API::releaseMessage(Message* message)
+{
+    if (--message->refs == 0)
+    {
+        free(message);
+    }
+}
+
+void API::enqueue(uint8_t num, Message* message, Policy policy)
+{
+    Client& client = m_clients[num];
+
+    // a full queue makes room by dropping its oldest event, responses are never dropped
+    if (client.count == kClientQueueDepth && !dropOldestEvent(client))
+    {
+        client.dropped++;
+        if (policy == POLICY_KEEP)
+        {
+            // the client stopped reading, better to lose it than to block everyone else
+            client.overflow = true;
+        }
+        return;
+    }
+
+    Outbound& entry = client.queue[(client.head + client.count) % kClientQueueDepth];
+    entry.message = message;
+    entry.policy = policy;
+    message->refs++;
+    client.count++;
+    if (client.count > client.peak)
+    {
+        client.peak = client.count;
+    }
+}
+
+bool API::dropOldestEvent(Client& client)
+{
+    // a message partly written already has to be finished
+    for (uint8_t i = client.offset > 0 ? 1 : 0; i < client.count; i++)
+    {
+        uint8_t index = (client.head + i) % kClientQueueDepth;
+        if (client.queue[index].policy != POLICY_DROP_OLDEST)
+        {
+            continue;
+        }
+
+        releaseMessage(client.queue[index].message);
+        // close the gap, the newer messages keep their order
+        for (uint8_t j = i + 1; j < client.count; j++)
+        {
+            uint8_t next = (client.head + j) % kClientQueueDepth;
+            client.queue[index] = client.queue[next];
+            index = next;
+        }
+        client.count--;
+        client.dropped++;
+        return true;
+    }
+    return false;
+}
+
+// Writes queued messages while the client sockets take them, a client that can't keep up
+// only delays itself
+void API::flush()
+{
+    for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++)
+    {
+        Client& client = m_clients[num];
+        if (client.overflow)
+        {
+            LOG_WARN("API", "[%u] Not reading its responses, disconnecting", num);
+            m_webSocketServer.disconnect(num);
+            resetClient(num);
+            continue;
+        }
+
+        // no more than a writable socket takes per check, a large message continues on the next flush
+        while (client.count > 0 && m_webSocketServer.writable(num))
+        {
+            Message* message = client.queue[client.head].message;
+            size_t chunk = message->length - client.offset;
+            if (chunk > ApiSocketServer::kWriteChunk)
+            {
+                chunk = ApiSocketServer::kWriteChunk;
+            }
+            bool first = client.offset == 0;
+            bool last = client.offset + chunk == message->length;
+
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(message->data) + client.offset;
+            if (!m_webSocketServer.sendFragment(num, message->binary, data, chunk, first, last))
+            {
+                // the rest of a message can't follow a failed write
+                LOG_WARN("API", "[%u] Write failed, disconnecting", num);
+                m_webSocketServer.disconnect(num);
+                resetClient(num);
+                break;
+            }
+
+            client.offset += chunk;
+            if (last)
+            {
+                client.head = (client.head + 1) % kClientQueueDepth;
+                client.count--;
+                client.sent++;
+                client.offset = 0;
+                releaseMessage(message);
+            }
+        }
+    }
+}
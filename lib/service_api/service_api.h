@@ -4,14 +4,30 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WebSocketsServer.h>
+#include "api_socket_server.h"
 #include <config.h>
 #include <state.h>
 #include <service_ir.h>
 #include <led_control.h>
+#include <frame_parser.h>
+#include <profiler.h>
+#include <fnv_hash.h>
 
 class API
 {
 public:
+    enum Source {
+        SOURCE_WEBSOCKET    =   0,
+        SOURCE_SERIAL       =   1,
+        SOURCE_BLUETOOTH    =   2
+    };
+
+    // wire format of a message, websocket clients switch with the set_protocol command
+    enum Format {
+        FORMAT_JSON         =   0,
+        FORMAT_MSGPACK      =   1
+    };
+
     explicit API();
     virtual ~API(){}
 
@@ -19,21 +35,181 @@ public:
 
     void                  init();
     void                  loop();
-    void                  processData(String response, int id, String type);
-    void                  sendMessage(String msg);
+
+    // data is deserialized in place, strings in the parsed document point into it
+    void                  processData(char* data, size_t length, int id, Source source, Format format = FORMAT_JSON);
+
+    // sends the document to every authorized client, serialized once per format in use
+    void                  sendMessage(JsonDocument& doc);
+
+    // tells every client the dock state changed
+    void                  sendState();
 
 private:
+    // a parsed message, handed to the command handlers
+    struct Request {
+        JsonObjectConst   json;
+        int               id;
+        Source            source;
+    };
+
+    // what a full client queue does with a message
+    enum Policy {
+        POLICY_KEEP         =   0,      // command responses, never dropped
+        POLICY_DROP_OLDEST  =   1       // events, the oldest queued event makes room
+    };
+
+    // a serialized message, shared by the queues of every client it goes to
+    struct Message {
+        uint16_t          refs;
+        bool              binary;
+        size_t            length;
+        char*             data;         // follows the struct in the same allocation
+    };
+
+    struct Outbound {
+        Message*          message;
+        Policy            policy;
+    };
+
+    static const uint8_t  kClientQueueDepth = 16;
+
+    // a websocket slot, reset when a client connects to it or leaves
+    struct Client {
+        Format            format;
+        Outbound          queue[kClientQueueDepth];
+        uint8_t           head;
+        uint8_t           count;
+        uint8_t           peak;         // deepest the queue got
+        bool              overflow;     // a response didn't fit, disconnected on the next flush
+        size_t            offset;       // bytes of the head message already written
+        uint32_t          sent;
+        uint32_t          dropped;
+    };
+
+    typedef void (API::*CommandHandler)(const Request& request);
+
+    struct Command {
+        uint32_t          hash;
+        const char*       name;
+        CommandHandler    handler;
+    };
+
     static API*           s_instance;
+    static const Command  s_commands[];
+
     // Config*               m_config = Config::getInstance();
     // State*                m_state = State::getInstance();
     // InfraredService*      m_ir = InfraredService::getInstance();
     // LedControl*           m_led = LedControl::getInstance();
 
-    WebSocketsServer      m_webSocketServer = WebSocketsServer(946);
-    uint8_t               m_webSocketClients[100] = {};
-    int                   m_webSocketClientsCount = 0;
+    static_assert(WEBSOCKETS_SERVER_CLIENT_MAX <= 32, "one bit per websocket client");
+
+    ApiSocketServer       m_webSocketServer = ApiSocketServer(946);
+    Client                m_clients[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+    uint32_t              m_authClients = 0;      // bit per authenticated websocket client
+    uint32_t              m_rawClients = 0;       // bit per websocket client subscribed to raw captures
+    uint32_t              m_statsClients = 0;     // bit per websocket client getting periodic stats
+    uint32_t              m_statsInterval = 0;    // ms
+    uint32_t              m_statsPushedAt = 0;
+
+    // sized for the longest code an ir_send can carry, as pronto words or raw timings
+    static const size_t   kRequestDocSize = JSON_OBJECT_SIZE(16) + JSON_ARRAY_SIZE(InfraredService::kMaxCodeWords);
+
+    // the longest message the serial port takes, an ir_send with a long pronto code
+    static const size_t   kSerialFrameSize = 4096;
+    static const uint32_t kSerialIdleTimeout = 1000;    // ms, drops a frame cut short
+    FrameParser<kSerialFrameSize> m_serialParser{kSerialIdleTimeout};
+
+    static const uint32_t kMinStatsInterval = 1000;     // ms
+
+    // ir_send_batch step limits, the send task is busy with a step until it is done
+    static const uint16_t kMaxBatchCount = 100;
+    static const uint16_t kMaxBatchInterval = 10000;    // ms
+    static const uint32_t kMaxBatchDelay = 10000;       // ms
+
+    // carrier of a raw code or pronto word array, IR LEDs and receivers work around 30 to 56 kHz
+    static const uint16_t kMinCarrierFrequency = 10000; // Hz
+    static const uint16_t kMaxCarrierFrequency = 60000; // Hz
+    static const size_t   kStatsDocSize = JSON_OBJECT_SIZE(13)
+                                          + JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(Profiler::kHistogramBuckets) * 2
+                                          + JSON_OBJECT_SIZE(4) + 4 * JSON_OBJECT_SIZE(3)
+                                          + JSON_OBJECT_SIZE(3) + 2 * JSON_OBJECT_SIZE(3)
+                                          + JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(WEBSOCKETS_SERVER_CLIENT_MAX)
+                                          + JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(Profiler::BOOT_PHASE_COUNT)
+                                          + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(4);
+
+    DynamicJsonDocument   m_requestDoc = DynamicJsonDocument(kRequestDocSize);
+    StaticJsonDocument<200> m_responseDoc;
+
+    InfraredService::IrReceived m_receivedCodes[InfraredService::kReceiveQueueSize];
+    uint32_t              m_receiveDroppedReported = 0;
+    uint32_t              m_rawDroppedReported = 0;
+    // the running learning session
+    Source                m_learnSource = SOURCE_SERIAL;
+    int                   m_learnClient = 0;
+    uint8_t               m_learnReported = 0;    // samples announced so far
+    bool                  m_learnWasReceiving = false;
 
     void                  handleSerial();
+    bool                  isAuthorized(int id, Source source);
+    const Command*        findCommand(const char* name);
+    void                  reply(const Request& request, JsonDocument& doc);
+    void                  send(uint8_t num, JsonDocument& doc, Policy policy = POLICY_KEEP);
+    bool                  usesFormat(uint8_t num, Format format);
+    void                  resetClient(uint8_t num);
+    void                  sendIrReceived(const InfraredService::IrReceived* codes, size_t count, uint32_t dropped);
+    // to the authorized clients among clients
+    void                  broadcast(JsonDocument& doc, Format format, Policy policy = POLICY_KEEP, uint32_t clients = UINT32_MAX);
+    // outbound queues, messages are written out by flush() as the sockets take them
+    Message*              createMessage(size_t size, bool binary);
+    Message*              createMessage(JsonDocument& doc, Format format);
+    void                  releaseMessage(Message* message);
+    void                  enqueue(uint8_t num, Message* message, Policy policy);
+    bool                  dropOldestEvent(Client& client);
+    void                  flush();
+    void                  sendIrResult(const InfraredService::IrSendResult& result);
+    void                  sendRawFrame(const InfraredService::RawFrame& frame);
+    void                  processRawFrame(uint8_t num, const uint8_t* data, size_t length);
+    void                  unsubscribeRaw(uint8_t num);
+    void                  pollLearning();
+    void                  sendLearnResult(const Request& request, const IrLearning::Result& result);
+    const char*           parseIrCode(JsonObjectConst json, InfraredService::IrCommand& command);
+    const char*           parseBatchTiming(JsonObjectConst step, InfraredService::IrCommand& command);
+    const char*           parseRepeat(JsonObjectConst json, InfraredService::IrCommand& command);
+    static const char*    sourceName(Source source);
+
+    void                  handleWifiSettings(const Request& request);
+    void                  handleAuth(const Request& request);
+
+    // dock commands
+    void                  cmdPing(const Request& request);
+    void                  cmdLedBrightnessStart(const Request& request);
+    void                  cmdLedBrightnessStop(const Request& request);
+    void                  cmdIrSend(const Request& request);
+    void                  cmdIrSendBatch(const Request& request);
+    void                  cmdIrStore(const Request& request);
+    void                  cmdIrDelete(const Request& request);
+    void                  cmdIrList(const Request& request);
+    void                  cmdIrReceiveOn(const Request& request);
+    void                  cmdIrReceiveOff(const Request& request);
+    void                  cmdIrReceiveRaw(const Request& request);
+    void                  cmdIrLearnStart(const Request& request);
+    void                  cmdIrLearnCancel(const Request& request);
+    void                  cmdRemoteCharged(const Request& request);
+    void                  cmdRemoteLowBattery(const Request& request);
+    void                  cmdSetFriendlyName(const Request& request);
+    void                  cmdReboot(const Request& request);
+    void                  cmdReset(const Request& request);
+    void                  cmdSetProtocol(const Request& request);
+    void                  cmdConfigStats(const Request& request);
+    void                  cmdGetState(const Request& request);
+    void                  cmdClientStats(const Request& request);
+    void                  cmdStats(const Request& request);
+    void                  cmdTraceDump(const Request& request);
+    void                  fillStats(JsonDocument& doc);
+    void                  pushStats();
+    static void           addCounter(JsonObject object, const char* key, Profiler::Counters counter);
 };
 
-#endif
\ No newline at end of file
+#endif
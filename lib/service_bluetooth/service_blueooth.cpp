@@ -1,4 +1,7 @@
 #include "service_blueooth.h"
+#include "events.h"
+#include "log.h"
+#include "esp_bt.h"
 
 BluetoothService* BluetoothService::s_instance = nullptr;
 
@@ -9,47 +12,101 @@ BluetoothService::BluetoothService()
 
 void BluetoothService::init()
 {
-  m_bluetooth->register_callback([=](esp_spp_cb_event_t event, esp_spp_cb_param_t *param){
+  m_bluetooth = new BluetoothSerial();
+  m_bluetooth->register_callback([](esp_spp_cb_event_t event, esp_spp_cb_param_t *param){
     if(event == ESP_SPP_SRV_OPEN_EVT){
-      Serial.println(F("[BLUETOOTH] Client Connected"));
+      LOG_INFO("BLUETOOTH", "Client Connected");
+    }
+
+    // received data is queued by now, the main loop picks it up
+    if(event == ESP_SPP_DATA_IND_EVT){
+      Events::post(Events::EVENT_BLUETOOTH);
     }
 
     if(event == ESP_SPP_CLOSE_EVT ){
-      Serial.println(F("[BLUETOOTH] Client disconnected"));
+      LOG_INFO("BLUETOOTH", "Client disconnected");
+      // the SPP API takes a plain function, the service is reached through its instance
+      s_instance->m_disconnected = true;
     }
   });
 
   if (m_bluetooth->begin(m_config->getHostName())) {
-      Serial.println(F("[BLUETOOTH] Initialized. Ready for setup."));
+      LOG_INFO("BLUETOOTH", "Initialized. Ready for setup.");
   } else {
-    Serial.println(F("[BLUETOOTH] Failed to initialize."));
+    LOG_ERROR("BLUETOOTH", "Failed to initialize.");
+  }
+}
+
+void BluetoothService::release()
+{
+  if (m_bluetooth != nullptr)
+  {
+    return;
+  }
+  // a provisioned dock only goes back to setup through a reset and reboot
+  if (esp_bt_controller_mem_release(ESP_BT_MODE_BTDM) == ESP_OK)
+  {
+    LOG_INFO("BLUETOOTH", "Released controller memory");
   }
 }
 
 void BluetoothService::handle()
 {
-    char incomingChar = m_bluetooth->read();
-    int charAsciiNumber = incomingChar + 0;
-    if (charAsciiNumber != 255) //ASCII 255 is continually send
+    if (m_bluetooth == nullptr)
     {
-      m_bluetooth->print(incomingChar); //Echo send characters.
+      return;
     }
 
-    if (String(incomingChar) == "{")
+    // a partial frame of the last client must not prefix the next one
+    if (m_disconnected.exchange(false))
     {
-      m_interestingData = true;
-      m_receivedData = "";
+      m_parser.reset();
     }
-    else if (String(incomingChar) == "}")
+
+    uint8_t buffer[128];
+    uint32_t now = millis();
+    int available;
+    while ((available = m_bluetooth->available()) > 0)
     {
-      m_interestingData = false;
-      m_receivedData += "}";
-      m_api->processData(m_receivedData, 0, "bluetooth");
-      m_receivedData = "";
+      size_t length = m_bluetooth->readBytes(buffer, min(static_cast<size_t>(available), sizeof(buffer)));
+#ifdef YIO_BLUETOOTH_ECHO
+      m_bluetooth->write(buffer, length);
+#endif
+
+      for (size_t i = 0; i < length; i++)
+      {
+        if (m_parser.push(buffer[i], now))
+        {
+          API::getInstance()->processData(m_parser.frame(), m_parser.length(), 0, API::SOURCE_BLUETOOTH);
+        }
+      }
     }
-    if (m_interestingData)
+}
+
+void BluetoothService::send(JsonDocument& doc)
+{
+    if (m_bluetooth == nullptr)
+    {
+      return;
+    }
+
+    size_t size = measureJson(doc) + 2;
+
+    // one write per response, most fit on the stack
+    char stackBuffer[256];
+    char* message = size <= sizeof(stackBuffer) ? stackBuffer : reinterpret_cast<char*>(malloc(size));
+    if (message == nullptr)
     {
-      m_receivedData += String(incomingChar);
+      LOG_ERROR("BLUETOOTH", "Out of memory, response dropped");
+      return;
     }
-    delay(10);
-}
\ No newline at end of file
+
+    size_t length = serializeJson(doc, message, size);
+    message[length++] = '\n';
+    m_bluetooth->write(reinterpret_cast<uint8_t*>(message), length);
+
+    if (message != stackBuffer)
+    {
+      free(message);
+    }
+}
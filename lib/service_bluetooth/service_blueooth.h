@@ -2,11 +2,16 @@
 #define SERVICE_BLUETOOTH_H
 
 #include <Arduino.h>
+#include <atomic>
 #include <config.h>
 #include <state.h>
 #include <service_api.h>
+#include <frame_parser.h>
 #include "BluetoothSerial.h"
 
+// The setup channel over Bluetooth SPP, only up while the dock has no WiFi credentials.
+// Requests are JSON objects, each response goes back as one JSON object per line.
+// Build with YIO_BLUETOOTH_ECHO to echo the input, for typing into a serial terminal.
 class BluetoothService
 {
 public:
@@ -15,19 +20,27 @@ public:
 
     static BluetoothService* getInstance() { return s_instance; } 
 
+    // creates the SPP stack, only called in setup mode
     void init();
+    // hands the controller memory to the heap, Bluetooth can't start again until a reboot
+    void release();
+    // takes everything that arrived, doesn't wait
     void handle();
 
+    // a response to the setup client
+    void send(JsonDocument& doc);
+
 private:
     static BluetoothService* s_instance;
 
-    BluetoothSerial*              m_bluetooth = new BluetoothSerial();
+    BluetoothSerial*              m_bluetooth = nullptr;
     State*                        m_state = State::getInstance();
     Config*                       m_config = Config::getInstance();
-    API*                          m_api = API::getInstance();
 
-    String                        m_receivedData = "";
-    bool                          m_interestingData = false;
+    // setup messages, the WiFi credentials and a few commands
+    static const uint32_t         kFrameIdleTimeout = 1000;    // ms, drops a frame cut short
+    FrameParser<1024>             m_parser{kFrameIdleTimeout};
+    std::atomic<bool>             m_disconnected{false};   // set by the SPP callback
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include "ir_learning.h"
+#include "log.h"
+
+// timings further off the median than this are outliers, a quarter of the timing or 100 us
+static uint32_t tolerance(uint32_t median)
+{
+    return median / 4 > 100 ? median / 4 : 100;
+}
+
+bool IrLearning::start(uint8_t samples, uint32_t timeout)
+{
+    if (m_state.load(std::memory_order_acquire) != STATE_IDLE
+        || samples < kMinSamples || samples > kMaxSamples)
+    {
+        return false;
+    }
+
+    m_wanted = samples;
+    m_timeout = timeout;
+    m_startedAt = esp_timer_get_time();
+    m_collected.store(0, std::memory_order_relaxed);
+    m_session.fetch_add(1, std::memory_order_relaxed);
+    m_state.store(STATE_ACTIVE, std::memory_order_release);
+    return true;
+}
+
+void IrLearning::cancel()
+{
+    uint8_t expected = STATE_ACTIVE;
+    m_state.compare_exchange_strong(expected, STATE_IDLE, std::memory_order_acq_rel);
+}
+
+const IrLearning::Result* IrLearning::result()
+{
+    return m_state.load(std::memory_order_acquire) == STATE_DONE ? &m_result : nullptr;
+}
+
+void IrLearning::releaseResult()
+{
+    uint8_t expected = STATE_DONE;
+    m_state.compare_exchange_strong(expected, STATE_IDLE, std::memory_order_acq_rel);
+}
+
+bool IrLearning::addSample(const decode_results& results, const char* hex)
+{
+    // taken before the state, a start() after this shows as a new session number
+    uint32_t session = m_session.load(std::memory_order_acquire);
+    if (!active())
+    {
+        return false;
+    }
+
+    // a repeat frame carries no code, it isn't another sample of the button
+    if (results.repeat)
+    {
+        return true;
+    }
+
+    // a new session begins over, a count published late for the old one doesn't matter
+    uint8_t index = session == m_seenSession ? m_collected.load(std::memory_order_relaxed) : 0;
+    m_seenSession = session;
+    if (index >= m_wanted || index >= kMaxSamples)
+    {
+        return true;
+    }
+
+    Sample& sample = m_samples[index];
+    sample.protocol = results.decode_type;
+    sample.value = results.value;
+    sample.bits = results.bits;
+    strlcpy(sample.hex, hex, sizeof(sample.hex));
+
+    // rawbuf[0] is the gap before the code, the rest is in kRawTick units
+    uint16_t count = results.rawlen > 1 ? results.rawlen - 1 : 0;
+    sample.count = count <= kMaxTimings ? count : 0;
+    for (uint16_t i = 0; i < sample.count; i++)
+    {
+        uint32_t timing = static_cast<uint32_t>(results.rawbuf[i + 1]) * kRawTick;
+        sample.timings[i] = timing > UINT16_MAX ? UINT16_MAX : timing;
+    }
+
+    // restarted or cancelled while the sample was copied, it belongs to no session now
+    if (m_session.load(std::memory_order_acquire) != session || !active())
+    {
+        return true;
+    }
+    m_collected.store(++index, std::memory_order_release);
+    LOG_INFO("IR", "Learning sample %u of %u", index, m_wanted);
+
+    if (index == m_wanted)
+    {
+        finish(index, nullptr);
+    }
+    return true;
+}
+
+bool IrLearning::loop()
+{
+    uint32_t session = m_session.load(std::memory_order_acquire);
+    if (!active() || esp_timer_get_time() - m_startedAt <= static_cast<int64_t>(m_timeout) * 1000)
+    {
+        return false;
+    }
+
+    // make do with what came in, finish() drops the result when a new session started meanwhile
+    if (session != m_seenSession)
+    {
+        m_seenSession = session;
+        m_collected.store(0, std::memory_order_release);
+    }
+    uint8_t count = m_collected.load(std::memory_order_relaxed);
+    finish(count, count < kMinSamples ? "timeout" : nullptr);
+    return true;
+}
+
+void IrLearning::finish(uint8_t count, const char* error)
+{
+    m_result.samples = count;
+    m_result.used = 0;
+    m_result.confidence = 0;
+    m_result.decoded = false;
+    m_result.count = 0;
+
+    if (error == nullptr && !mergeDecoded(count) && !mergeRaw(count))
+    {
+        error = "captures differ";
+    }
+    m_result.success = error == nullptr;
+    m_result.error = error;
+
+    // a session cancelled meanwhile keeps its result to itself
+    uint8_t expected = STATE_ACTIVE;
+    if (m_session.load(std::memory_order_relaxed) == m_seenSession
+        && m_state.compare_exchange_strong(expected, STATE_DONE, std::memory_order_acq_rel))
+    {
+        LOG_INFO("IR", "Learning done, %u of %u samples used, confidence %u",
+                 m_result.used, m_result.samples, m_result.confidence);
+    }
+}
+
+// the code most captures decoded to, when that is more than half of them
+bool IrLearning::mergeDecoded(uint8_t count)
+{
+    uint8_t best = 0;
+    uint8_t bestVotes = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (m_samples[i].protocol == decode_type_t::UNKNOWN)
+        {
+            continue;
+        }
+        uint8_t votes = 0;
+        for (uint8_t j = 0; j < count; j++)
+        {
+            if (m_samples[j].protocol == m_samples[i].protocol && m_samples[j].bits == m_samples[i].bits
+                && strcmp(m_samples[j].hex, m_samples[i].hex) == 0)
+            {
+                votes++;
+            }
+        }
+        if (votes > bestVotes)
+        {
+            best = i;
+            bestVotes = votes;
+        }
+    }
+
+    if (bestVotes * 2 <= count)
+    {
+        return false;
+    }
+
+    const Sample& sample = m_samples[best];
+    m_result.decoded = true;
+    m_result.protocol = sample.protocol;
+    m_result.value = sample.value;
+    m_result.bits = sample.bits;
+    strlcpy(m_result.hex, sample.hex, sizeof(m_result.hex));
+    m_result.used = bestVotes;
+    m_result.confidence = bestVotes * 100 / count;
+    return true;
+}
+
+// per-timing average of the captures that agree with the median
+bool IrLearning::mergeRaw(uint8_t count)
+{
+    // the usual capture length, extra repeat frames or a cut off capture change it
+    uint16_t length = 0;
+    uint8_t lengthVotes = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t votes = 0;
+        for (uint8_t j = 0; j < count; j++)
+        {
+            if (m_samples[j].count == m_samples[i].count)
+            {
+                votes++;
+            }
+        }
+        if (m_samples[i].count > 0 && votes > lengthVotes)
+        {
+            length = m_samples[i].count;
+            lengthVotes = votes;
+        }
+    }
+    if (lengthVotes < kMinSamples)
+    {
+        return false;
+    }
+
+    bool inlier[kMaxSamples];
+    for (uint8_t i = 0; i < count; i++)
+    {
+        inlier[i] = m_samples[i].count == length;
+    }
+
+    // median of every timing, then drop captures with any timing out of tolerance
+    for (uint16_t k = 0; k < length; k++)
+    {
+        uint16_t values[kMaxSamples];
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (m_samples[i].count != length)
+            {
+                continue;
+            }
+            uint16_t value = m_samples[i].timings[k];
+            uint8_t position = n++;
+            while (position > 0 && values[position - 1] > value)
+            {
+                values[position] = values[position - 1];
+                position--;
+            }
+            values[position] = value;
+        }
+        uint32_t median = values[n / 2];
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (inlier[i] && static_cast<uint32_t>(abs(m_samples[i].timings[k] - static_cast<int32_t>(median))) > tolerance(median))
+            {
+                inlier[i] = false;
+            }
+        }
+    }
+
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        used += inlier[i] ? 1 : 0;
+    }
+    if (used < kMinSamples)
+    {
+        return false;
+    }
+
+    // average the inliers and measure how much they still scatter
+    uint32_t deviation = 0;     // summed relative deviation in 1/1000
+    for (uint16_t k = 0; k < length; k++)
+    {
+        uint32_t sum = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            sum += inlier[i] ? m_samples[i].timings[k] : 0;
+        }
+        uint32_t mean = (sum + used / 2) / used;
+        m_result.timings[k] = mean;
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (inlier[i] && mean > 0)
+            {
+                deviation += abs(m_samples[i].timings[k] - static_cast<int32_t>(mean)) * 1000 / mean;
+            }
+        }
+    }
+    uint32_t jitter = deviation / (static_cast<uint32_t>(length) * used);
+
+    // full marks for captures that all agree, 5% average jitter costs 10 points
+    uint32_t agreement = jitter * 2 < 1000 ? 1000 - jitter * 2 : 0;
+    m_result.count = length;
+    m_result.used = used;
+    m_result.confidence = agreement * used / count / 10;
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef IR_LEARNING_H
+#define IR_LEARNING_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "IRrecv.h"
+
+// Learns one button from several captures of it.
+// When most captures decode to the same code, that code is the result. Otherwise the captures
+// with the usual length are aligned, captures too far off the per-timing median are rejected
+// and the rest are averaged into a cleaned raw code.
+//
+// The API starts and cancels a session and collects the result, the IR service feeds it
+// captures from its receive loop. Only the session state is shared between the two.
+class IrLearning
+{
+public:
+    static const uint8_t        kMinSamples = 2;
+    static const uint8_t        kMaxSamples = 5;
+    static const uint16_t       kMaxTimings = 512;      // longer captures can only be learned decoded
+
+    struct Result {
+        bool                    success;
+        const char*             error;          // set when success is false
+        uint8_t                 samples;        // captures taken
+        uint8_t                 used;           // captures the result is built from
+        uint8_t                 confidence;     // 0..100
+        bool                    decoded;
+        decode_type_t           protocol;
+        uint64_t                value;
+        uint16_t                bits;
+        char                    hex[2 * kStateSizeMax + 3];
+        uint16_t                count;          // raw timings in microseconds, when not decoded
+        uint16_t                timings[kMaxTimings];
+    };
+
+    // API side
+    bool                        start(uint8_t samples, uint32_t timeout);
+    void                        cancel();
+    bool                        active() { return m_state.load(std::memory_order_acquire) == STATE_ACTIVE; }
+    uint8_t                     collected() { return m_collected.load(std::memory_order_acquire); }
+    // the finished session or nullptr, releaseResult() allows the next session
+    const Result*               result();
+    void                        releaseResult();
+
+    // IR side, returns false when no session wants the capture
+    bool                        addSample(const decode_results& results, const char* hex);
+    // ends a session that timed out, true when it did
+    bool                        loop();
+
+private:
+    enum State {
+        STATE_IDLE              =   0,
+        STATE_ACTIVE,
+        STATE_DONE
+    };
+
+    struct Sample {
+        decode_type_t           protocol;
+        uint64_t                value;
+        uint16_t                bits;
+        char                    hex[2 * kStateSizeMax + 3];
+        uint16_t                count;          // 0 when the capture was too long to keep
+        uint16_t                timings[kMaxTimings];
+    };
+
+    std::atomic<uint8_t>        m_state{STATE_IDLE};
+    std::atomic<uint8_t>        m_collected{0};
+    std::atomic<uint32_t>       m_session{0};   // bumped by start(), tells the IR side to begin over
+
+    // written by start() before the session is published
+    uint8_t                     m_wanted = 0;
+    uint32_t                    m_timeout = 0;
+    int64_t                     m_startedAt = 0;
+
+    // IR side only
+    uint32_t                    m_seenSession = 0;
+    Sample                      m_samples[kMaxSamples];
+
+    Result                      m_result;
+
+    void                        finish(uint8_t count, const char* error);
+    bool                        mergeDecoded(uint8_t count);
+    bool                        mergeRaw(uint8_t count);
+};
+
+#endif
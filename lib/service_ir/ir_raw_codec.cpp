@@ -0,0 +1,101 @@
+#include "ir_raw_codec.h"
+
+size_t IrRawCodec::encode(const uint16_t* timings, uint16_t count, uint8_t tick, uint32_t frequency,
+                          int32_t protocol, uint8_t* out, size_t size)
+{
+    if (size < 3)
+    {
+        return 0;
+    }
+    out[0] = kMagic;
+    out[1] = kVersion;
+    out[2] = tick;
+    size_t length = 3;
+
+    size_t written;
+    if ((written = putVarint(frequency, out + length, size - length)) == 0) return 0;
+    length += written;
+    if ((written = putVarint(zigzag(protocol), out + length, size - length)) == 0) return 0;
+    length += written;
+    if ((written = putVarint(count, out + length, size - length)) == 0) return 0;
+    length += written;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        int32_t previous = i >= 2 ? timings[i - 2] : 0;
+        if ((written = putVarint(zigzag(timings[i] - previous), out + length, size - length)) == 0)
+        {
+            return 0;
+        }
+        length += written;
+    }
+    return length;
+}
+
+bool IrRawCodec::decode(const uint8_t* data, size_t length, uint16_t* timings, uint16_t maxCount,
+                        uint16_t& count, uint32_t& frequency, int32_t& protocol)
+{
+    if (!isFrame(data, length) || data[1] != kVersion || data[2] == 0)
+    {
+        return false;
+    }
+    uint8_t tick = data[2];
+    const uint8_t* end = data + length;
+    data += 3;
+
+    uint32_t value;
+    if (!getVarint(data, end, frequency)) return false;
+    if (!getVarint(data, end, value)) return false;
+    protocol = unzigzag(value);
+    if (!getVarint(data, end, value) || value > maxCount) return false;
+    count = value;
+
+    // rebuild in ticks first, then scale in place
+    int32_t ticks[2] = { 0, 0 };
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (!getVarint(data, end, value)) return false;
+        int32_t current = ticks[i & 1] + unzigzag(value);
+        if (current < 0 || current > UINT16_MAX) return false;
+        ticks[i & 1] = current;
+
+        uint32_t micros = static_cast<uint32_t>(current) * tick;
+        timings[i] = micros > UINT16_MAX ? UINT16_MAX : micros;
+    }
+    return data == end;
+}
+
+size_t IrRawCodec::putVarint(uint32_t value, uint8_t* out, size_t size)
+{
+    size_t length = 0;
+    do
+    {
+        if (length == size)
+        {
+            return 0;
+        }
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[length++] = value ? (byte | 0x80) : byte;
+    } while (value);
+    return length;
+}
+
+bool IrRawCodec::getVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value)
+{
+    value = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7)
+    {
+        if (data == end)
+        {
+            return false;
+        }
+        uint8_t byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+#ifndef IR_RAW_CODEC_H
+#define IR_RAW_CODEC_H
+
+#include <Arduino.h>
+
+// Compact binary frames for raw IR timings, used by ir_receive_raw and ir_send_raw.
+//
+//   byte 0     'R'
+//   byte 1     version, 1
+//   byte 2     tick length in microseconds, timings are given in ticks
+//   varint     carrier frequency in Hz, 0 when unknown
+//   varint     protocol (zigzag), -1 for UNKNOWN
+//   varint     number of timings
+//   varint...  each timing (zigzag) as the difference to the timing two places back,
+//              so marks are compared with marks and spaces with spaces
+//
+// A 1024 entry capture of a regular remote mostly encodes as one byte per timing.
+class IrRawCodec
+{
+public:
+    static const uint8_t    kMagic = 'R';
+    static const uint8_t    kVersion = 1;
+
+    // worst case frame for count timings
+    static constexpr size_t maxFrameSize(size_t count) { return 3 + 3 * 5 + count * 3; }
+
+    static bool             isFrame(const uint8_t* data, size_t length) { return length >= 3 && data[0] == kMagic; }
+
+    // returns the frame length, 0 when it doesn't fit
+    static size_t           encode(const uint16_t* timings, uint16_t count, uint8_t tick, uint32_t frequency,
+                                   int32_t protocol, uint8_t* out, size_t size);
+
+    // timings come out in microseconds, false on a malformed frame or more than maxCount timings
+    static bool             decode(const uint8_t* data, size_t length, uint16_t* timings, uint16_t maxCount,
+                                   uint16_t& count, uint32_t& frequency, int32_t& protocol);
+
+private:
+    static size_t           putVarint(uint32_t value, uint8_t* out, size_t size);
+    static bool             getVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value);
+    static uint32_t         zigzag(int32_t value) { return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31); }
+    static int32_t          unzigzag(uint32_t value) { return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1); }
+};
+
+#endif
@@ -1,5 +1,8 @@
 #include "service_ir.h"
-#include <ArduinoJson.h>
+#include "profiler.h"
+#include "events.h"
+#include "trace.h"
+#include "log.h"
 
 InfraredService* InfraredService::s_instance = nullptr;
 
@@ -13,94 +16,481 @@ void InfraredService::init()
     irrecv.setUnknownThreshold(1000);
     irrecv.enableIRIn();
     irsend.begin();
+
+    m_freeCommands = xQueueCreate(IR_QUEUE_DEPTH, sizeof(uint8_t));
+    m_pendingCommands = xQueueCreate(IR_QUEUE_DEPTH, sizeof(uint8_t));
+    m_results = xQueueCreate(IR_QUEUE_DEPTH, sizeof(IrSendResult));
+    for (uint8_t i = 0; i < IR_QUEUE_DEPTH; i++)
+    {
+        xQueueSend(m_freeCommands, &i, 0);
+    }
+
+    xTaskCreatePinnedToCore(&InfraredService::sendTask, "IrSendTask", 4096, this, IR_TASK_PRIORITY, &m_sendTask, IR_TASK_CORE);
+    xTaskCreatePinnedToCore(&InfraredService::receiveTask, "IrReceiveTask", 6144, this, 1, &m_receiveTask, IR_TASK_CORE);
+}
+
+void InfraredService::sendTask(void *pvParameter)
+{
+    InfraredService* ir = reinterpret_cast<InfraredService*>(pvParameter);
+
+    while (1)
+    {
+        ir->sendNext(portMAX_DELAY);
+    }
 }
 
-void InfraredService::loop()
+bool InfraredService::sendNext(TickType_t wait)
 {
-    if (receiving)
+    uint8_t index;
+    if (m_pendingCommands == nullptr || xQueueReceive(m_pendingCommands, &index, wait) != pdTRUE)
     {
-        String code_received = receive();
+        return false;
+    }
+
+    IrCommand& command = m_commands[index];
+
+    IrSendResult result;
+    result.requestId = command.requestId;
+    result.origin = command.origin;
+    result.clientId = command.clientId;
+    result.step = command.step;
+    result.stepCount = command.stepCount;
+    result.latency = esp_timer_get_time() - command.enqueuedAt;
+    Profiler::recordMicros(Profiler::IR_SEND_LATENCY, result.latency);
 
-        if (code_received != "")
+    result.success = true;
+    Trace::record(Trace::TRACE_IR_SEND_BEGIN, 0, command.requestId);
+    TickType_t frameStart = xTaskGetTickCount();
+    for (uint16_t i = 0; i < command.times; i++)
+    {
+        if (i > 0)
         {
-        StaticJsonDocument<500> responseDoc;
-        responseDoc["type"] = "dock";
-        responseDoc["command"] = "ir_receive";
-        responseDoc["code"] = code_received;
-
-        String message;
-        serializeJson(responseDoc, message);
-        messageToAPI = message;
-        Serial.print(F("[IR] Sending message to API clients: "));
-        Serial.println(message);
+            vTaskDelayUntil(&frameStart, pdMS_TO_TICKS(command.interval));
         }
+        result.success = transmit(command) && result.success;
+    }
+    Trace::record(Trace::TRACE_IR_SEND_END, result.success, command.requestId);
+
+    // the slot may be reused as soon as it is back in the pool
+    bool waitForNextStep = command.stepCount > 0 && command.step + 1 < command.stepCount && command.delay > 0;
+    TickType_t delay = pdMS_TO_TICKS(command.delay);
+
+    xQueueSend(m_freeCommands, &index, 0);
+    if (xQueueSend(m_results, &result, 0) != pdTRUE)
+    {
+        LOG_WARN("IR", "Result queue full, dropping send result");
     }
+    Events::post(Events::EVENT_API);
+
+    if (waitForNextStep)
+    {
+        vTaskDelay(delay);
+    }
+    return true;
+}
+
+InfraredService::IrCommand* InfraredService::acquireCommand()
+{
+    // nothing is sent before init(), e.g. in setup mode
+    uint8_t index;
+    if (m_freeCommands == nullptr || xQueueReceive(m_freeCommands, &index, 0) != pdTRUE)
+    {
+        return nullptr;
+    }
+    IrCommand* command = &m_commands[index];
+    command->step = 0;
+    command->stepCount = 0;
+    command->times = 1;
+    command->interval = 0;
+    command->delay = 0;
+    return command;
 }
 
-void InfraredService::doRestart(const char *str, const bool serial_only)
+void InfraredService::releaseCommand(IrCommand* command)
 {
-    delay(2000); // Enough time for messages to be sent.
-    ESP.restart();
-    delay(5000); // Enough time to ensure we don't return.
+    uint8_t index = command - m_commands;
+    xQueueSend(m_freeCommands, &index, 0);
 }
 
-String InfraredService::receive()
+uint32_t InfraredService::freeCommands()
 {
-    String code = "";
+    return m_freeCommands != nullptr ? uxQueueMessagesWaiting(m_freeCommands) : 0;
+}
+
+uint32_t InfraredService::enqueue(IrCommand* command, uint32_t requestId)
+{
+    uint8_t index = command - m_commands;
+    command->requestId = requestId != 0 ? requestId : m_nextRequestId++;
+    command->enqueuedAt = esp_timer_get_time();
+    // a pool slot is only handed out when it can be queued, this never blocks
+    xQueueSend(m_pendingCommands, &index, portMAX_DELAY);
+    return command->requestId;
+}
 
-    if (irrecv.decode(&results)) {
-        Serial.println(resultToHumanReadableBasic(&results));
-        code += results.decode_type;
-        code += ";";
-        code += resultToHexidecimal(&results);
-        code += ";";
-        code += results.bits;
-        code += ";";
-        code += results.repeat;
-        Serial.println(code);
-        yield();
+bool InfraredService::takeResult(IrSendResult& result)
+{
+    return m_results != nullptr && xQueueReceive(m_results, &result, 0) == pdTRUE;
+}
+
+uint32_t InfraredService::queueDepth()
+{
+    return m_pendingCommands != nullptr ? uxQueueMessagesWaiting(m_pendingCommands) : 0;
+}
+
+void InfraredService::setReceiving(bool on)
+{
+    m_receiving = on;
+    if (on && m_receiveTask != nullptr)
+    {
+        xTaskNotifyGive(m_receiveTask);
     }
-    return code;
 }
 
-bool InfraredService::send(const String message, const String format)
+void InfraredService::receiveTask(void *pvParameter)
 {
-    // Format is: "<protocol>,<hex-ir-code>,<bits>,<repeat-count>" e.g. "4,0x640C,15,0"
-    const int firstIndex = message.indexOf(';');
-    const int secondIndex =  message.indexOf(';', firstIndex + 1);
-    const int thirdIndex = message.indexOf(';', secondIndex + 1);
+    InfraredService* ir = reinterpret_cast<InfraredService*>(pvParameter);
 
-    decode_type_t protocol = static_cast<decode_type_t>(message.substring(0, firstIndex).toInt());
-    String commandStr = message.substring(firstIndex + 1, secondIndex).c_str();
-    uint64_t command = getUInt64fromHex(commandStr.c_str());
-    uint16_t bits = message.substring(secondIndex + 1, thirdIndex).toInt();
-    uint16_t repeatCount = message.substring(thirdIndex + 1).toInt();
+    while (1)
+    {
+        if (!ir->m_receiving)
+        {
+            // sleeps until setReceiving(true)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (ir->pollReceiver())
+        {
+            Events::post(Events::EVENT_API);
+        }
+        // a capture only completes kTimeout ms after its last edge anyway
+        vTaskDelay(pdMS_TO_TICKS(kReceivePollInterval));
+    }
+}
+
+bool InfraredService::pollReceiver()
+{
+    PROFILE_SCOPE(Profiler::IR_RECEIVE);
+    if (learning.loop())
+    {
+        return true;
+    }
 
-    if (format == "hex") {        
-        return irsend.send(protocol, command, bits, repeatCount);
+    if (!receive(m_decoded))
+    {
+        return false;
+    }
+
+    if (learning.addSample(results, m_decoded.hex))
+    {
+        return true;
+    }
+
+    char code[sizeof(m_decoded.hex) + 24];
+    codeToString(m_decoded, code, sizeof(code));
+    if (m_receivedCodes.push(m_decoded))
+    {
+        LOG_DEBUG("IR", "Sending code to API clients: %s", code);
     } else {
-        int16_t index = -1;
-        uint16_t start_from = 0;
-        uint16_t count = countValuesInStr(commandStr, ',');
-        uint16_t *code_array = newCodeArray(count);
+        LOG_WARN("IR", "Receive queue full, dropped code: %s", code);
+    }
+
+    RawMode mode = rawMode;
+    if (mode == RAW_ALL || (mode == RAW_UNKNOWN && m_decoded.protocol == decode_type_t::UNKNOWN))
+    {
+        captureRaw();
+    }
+    return true;
+}
+
+bool InfraredService::captureRaw()
+{
+    RawFrame* frame = m_rawFrames.acquire();
+    if (frame == nullptr)
+    {
+        LOG_WARN("IR", "Raw queue full, dropped capture");
+        return false;
+    }
 
-        count = 0;
+    // the receiver strips the carrier, so the frequency is unknown
+    uint16_t count = results.rawlen > 1 ? results.rawlen - 1 : 0;
+    frame->length = IrRawCodec::encode(const_cast<const uint16_t*>(results.rawbuf + 1), count, kRawTick, 0,
+                                       results.decode_type, frame->data, sizeof(frame->data));
+    if (frame->length == 0)
+    {
+        return false;
+    }
+    m_rawFrames.commit();
 
-        do {
-            index = commandStr.indexOf(',', start_from);
-            code_array[count] = strtoul(commandStr.substring(start_from, index).c_str(),  NULL, 16);
-            start_from = index + 1;
-            count++;
-        } while (index != -1);
+    LOG_DEBUG("IR", "Raw capture, %u timings in %u bytes", count, frame->length);
+    return true;
+}
 
-        irsend.sendPronto(code_array, count, repeatCount);
-        free(code_array);
-        return (count > 0);
+bool InfraredService::receive(IrReceived& code)
+{
+    uint32_t start = ESP.getCycleCount();
+    if (!irrecv.decode(&results)) {
+        return false;
     }
 
+    code.protocol = results.decode_type;
+    code.value = results.value;
+    code.bits = results.bits;
+    code.repeat = results.repeat;
+    strlcpy(code.hex, resultToHexidecimal(&results).c_str(), sizeof(code.hex));
+    // only captures that decoded count, an empty poll is cheap
+    Profiler::record(Profiler::IR_DECODE, ESP.getCycleCount() - start, 0, 0);
+    Trace::record(Trace::TRACE_IR_DECODE, code.bits, code.protocol);
+    LOG_DEBUG("IR", "%s", resultToHumanReadableBasic(&results).c_str());
+    yield();
+    return true;
+}
+
+size_t InfraredService::codeToString(const IrReceived& code, char* buffer, size_t size)
+{
+    // "<protocol>;<hex-ir-code>;<bits>;<repeat>", the format ir_send accepts
+    return snprintf(buffer, size, "%d;%s;%u;%u", code.protocol, code.hex, code.bits, code.repeat);
+}
+
+// Hex digit value, -1 for anything else
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void skipSpaces(const char*& p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+}
+
+// Reads an optionally signed decimal number, advancing p past it
+static bool parseDecimal(const char*& p, int32_t& value)
+{
+    skipSpaces(p);
+    bool negative = (*p == '-');
+    if (negative) p++;
+    if (*p < '0' || *p > '9') return false;
+
+    int32_t result = 0;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        if (result > 100000000) return false;
+        result = result * 10 + (*p - '0');
+    }
+    value = negative ? -result : result;
+    skipSpaces(p);
+    return true;
+}
+
+// Reads a hex number of at most maxDigits digits with an optional 0x prefix
+static bool parseHex(const char*& p, uint8_t maxDigits, uint64_t& value)
+{
+    skipSpaces(p);
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hexDigit(p[2]) >= 0) p += 2;
+
+    const char* start = p;
+    uint64_t result = 0;
+    uint8_t digits = 0;
+    for (int digit = hexDigit(*p); digit >= 0; digit = hexDigit(*++p)) {
+        // leading zeros don't count against the width
+        if ((result != 0 || digit != 0) && ++digits > maxDigits) return false;
+        result = (result << 4) | digit;
+    }
+    if (p == start) return false;
+
+    value = result;
+    skipSpaces(p);
+    return true;
+}
+
+// Reads pronto words separated by commas or spaces until ';' or the end of the string
+static InfraredService::ParseResult parseProntoWords(const char*& p, InfraredService::IrCommand& command)
+{
+    uint16_t count = 0;
+    skipSpaces(p);
+    while (*p != '\0' && *p != ';') {
+        uint64_t word;
+        if (!parseHex(p, 4, word)) return InfraredService::PARSE_BAD_PRONTO;
+        if (count == InfraredService::kMaxCodeWords) return InfraredService::PARSE_TOO_LONG;
+        command.words[count++] = word;
+        if (*p == ',') {
+            p++;
+            skipSpaces(p);
+        }
+    }
+    if (count == 0) return InfraredService::PARSE_BAD_PRONTO;
+    command.count = count;
+    return InfraredService::PARSE_OK;
+}
+
+InfraredService::ParseResult InfraredService::parseCode(const char* code, const char* format, IrCommand& command)
+{
+    if (code == nullptr || format == nullptr || *code == '\0') {
+        return PARSE_EMPTY;
+    }
+
+    bool pronto;
+    if (strcmp(format, "hex") == 0) {
+        pronto = false;
+    } else if (strcmp(format, "pronto") == 0) {
+        pronto = true;
+    } else {
+        return PARSE_BAD_FORMAT;
+    }
+
+    PROFILE_SCOPE(pronto ? Profiler::IR_PARSE_PRONTO : Profiler::IR_PARSE_HEX);
+
+    // a bare pronto string without the surrounding fields
+    const char* p = code;
+    if (pronto && strchr(code, ';') == nullptr) {
+        command.type = IrCommand::TYPE_PRONTO;
+        command.repeat = 0;
+        ParseResult result = parseProntoWords(p, command);
+        return (result == PARSE_OK && *p != '\0') ? PARSE_BAD_PRONTO : result;
+    }
+
+    // "<protocol>;<hex-ir-code or pronto words>;<bits>;<repeat-count>", bits and repeat may be left out
+    int32_t protocol;
+    if (!parseDecimal(p, protocol) || *p++ != ';') {
+        return PARSE_BAD_PROTOCOL;
+    }
+    command.protocol = static_cast<decode_type_t>(protocol);
+
+    if (pronto) {
+        command.type = IrCommand::TYPE_PRONTO;
+        ParseResult result = parseProntoWords(p, command);
+        if (result != PARSE_OK) {
+            return result;
+        }
+    } else {
+        command.type = IrCommand::TYPE_HEX;
+        if (!parseHex(p, 16, command.value)) {
+            return PARSE_BAD_HEX;
+        }
+    }
+
+    int32_t bits = 0;
+    int32_t repeat = 0;
+    if (*p == ';') {
+        p++;
+        if (!parseDecimal(p, bits) || bits < 0 || bits > UINT16_MAX) {
+            return PARSE_BAD_BITS;
+        }
+    }
+    if (*p == ';') {
+        p++;
+        if (!parseDecimal(p, repeat) || repeat < 0 || repeat > UINT16_MAX) {
+            return PARSE_BAD_REPEAT;
+        }
+    }
+    if (*p != '\0') {
+        return PARSE_TRAILING_DATA;
+    }
+
+    command.bits = bits;
+    command.repeat = repeat;
+    return PARSE_OK;
+}
+
+const char* InfraredService::parseResultText(ParseResult result)
+{
+    switch (result) {
+        case PARSE_OK:              return "ok";
+        case PARSE_EMPTY:           return "empty code";
+        case PARSE_BAD_FORMAT:      return "unknown format";
+        case PARSE_BAD_PROTOCOL:    return "invalid protocol";
+        case PARSE_BAD_HEX:         return "invalid hex code";
+        case PARSE_BAD_PRONTO:      return "invalid pronto code";
+        case PARSE_TOO_LONG:        return "code too long";
+        case PARSE_BAD_BITS:        return "invalid bits";
+        case PARSE_BAD_REPEAT:      return "invalid repeat";
+        case PARSE_TRAILING_DATA:   return "unexpected data after code";
+    }
+    return "invalid code";
+}
+
+bool InfraredService::prontoToRaw(IrCommand& command)
+{
+    // [0] 0000 learned code, [1] carrier period, [2] once pairs, [3] repeat pairs, then timings
+    const uint16_t* words = command.words;
+    if (command.type != IrCommand::TYPE_PRONTO || command.count < 6 || words[0] != 0x0000 || words[1] == 0) {
+        return false;
+    }
+    uint16_t onceCount = 2 * words[2];
+    uint16_t repeatCount = 2 * words[3];
+    if (onceCount + repeatCount == 0 || command.count < 4 + onceCount + repeatCount) {
+        return false;
+    }
+
+    // one pronto clock tick is 0.241246 us, a timing is given in carrier periods
+    const float periodUs = words[1] * 0.241246f;
+    const uint16_t frequency = static_cast<uint16_t>(1000000.0f / periodUs + 0.5f);
+
+    for (uint16_t i = 0; i < onceCount + repeatCount; i++) {
+        float timing = words[i + 4] * periodUs + 0.5f;
+        // gaps beyond 65 ms are clipped, sendRaw takes 16 bit timings
+        command.words[i] = timing > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(timing);
+    }
+
+    command.type = IrCommand::TYPE_RAW;
+    command.count = onceCount + repeatCount;
+    command.onceCount = onceCount;
+    command.frequency = frequency;
+    return true;
+}
+
+bool InfraredService::transmit(const IrCommand& command)
+{
+    switch (command.type) {
+        case IrCommand::TYPE_HEX:
+            return sendHex(command.protocol, command.value, command.bits, command.repeat);
+        case IrCommand::TYPE_PRONTO:
+            return sendPronto(command.words, command.count, command.repeat);
+        case IrCommand::TYPE_RAW:
+            return sendRaw(command);
+    }
+    return false;
+}
+
+bool InfraredService::sendHex(decode_type_t protocol, uint64_t code, uint16_t bits, uint16_t repeat)
+{
+    PROFILE_SCOPE(Profiler::IR_SEND_HEX);
+    return irsend.send(protocol, code, bits, repeat);
+}
+
+bool InfraredService::sendPronto(const uint16_t* words, uint16_t count, uint16_t repeat)
+{
+    PROFILE_SCOPE(Profiler::IR_SEND_PRONTO);
+    if (count == 0) {
+        return false;
+    }
+    irsend.sendPronto(const_cast<uint16_t*>(words), count, repeat);
+    return true;
+}
+
+bool InfraredService::sendRaw(const IrCommand& command)
+{
+    PROFILE_SCOPE(Profiler::IR_SEND_RAW);
+    if (command.count == 0) {
+        return false;
+    }
+
+    // like sendPronto: the once part a single time, then the repeat part
+    uint16_t repeatCount = command.count - command.onceCount;
+    uint16_t repeats = command.repeat + (command.onceCount == 0 ? 1 : 0);
+
+    if (command.onceCount > 0) {
+        irsend.sendRaw(command.words, command.onceCount, command.frequency);
+    }
+    for (uint16_t i = 0; repeatCount > 0 && i < repeats; i++) {
+        irsend.sendRaw(command.words + command.onceCount, repeatCount, command.frequency);
+    }
+    return true;
 }
 
 String InfraredService::resultToHexidecimal(const decode_results * const result) {
+  PROFILE_SCOPE(Profiler::IR_RESULT_TO_HEX);
   String output = F("0x");
   // Reserve some space for the string to reduce heap fragmentation.
   output.reserve(2 * kStateSizeMax + 2);  // Should cover worst cases.
@@ -115,45 +505,3 @@ String InfraredService::resultToHexidecimal(const decode_results * const result)
   }
   return output;
 }
-
-// CONVERT HEX STRING TO INT!
-uint64_t InfraredService::getUInt64fromHex(char const *str) {
-  uint64_t result = 0;
-  uint16_t offset = 0;
-  // Skip any leading '0x' or '0X' prefix.
-  if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) offset = 2;
-  for (; isxdigit((unsigned char)str[offset]); offset++) {
-    char c = str[offset];
-    result *= 16;
-    if (isdigit(c))
-      result += c - '0';  // '0' .. '9'
-    else if (isupper(c))
-      result += c - 'A' + 10;  // 'A' .. 'F'
-    else
-      result += c - 'a' + 10;  // 'a' .. 'f'
-  }
-  return result;
-}
-
-// CONVERT HEX STRING TO INT!
-uint16_t * InfraredService::newCodeArray(const uint16_t size) {
-  uint16_t *result;
-
-  result = reinterpret_cast<uint16_t*>(malloc(size * sizeof(uint16_t)));
-  // Check we malloc'ed successfully.
-  if (result == NULL)  // malloc failed, so give up.
-    doRestart(
-        "FATAL: Can't allocate memory for an array for a new message! "
-        "Forcing a reboot!", true);  // Send to serial only as we are in low mem
-  return result;
-}
-
-uint16_t InfraredService::countValuesInStr(const String str, char sep) {
-  int16_t index = -1;
-  uint16_t count = 1;
-  do {
-    index = str.indexOf(sep, index + 1);
-    count++;
-  } while (index != -1);
-  return count;
-}
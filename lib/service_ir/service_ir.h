@@ -8,6 +8,21 @@
 #include <IRac.h>
 #include <IRutils.h>
 #include <IRtimer.h>
+#include <spsc_ring.h>
+#include <atomic>
+#include "ir_raw_codec.h"
+#include "ir_learning.h"
+
+// IR transmit task settings, override with build flags
+#ifndef IR_TASK_PRIORITY
+#define IR_TASK_PRIORITY 2
+#endif
+#ifndef IR_TASK_CORE
+#define IR_TASK_CORE 1
+#endif
+#ifndef IR_QUEUE_DEPTH
+#define IR_QUEUE_DEPTH 8
+#endif
 
 class InfraredService
 {
@@ -17,17 +32,137 @@ public:
 
     static InfraredService*     getInstance() { return s_instance; }
 
+    // starts the send and receive tasks
     void                        init();
-    void                        loop();
-    void                        doRestart(const char *str, const bool serial_only);
 
-    String                      receive();
+    // a decoded IR code, handed to the API
+    struct IrReceived {
+        decode_type_t           protocol;
+        uint64_t                value;
+        uint16_t                bits;
+        uint16_t                repeat;
+        char                    hex[2 * kStateSizeMax + 3];  // value as hex, covers AC states
+    };
+
+    // a raw capture encoded with IrRawCodec, rawbuf[0] (the gap before the code) is left out
+    struct RawFrame {
+        uint16_t                length;
+        uint8_t                 data[IrRawCodec::maxFrameSize(1024 - 1)];
+    };
+
+    // which captures are also streamed as raw timings
+    enum RawMode {
+        RAW_OFF                 =   0,
+        RAW_UNKNOWN             =   1,      // only codes no protocol decoder recognized
+        RAW_ALL                 =   2
+    };
+
+    // longest code in 16 bit words: a full capture buffer (kCaptureBufferSize) plus the pronto header
+    static const uint16_t       kMaxCodeWords = 1024 + 4;
+
+    enum ParseResult {
+        PARSE_OK                =   0,
+        PARSE_EMPTY,
+        PARSE_BAD_FORMAT,
+        PARSE_BAD_PROTOCOL,
+        PARSE_BAD_HEX,
+        PARSE_BAD_PRONTO,
+        PARSE_TOO_LONG,
+        PARSE_BAD_BITS,
+        PARSE_BAD_REPEAT,
+        PARSE_TRAILING_DATA
+    };
+
+    // a transmit request, lives in a fixed pool until the send task is done with it
+    struct IrCommand {
+        enum Type {
+            TYPE_HEX            =   0,
+            TYPE_PRONTO         =   1,
+            TYPE_RAW            =   2       // mark/space timings in microseconds
+        };
+
+        Type                    type;
+        uint32_t                requestId;
+        uint8_t                 origin;         // opaque to the IR service, the API stores its source here
+        uint8_t                 clientId;
+        decode_type_t           protocol;
+        uint64_t                value;
+        uint16_t                bits;
+        uint16_t                repeat;
+        uint16_t                count;          // pronto words or raw timings used
+        uint16_t                onceCount;      // raw: timings sent once, the rest is the repeat part
+        uint16_t                frequency;      // raw: carrier in Hz
+        int64_t                 enqueuedAt;     // esp_timer_get_time() at enqueue
+
+        // batch scheduling, a plain ir_send is one step sent once
+        uint16_t                step;
+        uint16_t                stepCount;      // 0 when not part of a batch
+        uint16_t                times;          // how often the step is sent
+        uint16_t                interval;       // ms from the start of one send to the next
+        uint32_t                delay;          // ms from the end of the step to the next step
+        uint16_t                words[kMaxCodeWords];
+    };
+
+    // outcome of a transmit request, collected by the API
+    struct IrSendResult {
+        uint32_t                requestId;
+        uint8_t                 origin;
+        uint8_t                 clientId;
+        bool                    success;
+        uint32_t                latency;        // enqueue to emit in microseconds
+        uint16_t                step;
+        uint16_t                stepCount;      // 0 when not part of a batch
+    };
+
+    // decoded codes waiting for the API
+    static const size_t         kReceiveQueueSize = 8;
 
-    bool                        send(const String message, const String format);
+    bool                        receive(IrReceived& code);
+    // consumer side of the receive queue, API only
+    bool                        takeReceived(IrReceived& code) { return m_receivedCodes.pop(code); }
+    uint32_t                    receiveDropped() { return m_receivedCodes.dropped(); }
+    size_t                      receiveQueueDepth() { return m_receivedCodes.size(); }
+    static size_t               codeToString(const IrReceived& code, char* buffer, size_t size);
+
+    // raw captures waiting for the API, read in place: frontRawFrame() then releaseRawFrame()
+    static const size_t         kRawQueueSize = 2;
+
+    const RawFrame*             frontRawFrame() { return m_rawFrames.front(); }
+    void                        releaseRawFrame() { m_rawFrames.release(); }
+    uint32_t                    rawDropped() { return m_rawFrames.dropped(); }
+
+    // takes a free command from the pool, nullptr when the queue is full
+    IrCommand*                  acquireCommand();
+    void                        releaseCommand(IrCommand* command);
+    uint32_t                    freeCommands();
+    // queues the command for the send task and returns its request id,
+    // steps of a batch pass the id of the first step
+    uint32_t                    enqueue(IrCommand* command, uint32_t requestId = 0);
+    bool                        takeResult(IrSendResult& result);
+    uint32_t                    queueDepth();
+    // send task: sends the next queued command, waits up to wait ticks for one
+    bool                        sendNext(TickType_t wait);
+
+    // stack the tasks never touched so far, in bytes
+    uint32_t                    sendStackFree() { return m_sendTask != nullptr ? uxTaskGetStackHighWaterMark(m_sendTask) : 0; }
+    uint32_t                    receiveStackFree() { return m_receiveTask != nullptr ? uxTaskGetStackHighWaterMark(m_receiveTask) : 0; }
+
+    // single pass over "<protocol>;<hex-ir-code or pronto words>;<bits>;<repeat-count>",
+    // format is "hex" or "pronto". Pronto words go straight into command.words.
+    ParseResult                 parseCode(const char* code, const char* format, IrCommand& command);
+    static const char*          parseResultText(ParseResult result);
+    // turns a TYPE_PRONTO command into TYPE_RAW timings, in place
+    static bool                 prontoToRaw(IrCommand& command);
+    // "0x" and the value, or the state bytes of AC protocols
+    static String               resultToHexidecimal(const decode_results * const result);
 
     decode_results              results;
-    bool                        receiving = false;
-    String                      messageToAPI = "";
+    // the receive task only polls the receiver while receiving is on
+    void                        setReceiving(bool on);
+    bool                        isReceiving() { return m_receiving; }
+    std::atomic<RawMode>        rawMode{RAW_OFF};
+    // takes the captures while a learning session runs
+    IrLearning                  learning;
 
 private:
     static InfraredService*     s_instance;
@@ -39,10 +174,32 @@ private:
     const uint8_t               kTimeout = 15;              // Milli-Seconds
     const uint16_t              kFrequency = 38000;        // in Hz. e.g. 38kHz.
     const uint16_t              kMinUnknownSize = 12;
-    String resultToHexidecimal(const decode_results * const result);
-    uint64_t getUInt64fromHex(char const *str);
-    uint16_t * newCodeArray(const uint16_t size);
-    uint16_t countValuesInStr(const String str, char sep);
+    static const uint32_t       kReceivePollInterval = 10;  // ms
+    bool                        captureRaw();
+
+    // only called from the send task
+    bool                        transmit(const IrCommand& command);
+    bool                        sendHex(decode_type_t protocol, uint64_t code, uint16_t bits, uint16_t repeat);
+    bool                        sendPronto(const uint16_t* words, uint16_t count, uint16_t repeat);
+    bool                        sendRaw(const IrCommand& command);
+
+    static void                 sendTask(void *pvParameter);
+    static void                 receiveTask(void *pvParameter);
+    // handles one decode, true when there is something new for the API
+    bool                        pollReceiver();
+
+    IrCommand                   m_commands[IR_QUEUE_DEPTH];
+    QueueHandle_t               m_freeCommands = nullptr;       // indexes into m_commands
+    QueueHandle_t               m_pendingCommands = nullptr;    // indexes into m_commands, in send order
+    QueueHandle_t               m_results = nullptr;
+    TaskHandle_t                m_sendTask = nullptr;
+    TaskHandle_t                m_receiveTask = nullptr;
+    std::atomic<bool>           m_receiving{false};
+    uint32_t                    m_nextRequestId = 1;
+
+    SpscRing<IrReceived, kReceiveQueueSize> m_receivedCodes;
+    IrReceived                  m_decoded;      // decode scratch, receive task
+    SpscRing<RawFrame, kRawQueueSize> m_rawFrames;
 
     IRsend                      irsend = IRsend(kIrLedPin);
     IRrecv                      irrecv = IRrecv(kRecvPin, kCaptureBufferSize, kTimeout, true);
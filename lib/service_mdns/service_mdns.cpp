@@ -1,4 +1,8 @@
 #include "service_mdns.h"
+#include "profiler.h"
+#include "trace.h"
+#include "log.h"
+#include "events.h"
 
 MDNSService* MDNSService::s_instance = nullptr;
 
@@ -7,37 +11,73 @@ MDNSService::MDNSService()
     s_instance = this;
 }
 
+void MDNSService::init()
+{
+    WiFi.onEvent([](WiFiEvent_t event) {
+        Events::post(Events::EVENT_MDNS);
+    }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+}
+
 void MDNSService::loop()
 {
-    const unsigned long fiveMinutes = 1 * 60 * 1000UL;
-    static unsigned long lastSampleTime = 0 - fiveMinutes;
-
-    unsigned long now = millis();
-    if (now - lastSampleTime >= fiveMinutes)
-    {
-        lastSampleTime += fiveMinutes;
-        MDNS.end();
-        delay(100);
-
-        if (!MDNS.begin(m_config->getHostName().c_str()))
-        {
-            Serial.println(F("[MDNS] Error setting up MDNS responder!"));
-            while (1)
-            {
-            delay(1000);
-            }
-        }
-        Serial.println(F("[MDNS] mDNS started"));
-
-        // Add mDNS service
-        MDNS.addService("_yio-dock-ota", "_tcp", m_config->OTA_port);
-        MDNS.addService("_yio-dock-api", "_tcp", m_config->API_port);
-        addFriendlyName(m_config->getFriendlyName());
-        Serial.println(F("[MDNS] Services updated"));
+    PROFILE_SCOPE(Profiler::MDNS_LOOP);
+
+    if (m_running || !WiFi.isConnected())
+    {
+        return;
+    }
+    if (m_retryDelay != 0 && millis() - m_failedAt < m_retryDelay)
+    {
+        return;
+    }
+
+    if (start())
+    {
+        m_running = true;
+        m_retryDelay = 0;
+        return;
+    }
+
+    MDNS.end();
+    m_failedAt = millis();
+    // 1, 2, 4 ... 64 s, the mdnsCheck timer brings the main loop back
+    if (m_retryDelay == 0)
+    {
+        m_retryDelay = kMinRetryDelay;
+    }
+    else if (m_retryDelay < kMaxRetryDelay)
+    {
+        m_retryDelay *= 2;
+    }
+    LOG_ERROR("MDNS", "Error setting up MDNS responder, retrying in %u ms", m_retryDelay);
+}
+
+bool MDNSService::start()
+{
+    bool started = MDNS.begin(m_config->getHostName().c_str());
+    Trace::record(Trace::TRACE_MDNS_RESTART, started);
+    if (!started)
+    {
+        return false;
     }
+    LOG_INFO("MDNS", "mDNS started");
+
+    // Add mDNS service
+    if (!MDNS.addService("_yio-dock-ota", "_tcp", m_config->OTA_port)
+        || !MDNS.addService("_yio-dock-api", "_tcp", m_config->API_port))
+    {
+        return false;
+    }
+    MDNS.addServiceTxt("_yio-dock-api", "_tcp", "FriendlyName", m_config->getFriendlyName());
+    LOG_INFO("MDNS", "Services updated");
+    return true;
 }
 
 void MDNSService::addFriendlyName(String name)
 {
-    MDNS.addServiceTxt("_yio-dock-api", "_tcp", "FriendlyName", name);
-}
\ No newline at end of file
+    // a responder that isn't up yet picks the name up from the config when it starts
+    if (m_running)
+    {
+        MDNS.addServiceTxt("_yio-dock-api", "_tcp", "FriendlyName", name);
+    }
+}
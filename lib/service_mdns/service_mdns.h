@@ -2,8 +2,13 @@
 #define SERVICE_MDNS_H
 
 #include <ESPmDNS.h>
+#include <WiFi.h>
+#include <atomic>
 #include <config.h>
 
+// Announces the dock's API and OTA services.
+// The responder comes up once WiFi has an address and then stays up, the IDF responder
+// follows reconnects on its own. A failed start is retried with a growing delay.
 class MDNSService
 {
 public:
@@ -12,12 +17,27 @@ public:
 
     static MDNSService*           getInstance() { return s_instance; }
 
+    // wakes the main loop with EVENT_MDNS when WiFi gets an address
+    void init();
+    // starts the responder when it's due, call on EVENT_MDNS
     void loop();
+    // changes the TXT record in place
     void addFriendlyName(String name);
 
+    bool isRunning() const { return m_running; }
+
 private:
     static MDNSService*           s_instance;
     Config*                       m_config = Config::getInstance();
+
+    static const uint32_t         kMinRetryDelay = 1000;        // ms
+    static const uint32_t         kMaxRetryDelay = 64000;       // ms
+
+    bool                          m_running = false;
+    uint32_t                      m_retryDelay = 0;             // 0 while no start failed
+    uint32_t                      m_failedAt = 0;
+
+    bool                          start();
 };
 
-#endif
\ No newline at end of file
+#endif
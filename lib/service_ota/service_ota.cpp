@@ -1,6 +1,9 @@
 #include "service_ota.h"
 #include <WebServer.h>
 #include <Update.h>
+#include <led_control.h>
+#include <profiler.h>
+#include <log.h>
 
 WebServer OTAServer(9999);
 
@@ -19,6 +22,7 @@ void OTA::init()
 
 void OTA::handle()
 {
+	PROFILE_SCOPE(Profiler::OTA_HANDLE);
 	if (!this->init_has_run)
 	{
 		OTA::init();
@@ -45,25 +49,25 @@ void OTA::add_http(WebServer *server, const char *path)
 		HTTPUpload& upload = server->upload();
 
 		if (upload.status == UPLOAD_FILE_START) {
-			Serial.printf("Firmware update initiated: %s\r\n", upload.filename.c_str());
+			LOG_INFO("OTA", "Firmware update initiated: %s", upload.filename.c_str());
 
 			//uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
 			uint32_t maxSketchSpace = this->max_sketch_size();
 
 			if (!Update.begin(maxSketchSpace)) { //start with max available size
-				Update.printError(Serial);
+				LOG_ERROR("OTA", "Update failed: %s", Update.errorString());
 			}
 		} else if (upload.status == UPLOAD_FILE_WRITE) {
             if (!led_state) {
                 led_state = true;
-                ledcWrite(0, 255); 
+                LedControl::getInstance()->write(255);
             } else {
                 led_state = false;
-                ledcWrite(0, 0);
+                LedControl::getInstance()->write(0);
             }
 			/* flashing firmware to ESP*/
 			if (Update.write(upload.buf, upload.currentSize) != upload.currentSize) {
-				Update.printError(Serial);
+				LOG_ERROR("OTA", "Update failed: %s", Update.errorString());
 			}
 
 			// Store the next milestone to output
@@ -72,14 +76,14 @@ void OTA::add_http(WebServer *server, const char *path)
 
 			// Check if we need to output a milestone (100k 200k 300k)
 			if (upload.totalSize >= next) {
-				Serial.printf("%dk ", next / 1024);
+				LOG_DEBUG("OTA", "%uk", next / 1024);
 				next += chunk_size;
 			}
 		} else if (upload.status == UPLOAD_FILE_END) {
 			if (Update.end(true)) { //true to set the size to the current progress
-				Serial.printf("\r\nFirmware update successful: %u bytes\r\nRebooting...\r\n", upload.totalSize);
+				LOG_INFO("OTA", "Firmware update successful: %u bytes, rebooting...", upload.totalSize);
 			} else {
-				Update.printError(Serial);
+				LOG_ERROR("OTA", "Update failed: %s", Update.errorString());
 			}
 		} });
 
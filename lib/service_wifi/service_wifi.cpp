@@ -1,4 +1,8 @@
 #include "service_wifi.h"
+#include "events.h"
+#include "trace.h"
+#include "log.h"
+#include "profiler.h"
 
 WifiService* WifiService::s_instance = nullptr;
 
@@ -9,55 +13,172 @@ WifiService::WifiService()
 
 void WifiService::initiateWifi()
 {
-    Serial.println(F("[WIFI] Initializing..."));
+    LOG_INFO("WIFI", "Initializing...");
+    // connection changes wake the main loop, handleReconnect() sorts them out
+    WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info) {
+        Trace::record(Trace::TRACE_WIFI, event);
+        if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+        {
+            s_instance->m_gotIpAt = millis();
+        }
+        // our own disconnect() leaves with ASSOC_LEAVE, anything else ends an attempt
+        if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED
+            && info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE)
+        {
+            s_instance->m_attemptFailed = true;
+        }
+        Events::post(Events::EVENT_WIFI);
+    });
+    // handleReconnect() decides when and where to connect, the credentials live in Config
+    WiFi.setAutoReconnect(false);
+    WiFi.persistent(false);
+
+    m_lostAt = millis();
     connect(m_config->getWifiSsid(), m_config->getWifiPassword());
 }
 
 void WifiService::handleReconnect()
 {
-    if (WiFi.status() != WL_CONNECTED && (millis() > m_wifiCheckTimedUl))
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        if (!m_connected)
+        {
+            connected();
+        }
+        return;
+    }
+
+    if (m_connected)
     {
-        m_wifiReconnectCount++;
+        // the access point is most likely still there, try it right away
+        LOG_WARN("WIFI", "Wifi disconnected");
+        m_connected = false;
+        m_attempting = false;
+        m_lostAt = millis();
+        m_retryDelay = 0;
+        m_state->set(State::CONNECTING);
+    }
 
-        if (m_wifiReconnectCount == 5) {
-            m_wifiReconnectCount = 0;
-            m_state->reboot();
+    // a running attempt is left alone, tearing it down early only starts it over
+    if (m_attempting)
+    {
+        bool hasFailed = m_attemptFailed.exchange(false);
+        if (!hasFailed && millis() - m_attemptAt < kConnectTimeout)
+        {
+            return;
         }
+        failed(!hasFailed);
+    }
 
-        Serial.println(F("[WIFI] Wifi disconnected"));
-        m_wifiPrevState = false;
+    if (m_retryDelay != 0 && millis() - m_failedAt < m_retryDelay)
+    {
+        return;
+    }
+
+    LOG_INFO("WIFI", "Reconnecting");
+    attempt(m_retryDelay == 0 && m_cached);
+}
+
+void WifiService::failed(bool timedOut)
+{
+    LOG_WARN("WIFI", timedOut ? "Connect attempt timed out" : "Connect attempt failed");
+    m_attempting = false;
+    m_failedAt = millis();
+    if (timedOut)
+    {
         disconnect();
-        delay(2000);
-        m_state->currentState = State::CONNECTING;
-        Serial.println(F("[WIFI] Reconnecting"));
+    }
+
+    // 5, 10, 20 ... 60 s from one failure to the next attempt
+    if (m_retryDelay == 0)
+    {
+        m_retryDelay = kMinRetryDelay;
+    }
+    else
+    {
+        m_retryDelay = m_retryDelay * 2 < kMaxRetryDelay ? m_retryDelay * 2 : kMaxRetryDelay;
+    }
+}
+
+void WifiService::connected()
+{
+    m_connected = true;
+    m_attempting = false;
+    m_retryDelay = 0;
+
+    // the event handler saw the address first, the main loop may have been busy
+    uint32_t gotIpAt = m_gotIpAt;
+    uint32_t now = millis();
+    m_lastConnectTime = (gotIpAt != 0 && now - gotIpAt < now - m_lostAt ? gotIpAt : now) - m_lostAt;
+    if (m_cached)
+    {
+        m_reconnects++;
+    }
+
+    memcpy(m_bssid, WiFi.BSSID(), sizeof(m_bssid));
+    m_channel = WiFi.channel();
+    m_ip = WiFi.localIP();
+    m_gateway = WiFi.gatewayIP();
+    m_subnet = WiFi.subnetMask();
+    m_dns = WiFi.dnsIP();
+    m_cached = true;
+    Profiler::bootMark(Profiler::BOOT_WIFI_CONNECTED);
+
+#if WIFI_REUSE_LEASE
+    // the old address only bridged the reconnect, DHCP renews the lease from here on
+    if (m_staticLease)
+    {
+        m_staticLease = false;
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    }
+#endif
+
+    LOG_INFO("WIFI", "Wifi connected in %u ms, channel %d", m_lastConnectTime, m_channel);
+    m_state->set(State::CONN_SUCCESS);
+}
+
+void WifiService::attempt(bool fast)
+{
+    if (!fast)
+    {
         connect(m_config->getWifiSsid(), m_config->getWifiPassword());
-        
-        m_wifiCheckTimedUl = millis() + 30000;
+        return;
     }
 
-    // restart MDNS if wifi is connected again
-    if (WiFi.status() == WL_CONNECTED && m_wifiPrevState == false)
-    {   
-        m_wifiReconnectCount = 0;
-        Serial.println(F("[WIFI] Wifi connected"));
-        m_wifiPrevState = true;
-        m_state->currentState = State::CONN_SUCCESS;
+    m_staticLease = false;
+#if WIFI_REUSE_LEASE
+    // the lease was renewed while connected, after a short drop it's still ours
+    if (millis() - m_lostAt < kLeaseReuse)
+    {
+        WiFi.config(m_ip, m_gateway, m_subnet, m_dns);
+        m_staticLease = true;
+    } else {
+        WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
     }
+#endif
+    m_attemptFailed = false;
+    WiFi.begin(m_config->getWifiSsid().c_str(), m_config->getWifiPassword().c_str(), m_channel, m_bssid);
+    m_attempting = true;
+    m_attemptAt = millis();
 }
 
 void WifiService::connect(String ssid, String password)
 {
-    Serial.println(F("[WIFI] Connecting..."));
+    LOG_INFO("WIFI", "Connecting...");
     WiFi.enableSTA(true);
     WiFi.mode(WIFI_STA);
     WiFi.setSleep(false);
     WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
     WiFi.setHostname(m_config->getHostName().c_str());
+    m_staticLease = false;
+    m_attemptFailed = false;
     WiFi.begin(ssid.c_str(), password.c_str());
-    m_state->currentState = State::CONNECTING;      
+    m_attempting = true;
+    m_attemptAt = millis();
+    m_state->set(State::CONNECTING);
 }
 
 void WifiService::disconnect()
 {
     WiFi.disconnect();
-}
\ No newline at end of file
+}
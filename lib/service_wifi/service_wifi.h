@@ -3,10 +3,20 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
+#include <atomic>
 #include <config.h>
 #include <state.h>
-#include <service_mdns.h>
 
+// reconnect with the IP address of the last DHCP lease, skipping DHCP; the station goes back
+// to DHCP once connected, so the lease gets renewed. Off unless set with build flags
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 0
+#endif
+
+// Keeps the station connected, driven by WiFi events and the wifiCheck timer.
+// After a drop the first attempt goes straight to the access point and channel of the last
+// connection; later attempts scan again, with a growing delay from the last failure.
+// An attempt runs until the driver reports it failed or it times out, never cut short.
 class WifiService
 {
 public:
@@ -16,20 +26,53 @@ public:
     static WifiService*           getInstance() { return s_instance; }
 
     void initiateWifi();
+    // call on EVENT_WIFI, never blocks
     void handleReconnect();
     void connect(String ssid, String password);
     void disconnect();
 
+    bool                          isConnected() const { return m_connected; }
+    uint32_t                      reconnects() const { return m_reconnects; }
+    // ms from losing the connection (or starting WiFi) to having an address again
+    uint32_t                      lastConnectTime() const { return m_lastConnectTime; }
+
 private:
     static WifiService*           s_instance;
 
+    static const uint32_t         kMinRetryDelay = 5000;        // ms
+    static const uint32_t         kMaxRetryDelay = 60000;       // ms
+    static const uint32_t         kConnectTimeout = 15000;      // ms an attempt gets before it is given up
+    static const uint32_t         kLeaseReuse = 5 * 60 * 1000UL; // ms offline the old address is still used
+
     State*                        m_state = State::getInstance();
     Config*                       m_config = Config::getInstance();
-    MDNSService*                  m_mdns = MDNSService::getInstance();              
 
-    bool                          m_wifiPrevState = false; // previous WIFI connection state; 0 - disconnected, 1 - connected
-    unsigned long                 m_wifiCheckTimedUl = 30000;
-    int                           m_wifiReconnectCount = 0;
+    bool                          m_connected = false;
+    uint32_t                      m_lostAt = 0;                 // millis() the connection went away
+    bool                          m_attempting = false;
+    uint32_t                      m_attemptAt = 0;
+    uint32_t                      m_failedAt = 0;               // millis() the last attempt failed
+    uint32_t                      m_retryDelay = 0;             // 0 until the first attempt after a drop failed
+    bool                          m_staticLease = false;        // the running attempt reuses the old address
+    std::atomic<uint32_t>         m_gotIpAt{0};                 // set by the WiFi event handler
+    std::atomic<bool>             m_attemptFailed{false};       // set by the WiFi event handler
+    uint32_t                      m_reconnects = 0;
+    uint32_t                      m_lastConnectTime = 0;
+
+    // the last connection
+    bool                          m_cached = false;
+    uint8_t                       m_bssid[6];
+    int32_t                       m_channel = 0;
+    IPAddress                     m_ip;
+    IPAddress                     m_gateway;
+    IPAddress                     m_subnet;
+    IPAddress                     m_dns;
+
+    void                          connected();
+    // straight to the cached access point, or a scan for the SSID
+    void                          attempt(bool fast);
+    // the running attempt failed or timed out
+    void                          failed(bool timedOut);
 };
 
-#endif
\ No newline at end of file
+#endif
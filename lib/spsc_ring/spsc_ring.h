@@ -0,0 +1,93 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Bounded lock-free queue for exactly one producer and one consumer task.
+// Items are copied in and out, a push to a full ring fails and is counted as a drop.
+// Large items can be filled and read in place with acquire/commit and front/release instead.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    // producer side
+    bool push(const T& item)
+    {
+        uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == N)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_items[head & (N - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // producer side, in place: the slot to fill or nullptr when full, commit() publishes it
+    T* acquire()
+    {
+        uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == N)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &m_items[head & (N - 1)];
+    }
+
+    void commit()
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer side
+    bool pop(T& item)
+    {
+        uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = m_items[tail & (N - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, in place: the oldest item or nullptr when empty, release() frees it
+    const T* front()
+    {
+        uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &m_items[tail & (N - 1)];
+    }
+
+    void release()
+    {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+    uint32_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    T                       m_items[N];
+    std::atomic<uint32_t>   m_head{0};      // written by the producer only
+    std::atomic<uint32_t>   m_tail{0};      // written by the consumer only
+    std::atomic<uint32_t>   m_dropped{0};
+};
+
+#endif
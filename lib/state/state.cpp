@@ -1,6 +1,9 @@
 #include <Arduino.h>
 #include "state.h"
 #include "config.h"
+#include "events.h"
+#include "trace.h"
+#include "log.h"
 
 State* State::s_instance = nullptr;
 
@@ -11,21 +14,184 @@ State::State()
     printDockInfo();
 }
 
+bool State::operational(States state)
+{
+    return state == NORMAL || state == NORMAL_CHARGING || state == NORMAL_FULLYCHARGED
+        || state == NORMAL_LOWBATTERY || state == LED_SETUP;
+}
+
+bool State::allowed(States from, States to)
+{
+    // the dock only goes back to setup through a reset and reboot
+    if (to == SETUP || to >= STATE_COUNT)
+    {
+        return false;
+    }
+    if (to == ERROR || to == CONNECTING)
+    {
+        return true;
+    }
+
+    switch (from)
+    {
+    case SETUP:
+    case ERROR:
+        return false;
+    case CONNECTING:
+        return to == CONN_SUCCESS;
+    case CONN_SUCCESS:
+        return to == NORMAL || to == NORMAL_CHARGING;
+    default:
+        return operational(from) && operational(to);
+    }
+}
+
+bool State::set(States next)
+{
+    States current = get();
+    while (true)
+    {
+        if (current == next)
+        {
+            return true;
+        }
+        if (!allowed(current, next))
+        {
+            m_rejected++;
+            LOG_WARN("STATE", "%s -> %s not allowed", name(current), name(next));
+            return false;
+        }
+        uint8_t expected = current;
+        if (m_state.compare_exchange_weak(expected, next))
+        {
+            changed(current, next);
+            return true;
+        }
+        current = static_cast<States>(expected);
+    }
+}
+
+bool State::compareAndSet(States expected, States next)
+{
+    if (expected == next)
+    {
+        return get() == expected;
+    }
+    if (!allowed(expected, next))
+    {
+        m_rejected++;
+        return false;
+    }
+    uint8_t current = expected;
+    if (!m_state.compare_exchange_strong(current, next))
+    {
+        return false;
+    }
+    changed(expected, next);
+    return true;
+}
+
+void State::setCharging(bool charging)
+{
+    m_charging = charging;
+
+    // the operational states follow the pin, brightness setup stays until it's done;
+    // any other state picks the flag up through idleState()
+    States target = charging ? NORMAL_CHARGING : NORMAL;
+    States current = get();
+    while (operational(current) && current != LED_SETUP && current != target)
+    {
+        if (compareAndSet(current, target))
+        {
+            break;
+        }
+        current = get();
+    }
+}
+
+bool State::subscribe(TaskHandle_t task)
+{
+    if (m_subscriberCount >= kMaxSubscribers)
+    {
+        return false;
+    }
+    m_subscribers[m_subscriberCount++] = task;
+    return true;
+}
+
+uint8_t State::history(Transition* transitions, uint8_t max)
+{
+    portENTER_CRITICAL(&m_logLock);
+    uint8_t count = m_logCount < kLogSize ? m_logCount : kLogSize;
+    if (count > max)
+    {
+        count = max;
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+        transitions[i] = m_log[(m_logCount - count + i) % kLogSize];
+    }
+    portEXIT_CRITICAL(&m_logLock);
+    return count;
+}
+
+void State::changed(States from, States to)
+{
+    Transition transition = { millis(), static_cast<uint8_t>(from), static_cast<uint8_t>(to) };
+    portENTER_CRITICAL(&m_logLock);
+    m_log[m_logCount % kLogSize] = transition;
+    m_logCount++;
+    portEXIT_CRITICAL(&m_logLock);
+    Trace::record(Trace::TRACE_STATE, from, to);
+
+    LOG_INFO("STATE", "%s -> %s", name(from), name(to));
+
+    for (uint8_t i = 0; i < m_subscriberCount; i++)
+    {
+        xTaskNotifyGive(m_subscribers[i]);
+    }
+    Events::post(Events::EVENT_STATE);
+}
+
+const char* State::name(States state)
+{
+    switch (state)
+    {
+    case SETUP:
+        return "setup";
+    case CONNECTING:
+        return "connecting";
+    case CONN_SUCCESS:
+        return "conn_success";
+    case NORMAL:
+        return "normal";
+    case NORMAL_CHARGING:
+        return "normal_charging";
+    case ERROR:
+        return "error";
+    case LED_SETUP:
+        return "led_setup";
+    case NORMAL_FULLYCHARGED:
+        return "normal_fullycharged";
+    case NORMAL_LOWBATTERY:
+        return "normal_lowbattery";
+    default:
+        return "unknown";
+    }
+}
+
 void State::reboot()
 {
-    Serial.println(F("About to reboot..."));
+    LOG_INFO("STATE", "About to reboot...");
+    // settings changed just before, e.g. new WiFi credentials, must survive the restart
+    Config::getInstance()->commit();
     delay(2000);
-    Serial.println(F("Now rebooting..."));
+    LOG_INFO("STATE", "Now rebooting...");
     ESP.restart();
 }
 
 void State::printDockInfo()
 {
-    Serial.println(F(""));
-    Serial.println(F(""));
-    Serial.println(F("############################################################"));
-    Serial.println(F("## YIO Dock firmware                                      ##"));
-    Serial.println(F("## Visit http://yio-remote.com/ for more information      ##"));
-    Serial.println(F("############################################################"));
-    Serial.println(F(""));
+    // through the log queue, the UART doesn't hold up the boot
+    LOG_INFO("STATE", "YIO Dock firmware, visit http://yio-remote.com/ for more information");
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #ifndef STATE_H
 #define STATE_H
 
+#include <Arduino.h>
+#include <atomic>
+
+// The dock state, changed only along the transition table.
+// Subscribed tasks get a task notification on every change, the main loop an EVENT_STATE.
+// Whether a remote sits on the charger is kept apart from the state, so it isn't lost
+// while the dock is connecting and the state can't show it.
 class State
 {
 public:
@@ -13,23 +20,67 @@ public:
 	  ERROR                 =   5,     // 5 - error
 	  LED_SETUP             =   6,     // 6 - LED brightness setup
 	  NORMAL_FULLYCHARGED   =   7,     // 7 - normal operation, remote fully charged
-      NORMAL_LOWBATTERY     =   8      // 8 - normal operation, blinks to indicate remote is low battery
+      NORMAL_LOWBATTERY     =   8,     // 8 - normal operation, blinks to indicate remote is low battery
+      STATE_COUNT
 	};
 
+    // a state change, for diagnostics
+    struct Transition {
+        uint32_t            time;           // millis()
+        uint8_t             from;
+        uint8_t             to;
+    };
+
+    static const uint8_t    kLogSize = 16;
+    static const uint8_t    kMaxSubscribers = 4;
+
     explicit State();
     virtual ~State(){}
 
     static State*           getInstance() { return s_instance; }
 
 	// current state
-    States                  currentState = SETUP;
+    States                  get() const { return static_cast<States>(m_state.load()); }
+    // false when the table doesn't allow the change
+    bool                    set(States next);
+    // changes the state only if it still is expected
+    bool                    compareAndSet(States expected, States next);
+    static bool             allowed(States from, States to);
+    static const char*      name(States state);
+
+    // the charging pin, moves the operational states along
+    void                    setCharging(bool charging);
+    bool                    isCharging() const { return m_charging; }
+    // where the dock goes when nothing else is going on
+    States                  idleState() const { return m_charging ? NORMAL_CHARGING : NORMAL; }
+
+    // notifies the task with xTaskNotifyGive on every change
+    bool                    subscribe(TaskHandle_t task);
+
+    // the last transitions, oldest first, returns how many were copied
+    uint8_t                 history(Transition* transitions, uint8_t max);
+    uint32_t                rejected() const { return m_rejected; }
 
 	// reboots the ESP
 	void 					reboot();
-	void					printDockInfo(); 
+	void					printDockInfo();
 
 private:
     static State*           s_instance;
+
+    std::atomic<uint8_t>    m_state{SETUP};
+    std::atomic<bool>       m_charging{false};
+    std::atomic<uint32_t>   m_rejected{0};
+
+    TaskHandle_t            m_subscribers[kMaxSubscribers] = {};
+    uint8_t                 m_subscriberCount = 0;
+
+    portMUX_TYPE            m_logLock = portMUX_INITIALIZER_UNLOCKED;
+    Transition              m_log[kLogSize];
+    uint32_t                m_logCount = 0;
+
+    void                    changed(States from, States to);
+    static bool             operational(States state);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,76 @@
+#include "trace.h"
+
+Trace::Entry Trace::s_entries[Trace::kSize] = {};
+std::atomic<uint32_t> Trace::s_next{0};
+std::atomic<TaskHandle_t> Trace::s_tasks[Trace::kTasks] = {};
+char Trace::s_taskNames[Trace::kTasks][Trace::kTaskNameSize] = {};
+
+uint8_t Trace::taskSlot()
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < kTasks; i++)
+    {
+        TaskHandle_t slot = s_tasks[i].load(std::memory_order_relaxed);
+        if (slot == nullptr && s_tasks[i].compare_exchange_strong(slot, task, std::memory_order_relaxed))
+        {
+            // a dump in between may see the name torn, like an entry
+            strncpy(s_taskNames[i], pcTaskGetName(task), kTaskNameSize - 1);
+            return i;
+        }
+        if (slot == task)
+        {
+            return i;
+        }
+    }
+    return kTasks;
+}
+
+static void putU16(uint8_t* out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void putU32(uint8_t* out, uint32_t value)
+{
+    putU16(out, value & 0xFFFF);
+    putU16(out + 2, value >> 16);
+}
+
+size_t Trace::dump(uint8_t* out, size_t size)
+{
+    uint32_t total = s_next.load(std::memory_order_relaxed);
+    uint16_t count = total < kSize ? total : kSize;
+    uint8_t tasks = 0;
+    while (tasks < kTasks && s_tasks[tasks].load(std::memory_order_relaxed) != nullptr)
+    {
+        tasks++;
+    }
+    size_t length = kHeaderSize + count * sizeof(Entry) + tasks * kTaskNameSize;
+    if (size < length)
+    {
+        return 0;
+    }
+
+    out[0] = 'T';
+    out[1] = 2;
+    out[2] = sizeof(Entry);
+    out[3] = tasks;
+    putU16(out + 4, count);
+    putU16(out + 6, total > 0xFFFF ? 0xFFFF : total);
+    putU32(out + 8, static_cast<uint32_t>(esp_timer_get_time()));
+
+    uint8_t* p = out + kHeaderSize;
+    for (uint32_t i = total - count; i != total; i++)
+    {
+        const Entry& entry = s_entries[i & (kSize - 1)];
+        putU32(p, entry.time);
+        p[4] = entry.event;
+        p[5] = entry.task;
+        putU16(p + 6, entry.arg);
+        putU32(p + 8, entry.value);
+        p += sizeof(Entry);
+    }
+    memcpy(p, s_taskNames, tasks * kTaskNameSize);
+    return length;
+}
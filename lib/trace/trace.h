@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// entries kept in RAM, a power of two, override with build flags
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 256
+#endif
+
+// Timestamped binary record of what the dock did last, for finding out what happened in
+// the field. Recording is a lock-free slot claim and a few stores, from any task or ISR.
+// Entries name the task that wrote them, an ISR counts as the task it interrupted.
+// The trace_dump command hands out the ring, tools/trace_to_chrome.py turns it into a
+// Chrome trace (chrome://tracing or ui.perfetto.dev).
+class Trace
+{
+public:
+    enum Event : uint8_t {
+        TRACE_INGRESS       =   1,      // arg: API source, value: message length
+        TRACE_DISPATCH_BEGIN =  2,      // value: command hash
+        TRACE_DISPATCH_END  =   3,      // value: command hash
+        TRACE_IR_SEND_BEGIN =   4,      // value: request id
+        TRACE_IR_SEND_END   =   5,      // arg: success, value: request id
+        TRACE_IR_DECODE     =   6,      // arg: bits, value: protocol
+        TRACE_WIFI          =   7,      // arg: WiFi event id
+        TRACE_STATE         =   8,      // arg: old state, value: new state
+        TRACE_MDNS_RESTART  =   9       // arg: success
+    };
+
+    // 12 bytes, little endian on the wire as in memory
+    struct Entry {
+        uint32_t            time;       // esp_timer_get_time(), wraps after 71 minutes
+        uint8_t             event;
+        uint8_t             task;       // task table slot, the top bit is the core
+        uint16_t            arg;
+        uint32_t            value;
+    };
+
+    static const uint16_t   kSize = TRACE_SIZE;
+    static const uint8_t    kHeaderSize = 12;
+    static const uint8_t    kTasks = 15;            // tasks told apart, the rest share slot kTasks
+    static const uint8_t    kTaskNameSize = 16;     // configMAX_TASK_NAME_LEN
+
+    static void             record(Event event, uint16_t arg = 0, uint32_t value = 0)
+    {
+        Entry& entry = s_entries[s_next.fetch_add(1, std::memory_order_relaxed) & (kSize - 1)];
+        entry.time = static_cast<uint32_t>(esp_timer_get_time());
+        entry.event = event;
+        entry.task = static_cast<uint8_t>(taskSlot() | (xPortGetCoreID() << 7));
+        entry.arg = arg;
+        entry.value = value;
+    }
+
+    // bytes dump() needs at most
+    static size_t           dumpSize() { return kHeaderSize + kSize * sizeof(Entry) + kTasks * kTaskNameSize; }
+
+    // writes 'T', version, entry size, the task count, the entry count and the number recorded
+    // since boot (2 bytes each, the latter saturates), the current time (4 bytes), then the
+    // entries oldest first and the task names by slot, null padded to kTaskNameSize;
+    // returns the length, 0 if size is too small.
+    // Entries written during the dump may be torn, the decoder drops what doesn't parse.
+    static size_t           dump(uint8_t* out, size_t size);
+
+private:
+    static_assert(sizeof(Entry) == 12, "trace entries are 12 bytes on the wire");
+    static_assert(kSize > 0 && (kSize & (kSize - 1)) == 0, "TRACE_SIZE must be a power of two");
+
+    static Entry                    s_entries[kSize];
+    static std::atomic<uint32_t>    s_next;
+
+    // claimed by the first entry of a task, a handle is never freed again
+    static std::atomic<TaskHandle_t> s_tasks[kTasks];
+    static char                     s_taskNames[kTasks][kTaskNameSize];
+
+    // the slot of the running task, kTasks once the table is full
+    static uint8_t                  taskSlot();
+};
+
+#endif
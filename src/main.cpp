@@ -8,6 +8,10 @@
 #include <service_blueooth.h>
 #include <service_mdns.h>
 #include <service_api.h>
+#include <ir_library.h>
+#include <profiler.h>
+#include <events.h>
+#include <log.h>
 
 // PIN SETUP
 // Indicator LED, IR receiver and IR LED pins are setup in the corresponding classes
@@ -24,68 +28,64 @@ MDNSService* mdnsService;
 OTA otaService;
 API* api;
 InfraredService* irService;
+IrLibrary* irLibrary;
 
-bool resetMarker = false;
+// the main loop also wakes this often when nothing happens, to poll the sockets
+#define LOOP_POLL_INTERVAL 10
 
 ////////////////////////////////////////////////////////////////
 // INTERRUPT SETUPS
 ////////////////////////////////////////////////////////////////
-// charging pin interrupt callback
-void setCharging()
+// charging pin interrupt callback, the main loop updates the state
+void IRAM_ATTR handleChargingChange()
 {
-  Serial.print(F("[MAIN] CHG pin is: "));
-  Serial.println(digitalRead(CHARGING_GPIO));
-  if (digitalRead(CHARGING_GPIO) == LOW)
-  {
-    state->currentState = State::NORMAL_CHARGING;
+  Events::postFromISR(Events::EVENT_CHARGING);
+}
 
-    // change state->currentState back to normal charging when it was signalling low battery before
-    if (state->currentState == State::NORMAL_LOWBATTERY)
-    {
-      state->currentState = State::NORMAL_CHARGING;
-    }
-  }
-  else
-  {
-    state->currentState = State::NORMAL;
-  }
+void updateCharging()
+{
+  LOG_DEBUG("MAIN", "CHG pin is: %d", digitalRead(CHARGING_GPIO));
+  // low while a remote charges, also ends a low battery signal
+  state->setCharging(digitalRead(CHARGING_GPIO) == LOW);
 }
 
 // charging pin
 const int64_t TIMER_RESET_TIME = 9223372036854775807;
-int64_t buttonTimerSet = TIMER_RESET_TIME;
+volatile int64_t buttonTimerSet = TIMER_RESET_TIME;
+volatile int64_t buttonHeldFor = 0;
 
 void setupChargingPin()
 {
   pinMode(CHARGING_GPIO, INPUT);
-  attachInterrupt(CHARGING_GPIO, setCharging, CHANGE);
-  if (digitalRead(CHARGING_GPIO) == LOW) // if there's a remote already charging, turn on charging
-  {
-    state->currentState = State::NORMAL_CHARGING;
-  }
+  attachInterrupt(CHARGING_GPIO, handleChargingChange, CHANGE);
+  // if there's a remote already charging, turn on charging
+  state->setCharging(digitalRead(CHARGING_GPIO) == LOW);
 }
 
-// button press interrupt callback
-void handleButtonPress()
+// button press interrupt callback, the main loop decides what the press means
+void IRAM_ATTR handleButtonPress()
 {
   const int64_t timerCurrent = esp_timer_get_time();
   if (digitalRead(BUTTON_GPIO) == LOW)
   {
     buttonTimerSet = timerCurrent;
-    Serial.print(F("[MAIN] Button is pressed."));
   }
-  else
+  else if (buttonTimerSet != TIMER_RESET_TIME)
   {
-    const int elapsedTimeInMiliSeconds = ((timerCurrent - buttonTimerSet) / 1000);
-    Serial.print(F("[MAIN] Button held for "));
-    Serial.print(elapsedTimeInMiliSeconds);
-    Serial.println(F(" mili seconds."));
+    buttonHeldFor = timerCurrent - buttonTimerSet;
     buttonTimerSet = TIMER_RESET_TIME;
+    Events::postFromISR(Events::EVENT_BUTTON);
+  }
+}
 
-    if (elapsedTimeInMiliSeconds > 3000 && elapsedTimeInMiliSeconds < 10000) // between 5 and 20 seconds.
-    {
-      resetMarker = true;
-    }
+void handleButtonRelease()
+{
+  const int elapsedTimeInMiliSeconds = buttonHeldFor / 1000;
+  LOG_INFO("MAIN", "Button held for %d mili seconds.", elapsedTimeInMiliSeconds);
+
+  if (elapsedTimeInMiliSeconds > 3000 && elapsedTimeInMiliSeconds < 10000) // between 3 and 10 seconds.
+  {
+    config->reset();
   }
 }
 
@@ -101,45 +101,70 @@ void setupButtonPin()
 ////////////////////////////////////////////////////////////////
 void setup()
 {
+  Profiler::bootMark(Profiler::BOOT_SETUP);
   Serial.begin(115200);
+  Log::init();
+  Events::init();
 
   config = new Config();
+  Profiler::bootMark(Profiler::BOOT_CONFIG);
   state = new State();
   ledControl = new LedControl();
   ledControl->setLedMaxBrightness(config->getLedBrightness());
   wifiService = new WifiService();
+
+  if (config->getWifiSsid() != "") {
+    state->set(State::CONNECTING);
+    LOG_INFO("MAIN", "SSID found, connecting...");
+
+    // the radio associates in the background while the other services start
+    wifiService->initiateWifi();
+    Profiler::bootMark(Profiler::BOOT_WIFI_START);
+  }
+
   bluetoothService = new BluetoothService();
   irService = new InfraredService();
+  irLibrary = new IrLibrary();
   api = new API();
   mdnsService = new MDNSService();
 
-  if (config->getWifiSsid() != "") {
-    state->currentState = State::CONNECTING;
-    Serial.println(F("[MAIN] SSID found, connecting..."));
-  }
-
   // initialize Bluetooth
-  if (state->currentState == State::SETUP) {
+  if (state->get() == State::SETUP) {
     bluetoothService->init();
   } else {
+    // no Bluetooth without setup, its memory goes to the heap
+    bluetoothService->release();
+
     // CHARGING PIN setup
     setupChargingPin();
 
     // BUTTON PIN setup
     setupButtonPin();
 
-    // initiate WiFi
-    wifiService->initiateWifi();
+    // initialize IR service
+    irService->init();
+    Profiler::bootMark(Profiler::BOOT_IR);
 
     // initialize API service
     api->init();
+    Profiler::bootMark(Profiler::BOOT_API);
+
+    // load stored IR codes
+    irLibrary->init();
+    Profiler::bootMark(Profiler::BOOT_IR_LIBRARY);
 
     // initialize OTA service
     otaService.init();
 
-    // initialize IR service
-    irService->init();
+    // announce the services once WiFi has an address
+    mdnsService->init();
+
+    // periodic work, WiFi events and the IR tasks post their own bits
+    Events::every("wifiCheck", 1000, Events::EVENT_WIFI);
+    Events::every("mdnsCheck", 1000, Events::EVENT_MDNS);
+    Events::post(Events::EVENT_WIFI | Events::EVENT_MDNS);
   }
+  Profiler::bootMark(Profiler::BOOT_SETUP_DONE);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -147,28 +172,49 @@ void setup()
 ////////////////////////////////////////////////////////////////
 void loop()
 {
-  if (state->currentState == State::SETUP) {
-    // Handle incoming bluetooth serial data
+  // write back changed settings
+  config->loop();
+
+  if (state->get() == State::SETUP) {
+    // Handle incoming bluetooth serial data, sleeps until some arrives
+    Events::wait(pdMS_TO_TICKS(LOOP_POLL_INTERVAL));
     bluetoothService->handle();
   } else {
+    // sleep until a service has work, the idle time shows in the profiler report
+    EventBits_t events = Events::wait(pdMS_TO_TICKS(LOOP_POLL_INTERVAL));
+    PROFILE_SCOPE(Profiler::MAIN_LOOP);
+
     // Handle wifi disconnects.
-    wifiService->handleReconnect();
+    if (events & Events::EVENT_WIFI) {
+      wifiService->handleReconnect();
+    }
 
-    // Handle api calls
+    // Handle api calls, also sends what the IR tasks queued up
     api->loop();
 
-    // handle IR
-    irService->loop();
-
     // handle MDNS
-    mdnsService->loop();
+    if (events & Events::EVENT_MDNS) {
+      mdnsService->loop();
+    }
 
     // Handle OTA updates.
     otaService.handle();
 
-    // reset if marker is set
-    if (resetMarker) {
-      config->reset();
+    if (events & Events::EVENT_CHARGING) {
+      updateCharging();
+    }
+
+    // let the clients know about state changes
+    if (events & Events::EVENT_STATE) {
+      api->sendState();
+    }
+
+    // reset if the button was held long enough
+    if (events & Events::EVENT_BUTTON) {
+      handleButtonRelease();
     }
+
+    // print profiling report, only with YIO_PROFILE
+    Profiler::loop();
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,108 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// The parts of the ESP32 Arduino core the dock libraries use, for host builds (env:native).
+// Time is virtual: millis(), micros() and esp_timer_get_time() only move when delay(),
+// vTaskDelay() or Native::advance() move them. The cycle counter runs on the host clock,
+// so the profiler still measures real work.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "WString.h"
+#include "IPAddress.h"
+#include "Print.h"
+
+#define IRAM_ATTR
+#define F(string_literal) (string_literal)
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define CHANGE 0x03
+
+using std::min;
+using std::max;
+using std::abs;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// 32 bit like on the ESP32, so differences wrap the same way
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+
+int64_t esp_timer_get_time();
+
+// newlib has it, glibc only since 2.38
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH
+} esp_mac_type_t;
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type);
+
+// the serial port, input is fed and output read back by tests
+class HardwareSerial : public Print
+{
+public:
+    void        begin(unsigned long baud) { (void)baud; }
+    int         available();
+    int         read();
+    int         peek();
+    void        flush() {}
+
+    using Print::write;
+    size_t      write(uint8_t byte) override;
+    size_t      write(const uint8_t* buffer, size_t size) override;
+
+    // test side
+    void        feed(const void* data, size_t length);
+    void        feed(const char* text) { feed(text, strlen(text)); }
+    String      output() const;
+    void        clearOutput();
+    void        clearInput();
+};
+
+extern HardwareSerial Serial;
+
+// heap figures come from the allocation hooks in heap.cpp
+class EspClass
+{
+public:
+    static const uint32_t kHeapSize = 320 * 1024;
+
+    uint32_t    getCycleCount();
+    uint32_t    getCpuFreqMHz() { return 240; }
+    uint32_t    getHeapSize() { return kHeapSize; }
+    uint32_t    getFreeHeap();
+    uint32_t    getMinFreeHeap();
+    uint32_t    getMaxAllocHeap() { return getFreeHeap(); }
+    // counted instead, see Native::restarts()
+    void        restart();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef BLUETOOTH_SERIAL_H
+#define BLUETOOTH_SERIAL_H
+
+#include <Arduino.h>
+#include <string>
+
+// An SPP link with a scripted peer: the test connects, sends and reads back what the dock
+// wrote. Events reach the registered callback like the Bluedroid ones do.
+
+typedef enum {
+    ESP_SPP_INIT_EVT        = 0,
+    ESP_SPP_OPEN_EVT        = 26,
+    ESP_SPP_CLOSE_EVT       = 27,
+    ESP_SPP_DATA_IND_EVT    = 30,
+    ESP_SPP_SRV_OPEN_EVT    = 34
+} esp_spp_cb_event_t;
+
+typedef union {
+    struct {
+        uint32_t    handle;
+        uint16_t    len;
+        uint8_t*    data;
+    } data_ind;
+} esp_spp_cb_param_t;
+
+typedef void (*esp_spp_cb_t)(esp_spp_cb_event_t event, esp_spp_cb_param_t* param);
+
+class BluetoothSerial : public Print
+{
+public:
+    BluetoothSerial();
+    ~BluetoothSerial();
+
+    bool            begin(String localName = String(), bool isMaster = false);
+    void            end();
+    esp_err_t       register_callback(esp_spp_cb_t callback);
+
+    int             available();
+    int             read();
+    size_t          readBytes(uint8_t* buffer, size_t length);
+
+    using Print::write;
+    size_t          write(uint8_t byte) override;
+    size_t          write(const uint8_t* buffer, size_t size) override;
+
+    // test side, the last BluetoothSerial created
+    static BluetoothSerial* instance() { return s_instance; }
+
+    bool            started() const { return m_started; }
+    const String&   name() const { return m_name; }
+    void            connect();
+    // queues the bytes and raises ESP_SPP_DATA_IND_EVT, like one SPP packet
+    void            receive(const void* data, size_t length);
+    void            receive(const char* text) { receive(text, strlen(text)); }
+    void            disconnect();
+    const std::string& output() const { return m_output; }
+    void            clearOutput() { m_output.clear(); }
+    size_t          writes() const { return m_writes; }
+
+private:
+    static BluetoothSerial* s_instance;
+
+    esp_spp_cb_t    m_callback = nullptr;
+    bool            m_started = false;
+    String          m_name;
+    std::string     m_input;
+    size_t          m_readPosition = 0;
+    std::string     m_output;
+    size_t          m_writes = 0;
+
+    void            event(esp_spp_cb_event_t event, esp_spp_cb_param_t* param);
+};
+
+#endif
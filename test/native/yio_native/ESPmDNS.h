@@ -0,0 +1,28 @@
+#ifndef ESPMDNS_H
+#define ESPMDNS_H
+
+#include <Arduino.h>
+
+class MDNSResponder
+{
+public:
+    bool        begin(const char* hostName) { m_running = hostName != nullptr && *hostName != '\0'; return m_running; }
+    void        end() { m_running = false; }
+    bool        addService(const char* service, const char* protocol, uint16_t port) { (void)service; (void)protocol; (void)port; return m_running; }
+    bool        addServiceTxt(const char* service, const char* protocol, const char* key, const String& value)
+    {
+        (void)service; (void)protocol; (void)key; m_txt = value; return m_running;
+    }
+
+    // test side
+    bool        running() const { return m_running; }
+    const String& txt() const { return m_txt; }
+
+private:
+    bool        m_running = false;
+    String      m_txt;
+};
+
+extern MDNSResponder MDNS;
+
+#endif
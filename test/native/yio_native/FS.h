@@ -0,0 +1,80 @@
+#ifndef FS_H
+#define FS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+struct NativeFileData;
+
+class File
+{
+public:
+    File() {}
+    File(std::shared_ptr<NativeFileData> data, bool writable, size_t position)
+        : m_data(data), m_writable(writable), m_position(position) {}
+
+    size_t      write(const uint8_t* buffer, size_t size);
+    size_t      write(uint8_t byte) { return write(&byte, 1); }
+    size_t      read(uint8_t* buffer, size_t size);
+    int         read();
+    bool        seek(uint32_t position);
+    size_t      position() const { return m_position; }
+    size_t      size() const;
+    void        close() { m_data.reset(); }
+    operator    bool() const { return m_data != nullptr; }
+
+private:
+    std::shared_ptr<NativeFileData> m_data;
+    bool        m_writable = false;
+    size_t      m_position = 0;
+};
+
+// A flat in-memory file system. Files live until removed or reset(), an open File keeps
+// its data even after a remove, like SPIFFS file descriptors. Writes can be made to fail
+// after a number of bytes and renames to fail, to play power loss and a full partition.
+class FS
+{
+public:
+    bool        begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10);
+    void        end() { m_mounted = false; }
+
+    File        open(const char* path, const char* mode = FILE_READ);
+    File        open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool        exists(const char* path);
+    bool        remove(const char* path);
+    // fails when to exists, like SPIFFS
+    bool        rename(const char* from, const char* to);
+
+    // test side
+    void        reset();
+    // writes of all files stop after this many more bytes, -1 for no limit
+    void        failWritesAfter(long bytes) { m_writeBudget = bytes; }
+    void        failRenames(bool fail) { m_failRenames = fail; }
+    std::vector<uint8_t> contents(const char* path);
+    void        setContents(const char* path, const std::vector<uint8_t>& data);
+
+    // how many bytes a write of size may take, used by File
+    size_t      takeWriteBudget(size_t size);
+
+private:
+    std::map<std::string, std::shared_ptr<NativeFileData>> m_files;
+    bool        m_mounted = false;
+    long        m_writeBudget = -1;
+    bool        m_failRenames = false;
+};
+
+}
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef IPADDRESS_H
+#define IPADDRESS_H
+
+#include <stdint.h>
+
+class IPAddress
+{
+public:
+    IPAddress() : m_address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        : m_address(a | (b << 8) | (c << 16) | (static_cast<uint32_t>(d) << 24)) {}
+    IPAddress(uint32_t address) : m_address(address) {}
+
+    operator uint32_t() const { return m_address; }
+    uint8_t operator[](int index) const { return (m_address >> (8 * index)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return m_address == other.m_address; }
+    bool operator!=(const IPAddress& other) const { return m_address != other.m_address; }
+
+private:
+    uint32_t m_address;     // first octet in the low byte, as lwIP keeps it
+};
+
+extern const IPAddress INADDR_NONE;
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef IRAC_H
+#define IRAC_H
+
+#include "IRremoteESP8266.h"
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef IRRECV_H
+#define IRRECV_H
+
+#include "IRremoteESP8266.h"
+
+class decode_results
+{
+public:
+    decode_type_t       decode_type = UNKNOWN;
+    union {
+        struct {
+            uint64_t    value;
+            uint32_t    address;
+            uint32_t    command;
+        };
+        uint8_t         state[kStateSizeMax];
+    };
+    uint16_t            bits = 0;
+    volatile uint16_t*  rawbuf = nullptr;
+    uint16_t            rawlen = 0;
+    bool                overflow = false;
+    bool                repeat = false;
+
+    decode_results() : value(0), address(0), command(0) {}
+};
+
+// no hardware, decode() hands out what the test queued with inject()
+class IRrecv
+{
+public:
+    IRrecv(uint16_t recvPin, uint16_t bufferSize, uint8_t timeout, bool saveBuffer = false);
+    ~IRrecv();
+
+    void        setUnknownThreshold(uint16_t length) { m_unknownThreshold = length; }
+    void        enableIRIn(bool pullup = false) { (void)pullup; m_enabled = true; }
+    void        disableIRIn() { m_enabled = false; }
+    bool        decode(decode_results* results);
+
+    // test side, the capture the next decode() returns
+    void        inject(const decode_results& results, const uint16_t* timings, uint16_t count);
+
+private:
+    uint16_t    m_bufferSize;
+    uint16_t*   m_rawbuf;
+    uint16_t    m_unknownThreshold = 0;
+    bool        m_enabled = false;
+    bool        m_pending = false;
+    decode_results m_pendingResults;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef IRREMOTEESP8266_H
+#define IRREMOTEESP8266_H
+
+#include <Arduino.h>
+
+// The protocol numbers match IRremoteESP8266, only the ones the tests use are listed
+enum decode_type_t {
+    UNKNOWN = -1,
+    UNUSED = 0,
+    RC5,
+    RC6,
+    NEC,
+    SONY,
+    PANASONIC,
+    JVC,
+    SAMSUNG,
+    WHYNTER,
+    AIWA_RC_T501,
+    LG,
+    SANYO,
+    MITSUBISHI,
+    DISH,
+    SHARP,
+    COOLIX,
+    DAIKIN,
+    DENON,
+    KELVINATOR,
+    SHERWOOD,
+    MITSUBISHI_AC,
+    RCMM,
+    SANYO_LC7461,
+    RC5X,
+    GREE,
+    PRONTO,
+    kLastDecodeType = PRONTO
+};
+
+const uint16_t kNoRepeat = 0;
+const uint16_t kStateSizeMax = 53;
+const uint16_t kRawTick = 2;
+
+#endif
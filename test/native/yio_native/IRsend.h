@@ -0,0 +1,42 @@
+#ifndef IRSEND_H
+#define IRSEND_H
+
+#include "IRremoteESP8266.h"
+
+// no LED, the sends are counted and the last one kept for checks
+class IRsend
+{
+public:
+    explicit IRsend(uint16_t pin, bool inverted = false, bool useModulation = true) : m_pin(pin)
+    {
+        (void)inverted;
+        (void)useModulation;
+    }
+
+    void        begin() {}
+    bool        send(const decode_type_t type, const uint64_t data, const uint16_t nbits, const uint16_t repeat = kNoRepeat);
+    void        sendPronto(uint16_t data[], uint16_t length, uint16_t repeat = kNoRepeat);
+    void        sendRaw(const uint16_t buffer[], const uint16_t length, const uint16_t hz);
+
+    // test side, shared by all instances
+    struct Stats {
+        uint32_t        sends;
+        uint32_t        rawSends;
+        uint32_t        prontoSends;
+        uint32_t        timings;        // raw timings emitted
+        decode_type_t   lastProtocol;
+        uint64_t        lastValue;
+        uint16_t        lastBits;
+        uint16_t        lastRepeat;
+        uint16_t        lastFrequency;
+    };
+
+    static Stats&   stats() { return s_stats; }
+    static void     resetStats() { s_stats = Stats(); }
+
+private:
+    static Stats    s_stats;
+    uint16_t        m_pin;
+};
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef IRTIMER_H
+#define IRTIMER_H
+
+#include "IRremoteESP8266.h"
+
+#endif
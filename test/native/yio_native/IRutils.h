@@ -0,0 +1,11 @@
+#ifndef IRUTILS_H
+#define IRUTILS_H
+
+#include "IRremoteESP8266.h"
+#include "IRrecv.h"
+
+String      uint64ToString(uint64_t input, uint8_t base = 10);
+bool        hasACState(const decode_type_t protocol);
+String      resultToHumanReadableBasic(const decode_results* const results);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <Arduino.h>
+
+class Preferences
+{
+public:
+    bool        begin(const char* name, bool readOnly = false);
+    void        end();
+    bool        clear();
+
+    int32_t     getInt(const char* key, int32_t defaultValue = 0);
+    size_t      putInt(const char* key, int32_t value);
+    String      getString(const char* key, const String& defaultValue = String());
+    size_t      putString(const char* key, const char* value);
+
+private:
+    String      m_namespace;
+    bool        m_open = false;
+    bool        m_readOnly = false;
+};
+
+#endif
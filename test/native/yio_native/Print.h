@@ -0,0 +1,31 @@
+#ifndef PRINT_H
+#define PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t  write(uint8_t byte) = 0;
+    virtual size_t  write(const uint8_t* buffer, size_t size)
+    {
+        size_t written = 0;
+        while (size-- > 0)
+        {
+            written += write(*buffer++);
+        }
+        return written;
+    }
+    size_t          write(const char* text) { return text != nullptr ? write(reinterpret_cast<const uint8_t*>(text), strlen(text)) : 0; }
+
+    size_t          print(const char* text) { return write(text); }
+    size_t          println(const char* text) { return write(text) + println(); }
+    size_t          println() { return write(reinterpret_cast<const uint8_t*>("\r\n"), 2); }
+    size_t          printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef SPIFFS_H
+#define SPIFFS_H
+
+#include "FS.h"
+
+extern fs::FS SPIFFS;
+
+#endif
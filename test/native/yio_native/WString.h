@@ -0,0 +1,66 @@
+#ifndef WSTRING_H
+#define WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Arduino's String, on the C heap like the real one so allocations are counted
+class String
+{
+public:
+    String(const char* text = "");
+    String(const char* text, size_t length);
+    String(const String& other);
+    String(String&& other) noexcept;
+    explicit String(char c);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    ~String();
+
+    String&         operator=(const String& other);
+    String&         operator=(String&& other) noexcept;
+    String&         operator=(const char* text);
+
+    bool            reserve(size_t size);
+    size_t          length() const { return m_length; }
+    bool            isEmpty() const { return m_length == 0; }
+    const char*     c_str() const { return m_buffer != nullptr ? m_buffer : ""; }
+    char            operator[](size_t index) const { return index < m_length ? m_buffer[index] : '\0'; }
+
+    bool            concat(const char* text, size_t length);
+    bool            concat(const char* text) { return text != nullptr && concat(text, strlen(text)); }
+    bool            concat(const String& other) { return concat(other.c_str(), other.m_length); }
+    bool            concat(char c) { return concat(&c, 1); }
+
+    String&         operator+=(const String& other) { concat(other); return *this; }
+    String&         operator+=(const char* text) { concat(text); return *this; }
+    String&         operator+=(char c) { concat(c); return *this; }
+
+    int             indexOf(char c, unsigned int from = 0) const;
+    String          substring(unsigned int left, unsigned int right) const;
+    String          substring(unsigned int left) const { return substring(left, m_length); }
+    long            toInt() const { return m_buffer != nullptr ? atol(m_buffer) : 0; }
+
+    bool            equals(const char* text) const { return strcmp(c_str(), text != nullptr ? text : "") == 0; }
+    bool            operator==(const String& other) const { return m_length == other.m_length && equals(other.c_str()); }
+    bool            operator==(const char* text) const { return equals(text); }
+    bool            operator!=(const String& other) const { return !(*this == other); }
+    bool            operator!=(const char* text) const { return !equals(text); }
+
+private:
+    char*           m_buffer = nullptr;
+    size_t          m_capacity = 0;
+    size_t          m_length = 0;
+
+    void            assign(const char* text, size_t length);
+};
+
+String operator+(const String& left, const String& right);
+String operator+(const String& left, const char* right);
+String operator+(const char* left, const String& right);
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef WEBSOCKETS_SERVER_H
+#define WEBSOCKETS_SERVER_H
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The server side of arduinoWebSockets without a network: the test opens clients, sends
+// them messages and reads back the frames the dock wrote. Client sockets are writable
+// unless a test stalls them.
+
+#ifndef WEBSOCKETS_SERVER_CLIENT_MAX
+#define WEBSOCKETS_SERVER_CLIENT_MAX (5)
+#endif
+
+typedef enum {
+    WStype_ERROR,
+    WStype_DISCONNECTED,
+    WStype_CONNECTED,
+    WStype_TEXT,
+    WStype_BIN,
+    WStype_FRAGMENT_TEXT_START,
+    WStype_FRAGMENT_BIN_START,
+    WStype_FRAGMENT,
+    WStype_FRAGMENT_FIN,
+    WStype_PING,
+    WStype_PONG
+} WStype_t;
+
+typedef enum {
+    WSop_continuation   = 0x00,
+    WSop_text           = 0x01,
+    WSop_binary         = 0x02,
+    WSop_close          = 0x08,
+    WSop_ping           = 0x09,
+    WSop_pong           = 0x0A
+} WSopcode_t;
+
+typedef enum {
+    WSC_NOT_CONNECTED,
+    WSC_HEADER,
+    WSC_BODY,
+    WSC_CONNECTED
+} WSclientsStatus_t;
+
+// stands in for the WiFiClient of a slot, fd() is a descriptor select() reports writable
+class NativeClient
+{
+public:
+    int         fd() const { return m_fd; }
+    int         m_fd = -1;
+};
+
+typedef struct {
+    uint8_t             num;
+    WSclientsStatus_t   status;
+    NativeClient*       tcp;
+} WSclient_t;
+
+class WebSocketsServer
+{
+public:
+    typedef std::function<void(uint8_t num, WStype_t type, uint8_t* payload, size_t length)> WebSocketServerEvent;
+
+    // a frame the dock wrote
+    struct Frame {
+        WSopcode_t      opcode;
+        bool            fin;
+        std::string     payload;
+    };
+
+    explicit WebSocketsServer(uint16_t port, const String& origin = "", const String& protocol = "arduino");
+    virtual ~WebSocketsServer();
+
+    void        begin();
+    void        loop() {}
+    void        onEvent(WebSocketServerEvent event) { m_event = event; }
+
+    bool        sendTXT(uint8_t num, const char* payload, size_t length = 0);
+    bool        sendTXT(uint8_t num, const uint8_t* payload, size_t length = 0);
+    bool        sendBIN(uint8_t num, const uint8_t* payload, size_t length);
+    void        disconnect(uint8_t num);
+    IPAddress   remoteIP(uint8_t num);
+
+    // test side, the last server created
+    static WebSocketsServer* instance() { return s_instance; }
+
+    void        connectClient(uint8_t num);
+    void        disconnectClient(uint8_t num) { disconnect(num); }
+    // a message from the client, text is null terminated like the library does
+    void        receive(uint8_t num, WStype_t type, const void* data, size_t length);
+    void        receiveText(uint8_t num, const char* text) { receive(num, WStype_TEXT, text, strlen(text)); }
+    // a stalled socket never gets writable
+    void        stall(uint8_t num, bool stalled);
+    // the socket stalls once it took this many more frames, like a full send buffer
+    void        stallAfter(uint8_t num, uint32_t frames);
+    bool        isConnected(uint8_t num) const { return num < WEBSOCKETS_SERVER_CLIENT_MAX && _clients[num].status == WSC_CONNECTED; }
+
+    // frames are kept while capturing, counted always
+    void        capture(bool on) { m_capture = on; }
+    std::vector<Frame>& frames(uint8_t num) { return m_frames[num]; }
+    // the complete messages, fragments joined
+    std::vector<std::string> messages(uint8_t num);
+    uint32_t    frameCount(uint8_t num) const { return m_frameCount[num]; }
+    void        clearFrames();
+
+protected:
+    WSclient_t  _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+
+    bool        sendFrame(WSclient_t* client, WSopcode_t opcode, uint8_t* payload = nullptr, size_t length = 0,
+                          bool fin = true, bool headerToPayload = false);
+
+private:
+    static WebSocketsServer* s_instance;
+
+    WebSocketServerEvent m_event;
+    NativeClient m_tcp[WEBSOCKETS_SERVER_CLIENT_MAX];
+    bool        m_stalled[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+    uint32_t    m_stallAfter[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+    bool        m_capture = true;
+    std::vector<Frame> m_frames[WEBSOCKETS_SERVER_CLIENT_MAX];
+    uint32_t    m_frameCount[WEBSOCKETS_SERVER_CLIENT_MAX] = {};
+    std::vector<uint8_t> m_receiveBuffer;
+
+    void        runEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
+};
+
+#endif
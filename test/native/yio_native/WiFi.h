@@ -0,0 +1,155 @@
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <Arduino.h>
+#include <functional>
+
+// The station interface as a state machine the test drives: begin() starts an attempt,
+// the test decides how it ends with connectAttempt() or failAttempt(), and the events
+// go to the registered handlers like the ones of the Arduino event task.
+
+typedef enum {
+    WL_IDLE_STATUS      = 0,
+    WL_NO_SSID_AVAIL    = 1,
+    WL_CONNECTED        = 3,
+    WL_CONNECT_FAILED   = 4,
+    WL_CONNECTION_LOST  = 5,
+    WL_DISCONNECTED     = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF            = 0,
+    WIFI_STA            = 1,
+    WIFI_AP             = 2,
+    WIFI_AP_STA         = 3
+} wifi_mode_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY            = 0,
+    ARDUINO_EVENT_WIFI_STA_START        = 2,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED    = 4,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP       = 7,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP      = 8,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+
+// the reasons the dock looks at, from wifi_err_reason_t
+typedef enum {
+    WIFI_REASON_ASSOC_LEAVE             = 8,
+    WIFI_REASON_BEACON_TIMEOUT          = 200,
+    WIFI_REASON_NO_AP_FOUND             = 201,
+    WIFI_REASON_AUTH_FAIL               = 202
+} wifi_err_reason_t;
+
+typedef union {
+    struct {
+        uint8_t     ssid[33];
+        uint8_t     ssid_len;
+        uint8_t     bssid[6];
+        uint8_t     channel;
+        uint8_t     reason;
+    } wifi_sta_disconnected;
+} arduino_event_info_t;
+
+typedef arduino_event_info_t WiFiEventInfo_t;
+
+class WiFiClass
+{
+public:
+    typedef void (*WiFiEventCb)(WiFiEvent_t event);
+    typedef std::function<void(WiFiEvent_t event, WiFiEventInfo_t info)> WiFiEventFuncCb;
+
+    int             onEvent(WiFiEventCb handler, WiFiEvent_t event = ARDUINO_EVENT_MAX);
+    int             onEvent(WiFiEventFuncCb handler, WiFiEvent_t event = ARDUINO_EVENT_MAX);
+
+    bool            mode(wifi_mode_t mode) { m_mode = mode; return true; }
+    bool            enableSTA(bool enable) { m_staEnabled = enable; return true; }
+    bool            setSleep(bool enable) { m_sleep = enable; return true; }
+    bool            setHostname(const char* hostname) { m_hostname = hostname; return true; }
+    bool            setAutoReconnect(bool enable) { m_autoReconnect = enable; return true; }
+    void            persistent(bool enable) { m_persistent = enable; }
+
+    // INADDR_NONE for local switches back to DHCP
+    bool            config(IPAddress local, IPAddress gateway, IPAddress subnet,
+                           IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+    wl_status_t     begin(const char* ssid, const char* password = nullptr, int32_t channel = 0,
+                          const uint8_t* bssid = nullptr, bool connect = true);
+    bool            disconnect(bool wifiOff = false, bool eraseAp = false);
+
+    wl_status_t     status() { return m_status; }
+    bool            isConnected() { return m_status == WL_CONNECTED; }
+    uint8_t*        BSSID() { return m_bssid; }
+    int32_t         channel() { return m_channel; }
+    int8_t          RSSI() { return m_status == WL_CONNECTED ? -55 : 0; }
+    IPAddress       localIP() { return m_localIP; }
+    IPAddress       gatewayIP() { return m_gateway; }
+    IPAddress       subnetMask() { return m_subnet; }
+    IPAddress       dnsIP(uint8_t index = 0) { (void)index; return m_dns; }
+
+    // test side
+    struct Attempt {
+        String      ssid;
+        int32_t     channel;            // 0 when the attempt scans
+        bool        bssid;
+        bool        staticIP;           // config() set an address before begin()
+    };
+
+    // the last begin(), attempting stays true until the attempt ends
+    const Attempt&  lastAttempt() const { return m_attempt; }
+    bool            attempting() const { return m_attempting; }
+    uint32_t        begins() const { return m_begins; }
+    uint32_t        disconnects() const { return m_disconnects; }
+    bool            usesDhcp() const { return m_static == IPAddress(); }
+
+    // ends the running attempt, with an address from DHCP or the static one
+    void            connectAttempt(uint8_t channel = 6);
+    void            failAttempt();
+    // the access point goes away
+    void            dropConnection();
+    void            reset();
+
+private:
+    struct Handler {
+        WiFiEventFuncCb handler;
+        WiFiEvent_t     event;
+    };
+
+    static const uint8_t kMaxHandlers = 8;
+
+    Handler         m_handlers[kMaxHandlers];
+    uint8_t         m_handlerCount = 0;
+
+    wifi_mode_t     m_mode = WIFI_OFF;
+    bool            m_staEnabled = false;
+    bool            m_sleep = true;
+    bool            m_autoReconnect = true;
+    bool            m_persistent = true;
+    String          m_hostname;
+
+    wl_status_t     m_status = WL_IDLE_STATUS;
+    bool            m_attempting = false;
+    Attempt         m_attempt;
+    uint32_t        m_begins = 0;
+    uint32_t        m_disconnects = 0;
+
+    IPAddress       m_static;
+    IPAddress       m_staticGateway;
+    IPAddress       m_staticSubnet;
+    IPAddress       m_staticDns;
+
+    uint8_t         m_bssid[6] = {};
+    int32_t         m_channel = 0;
+    IPAddress       m_localIP;
+    IPAddress       m_gateway;
+    IPAddress       m_subnet;
+    IPAddress       m_dns;
+
+    void            emit(WiFiEvent_t event, uint8_t reason = 0);
+};
+
+extern WiFiClass WiFi;
+
+#endif
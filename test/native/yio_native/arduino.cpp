@@ -0,0 +1,190 @@
+#include <Arduino.h>
+#include <native.h>
+#include <chrono>
+#include <string>
+
+static uint64_t s_nowUs = 0;
+static uint32_t s_restarts = 0;
+
+void Native::advance(uint32_t ms)
+{
+    s_nowUs += static_cast<uint64_t>(ms) * 1000;
+}
+
+void Native::advanceMicros(uint64_t us)
+{
+    s_nowUs += us;
+}
+
+uint64_t Native::now()
+{
+    return s_nowUs;
+}
+
+uint32_t Native::restarts()
+{
+    return s_restarts;
+}
+
+uint32_t millis()
+{
+    return static_cast<uint32_t>(s_nowUs / 1000);
+}
+
+uint32_t micros()
+{
+    return static_cast<uint32_t>(s_nowUs);
+}
+
+void delay(uint32_t ms)
+{
+    Native::advance(ms);
+}
+
+void yield()
+{
+}
+
+int64_t esp_timer_get_time()
+{
+    return static_cast<int64_t>(s_nowUs);
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size)
+{
+    size_t length = strlen(src);
+    if (size > 0)
+    {
+        size_t copy = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = '\0';
+    }
+    return length;
+}
+#endif
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type)
+{
+    static const uint8_t kMac[6] = { 0x24, 0x6F, 0x28, 0x1A, 0x2B, 0x3C };
+    memcpy(mac, kMac, sizeof(kMac));
+    mac[5] += static_cast<uint8_t>(type);
+    return ESP_OK;
+}
+
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+// Serial
+
+static std::string s_serialInput;
+static size_t s_serialReadPosition = 0;
+static std::string s_serialOutput;
+
+HardwareSerial Serial;
+
+int HardwareSerial::available()
+{
+    return static_cast<int>(s_serialInput.size() - s_serialReadPosition);
+}
+
+int HardwareSerial::read()
+{
+    if (s_serialReadPosition >= s_serialInput.size())
+    {
+        return -1;
+    }
+    return static_cast<uint8_t>(s_serialInput[s_serialReadPosition++]);
+}
+
+int HardwareSerial::peek()
+{
+    if (s_serialReadPosition >= s_serialInput.size())
+    {
+        return -1;
+    }
+    return static_cast<uint8_t>(s_serialInput[s_serialReadPosition]);
+}
+
+size_t HardwareSerial::write(uint8_t byte)
+{
+    s_serialOutput.push_back(static_cast<char>(byte));
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    s_serialOutput.append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+}
+
+void HardwareSerial::feed(const void* data, size_t length)
+{
+    s_serialInput.append(static_cast<const char*>(data), length);
+}
+
+String HardwareSerial::output() const
+{
+    return String(s_serialOutput.data(), s_serialOutput.size());
+}
+
+void HardwareSerial::clearOutput()
+{
+    s_serialOutput.clear();
+}
+
+void HardwareSerial::clearInput()
+{
+    s_serialInput.clear();
+    s_serialReadPosition = 0;
+}
+
+size_t Print::printf(const char* format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (length < 0)
+    {
+        return 0;
+    }
+    if (static_cast<size_t>(length) >= sizeof(buffer))
+    {
+        length = sizeof(buffer) - 1;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buffer), length);
+}
+
+// ESP
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount()
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return static_cast<uint32_t>(ns * getCpuFreqMHz() / 1000);
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    int64_t used = Native::heap().inUse;
+    return used >= kHeapSize ? 0 : kHeapSize - static_cast<uint32_t>(used);
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+    int64_t peak = Native::heap().peak;
+    return peak >= kHeapSize ? 0 : kHeapSize - static_cast<uint32_t>(peak);
+}
+
+void EspClass::restart()
+{
+    s_restarts++;
+}
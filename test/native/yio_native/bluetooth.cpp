@@ -0,0 +1,121 @@
+#include <BluetoothSerial.h>
+#include <esp_bt.h>
+#include <native.h>
+
+BluetoothSerial* BluetoothSerial::s_instance = nullptr;
+static uint32_t s_btMemoryReleased = 0;
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode)
+{
+    (void)mode;
+    s_btMemoryReleased++;
+    return ESP_OK;
+}
+
+uint32_t Native::btMemoryReleased()
+{
+    return s_btMemoryReleased;
+}
+
+BluetoothSerial::BluetoothSerial()
+{
+    s_instance = this;
+}
+
+BluetoothSerial::~BluetoothSerial()
+{
+    if (s_instance == this)
+    {
+        s_instance = nullptr;
+    }
+}
+
+bool BluetoothSerial::begin(String localName, bool isMaster)
+{
+    (void)isMaster;
+    m_name = localName;
+    m_started = true;
+    event(ESP_SPP_INIT_EVT, nullptr);
+    return true;
+}
+
+void BluetoothSerial::end()
+{
+    m_started = false;
+}
+
+esp_err_t BluetoothSerial::register_callback(esp_spp_cb_t callback)
+{
+    m_callback = callback;
+    return ESP_OK;
+}
+
+int BluetoothSerial::available()
+{
+    return static_cast<int>(m_input.size() - m_readPosition);
+}
+
+int BluetoothSerial::read()
+{
+    if (m_readPosition >= m_input.size())
+    {
+        return -1;
+    }
+    return static_cast<uint8_t>(m_input[m_readPosition++]);
+}
+
+size_t BluetoothSerial::readBytes(uint8_t* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length && m_readPosition < m_input.size())
+    {
+        buffer[count++] = static_cast<uint8_t>(m_input[m_readPosition++]);
+    }
+    if (m_readPosition == m_input.size())
+    {
+        m_input.clear();
+        m_readPosition = 0;
+    }
+    return count;
+}
+
+size_t BluetoothSerial::write(uint8_t byte)
+{
+    return write(&byte, 1);
+}
+
+size_t BluetoothSerial::write(const uint8_t* buffer, size_t size)
+{
+    m_writes++;
+    m_output.append(reinterpret_cast<const char*>(buffer), size);
+    return size;
+}
+
+void BluetoothSerial::connect()
+{
+    event(ESP_SPP_SRV_OPEN_EVT, nullptr);
+}
+
+void BluetoothSerial::receive(const void* data, size_t length)
+{
+    m_input.append(static_cast<const char*>(data), length);
+
+    esp_spp_cb_param_t param;
+    param.data_ind.handle = 1;
+    param.data_ind.len = static_cast<uint16_t>(length);
+    param.data_ind.data = reinterpret_cast<uint8_t*>(const_cast<void*>(data));
+    event(ESP_SPP_DATA_IND_EVT, &param);
+}
+
+void BluetoothSerial::disconnect()
+{
+    event(ESP_SPP_CLOSE_EVT, nullptr);
+}
+
+void BluetoothSerial::event(esp_spp_cb_event_t event, esp_spp_cb_param_t* param)
+{
+    if (m_callback)
+    {
+        m_callback(event, param);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef ESP_BT_H
+#define ESP_BT_H
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_BT_MODE_IDLE        = 0,
+    ESP_BT_MODE_BLE         = 1,
+    ESP_BT_MODE_CLASSIC_BT  = 2,
+    ESP_BT_MODE_BTDM        = 3
+} esp_bt_mode_t;
+
+// counted, see Native::btMemoryReleased()
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+
+#endif
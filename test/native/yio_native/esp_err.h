@@ -0,0 +1,12 @@
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK          0
+#define ESP_FAIL        -1
+#define ESP_ERR_NO_MEM  0x101
+
+#endif
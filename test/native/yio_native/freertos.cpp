@@ -0,0 +1,230 @@
+#include <Arduino.h>
+#include <native.h>
+#include <freertos/event_groups.h>
+#include <freertos/timers.h>
+#include <vector>
+
+struct NativeTask {
+    TaskFunction_t      function;
+    void*               parameter;
+    uint32_t            stackDepth;
+    char                name[16];
+};
+
+static NativeTask s_loopTask = { nullptr, nullptr, 8192, "loopTask" };
+
+struct NativeQueue {
+    std::vector<uint8_t> items;
+    UBaseType_t         length;
+    UBaseType_t         itemSize;
+    UBaseType_t         head;
+    UBaseType_t         count;
+};
+
+struct NativeEventGroup {
+    EventBits_t         bits;
+};
+
+struct NativeTimer {
+    TimerCallbackFunction_t callback;
+    void*               id;
+    TickType_t          period;
+};
+
+BaseType_t xPortGetCoreID()
+{
+    return 1;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameter, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+    (void)priority;
+    (void)core;
+    NativeTask* task = new NativeTask{ function, parameter, stackDepth, {} };
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    if (handle != nullptr)
+    {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameter, UBaseType_t priority, TaskHandle_t* handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, handle, 0);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    delete task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    Native::advance(ticks * portTICK_PERIOD_MS);
+}
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment)
+{
+    *previousWake += increment;
+    TickType_t now = xTaskGetTickCount();
+    if (static_cast<int32_t>(*previousWake - now) > 0)
+    {
+        vTaskDelay(*previousWake - now);
+    }
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return static_cast<TickType_t>(millis() / portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait)
+{
+    (void)clearOnExit;
+    (void)wait;
+    return 0;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return task != nullptr ? task->stackDepth : 0;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return &s_loopTask;
+}
+
+char* pcTaskGetName(TaskHandle_t task)
+{
+    return (task != nullptr ? task : &s_loopTask)->name;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    NativeQueue* queue = new NativeQueue();
+    queue->items.resize(static_cast<size_t>(length) * itemSize);
+    queue->length = length;
+    queue->itemSize = itemSize;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait)
+{
+    (void)wait;
+    if (queue->count == queue->length)
+    {
+        return errQUEUE_FULL;
+    }
+    UBaseType_t slot = (queue->head + queue->count) % queue->length;
+    memcpy(&queue->items[static_cast<size_t>(slot) * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait)
+{
+    (void)wait;
+    if (queue->count == 0)
+    {
+        return pdFALSE;
+    }
+    memcpy(item, &queue->items[static_cast<size_t>(queue->head) * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return queue->count;
+}
+
+EventGroupHandle_t xEventGroupCreate()
+{
+    return new NativeEventGroup{ 0 };
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    group->bits |= bits;
+    return group->bits;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t* woken)
+{
+    xEventGroupSetBits(group, bits);
+    if (woken != nullptr)
+    {
+        *woken = pdFALSE;
+    }
+    return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t wait)
+{
+    EventBits_t current = group->bits;
+    bool satisfied = waitForAll ? (current & bits) == bits : (current & bits) != 0;
+    if (!satisfied)
+    {
+        if (wait != portMAX_DELAY)
+        {
+            vTaskDelay(wait);
+        }
+        return current;
+    }
+    if (clearOnExit)
+    {
+        group->bits &= ~bits;
+    }
+    return current;
+}
+
+TimerHandle_t xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id,
+                           TimerCallbackFunction_t callback)
+{
+    (void)name;
+    (void)autoReload;
+    return new NativeTimer{ callback, id, period };
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait)
+{
+    (void)timer;
+    (void)wait;
+    return pdPASS;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t timer)
+{
+    return timer->id;
+}
@@ -0,0 +1,34 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+
+// Single threaded stand-ins: tasks are registered but never run, queues and event groups
+// hold real data, and a wait that can't be satisfied returns at once instead of blocking.
+
+typedef uint32_t        TickType_t;
+typedef int             BaseType_t;
+typedef unsigned int    UBaseType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define errQUEUE_FULL           0
+#define portMAX_DELAY           0xFFFFFFFFUL
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       (static_cast<TickType_t>(ms) / portTICK_PERIOD_MS)
+#define tskIDLE_PRIORITY        0
+
+typedef struct {
+    int                 count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         ((mux)->count++)
+#define portEXIT_CRITICAL(mux)          ((mux)->count--)
+#define portYIELD_FROM_ISR()            do {} while (0)
+
+BaseType_t xPortGetCoreID();
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FREERTOS_EVENT_GROUPS_H
+#define FREERTOS_EVENT_GROUPS_H
+
+#include "FreeRTOS.h"
+
+struct NativeEventGroup;
+typedef NativeEventGroup*   EventGroupHandle_t;
+typedef uint32_t            EventBits_t;
+
+EventGroupHandle_t  xEventGroupCreate();
+EventBits_t         xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+BaseType_t          xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t* woken);
+EventBits_t         xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t         xEventGroupGetBits(EventGroupHandle_t group);
+// returns the bits as they are, moves the clock by the timeout when none of them is set
+EventBits_t         xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                        BaseType_t waitForAll, TickType_t wait);
+
+#endif
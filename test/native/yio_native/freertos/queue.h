@@ -0,0 +1,18 @@
+#ifndef FREERTOS_QUEUE_H
+#define FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+
+struct NativeQueue;
+typedef NativeQueue*    QueueHandle_t;
+
+QueueHandle_t   xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void            vQueueDelete(QueueHandle_t queue);
+// a full or empty queue fails right away, whatever the wait
+BaseType_t      xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t      xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+UBaseType_t     uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#define xQueueSendToBack xQueueSend
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+struct NativeTask;
+typedef NativeTask*     TaskHandle_t;
+typedef void            (*TaskFunction_t)(void* parameter);
+
+// the task is created but never started, tests call what its loop would
+BaseType_t      xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                        void* parameter, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+BaseType_t      xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                            void* parameter, UBaseType_t priority, TaskHandle_t* handle);
+void            vTaskDelete(TaskHandle_t task);
+
+// both move the virtual clock
+void            vTaskDelay(TickType_t ticks);
+void            vTaskDelayUntil(TickType_t* previousWake, TickType_t increment);
+TickType_t      xTaskGetTickCount();
+
+BaseType_t      xTaskNotifyGive(TaskHandle_t task);
+// no task runs, so there is nothing to take, returns 0 at once
+uint32_t        ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait);
+UBaseType_t     uxTaskGetStackHighWaterMark(TaskHandle_t task);
+// the test runs as the Arduino loop task
+TaskHandle_t    xTaskGetCurrentTaskHandle();
+char*           pcTaskGetName(TaskHandle_t task);
+
+#endif
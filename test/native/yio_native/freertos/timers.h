@@ -0,0 +1,16 @@
+#ifndef FREERTOS_TIMERS_H
+#define FREERTOS_TIMERS_H
+
+#include "FreeRTOS.h"
+
+struct NativeTimer;
+typedef NativeTimer*    TimerHandle_t;
+typedef void            (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+// timers are kept but never fire, tests post the events themselves
+TimerHandle_t   xTimerCreate(const char* name, TickType_t period, UBaseType_t autoReload, void* id,
+                             TimerCallbackFunction_t callback);
+BaseType_t      xTimerStart(TimerHandle_t timer, TickType_t wait);
+void*           pvTimerGetTimerID(TimerHandle_t timer);
+
+#endif
@@ -0,0 +1,151 @@
+#include <FS.h>
+#include <SPIFFS.h>
+#include <algorithm>
+
+namespace fs {
+
+struct NativeFileData {
+    std::vector<uint8_t> bytes;
+};
+
+size_t File::write(const uint8_t* buffer, size_t size)
+{
+    if (!m_data || !m_writable)
+    {
+        return 0;
+    }
+    size = SPIFFS.takeWriteBudget(size);
+    if (m_position + size > m_data->bytes.size())
+    {
+        m_data->bytes.resize(m_position + size);
+    }
+    memcpy(&m_data->bytes[m_position], buffer, size);
+    m_position += size;
+    return size;
+}
+
+size_t File::read(uint8_t* buffer, size_t size)
+{
+    if (!m_data || m_position >= m_data->bytes.size())
+    {
+        return 0;
+    }
+    size = std::min(size, m_data->bytes.size() - m_position);
+    memcpy(buffer, &m_data->bytes[m_position], size);
+    m_position += size;
+    return size;
+}
+
+int File::read()
+{
+    uint8_t byte;
+    return read(&byte, 1) == 1 ? byte : -1;
+}
+
+bool File::seek(uint32_t position)
+{
+    if (!m_data || position > m_data->bytes.size())
+    {
+        return false;
+    }
+    m_position = position;
+    return true;
+}
+
+size_t File::size() const
+{
+    return m_data ? m_data->bytes.size() : 0;
+}
+
+bool FS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles)
+{
+    (void)formatOnFail;
+    (void)basePath;
+    (void)maxOpenFiles;
+    m_mounted = true;
+    return true;
+}
+
+File FS::open(const char* path, const char* mode)
+{
+    if (!m_mounted)
+    {
+        return File();
+    }
+    auto it = m_files.find(path);
+    if (strcmp(mode, FILE_READ) == 0)
+    {
+        return it != m_files.end() ? File(it->second, false, 0) : File();
+    }
+
+    // a new file for "w", so readers of the old one keep their data
+    if (it == m_files.end() || strcmp(mode, FILE_WRITE) == 0)
+    {
+        auto data = std::make_shared<NativeFileData>();
+        m_files[path] = data;
+        return File(data, true, 0);
+    }
+    return File(it->second, true, it->second->bytes.size());
+}
+
+bool FS::exists(const char* path)
+{
+    return m_mounted && m_files.count(path) != 0;
+}
+
+bool FS::remove(const char* path)
+{
+    return m_mounted && m_files.erase(path) != 0;
+}
+
+bool FS::rename(const char* from, const char* to)
+{
+    if (!m_mounted || m_failRenames || m_files.count(to) != 0)
+    {
+        return false;
+    }
+    auto it = m_files.find(from);
+    if (it == m_files.end())
+    {
+        return false;
+    }
+    m_files[to] = it->second;
+    m_files.erase(it);
+    return true;
+}
+
+void FS::reset()
+{
+    m_files.clear();
+    m_mounted = false;
+    m_writeBudget = -1;
+    m_failRenames = false;
+}
+
+std::vector<uint8_t> FS::contents(const char* path)
+{
+    auto it = m_files.find(path);
+    return it != m_files.end() ? it->second->bytes : std::vector<uint8_t>();
+}
+
+void FS::setContents(const char* path, const std::vector<uint8_t>& data)
+{
+    auto file = std::make_shared<NativeFileData>();
+    file->bytes = data;
+    m_files[path] = file;
+}
+
+size_t FS::takeWriteBudget(size_t size)
+{
+    if (m_writeBudget < 0)
+    {
+        return size;
+    }
+    size_t taken = std::min(size, static_cast<size_t>(m_writeBudget));
+    m_writeBudget -= taken;
+    return taken;
+}
+
+}
+
+fs::FS SPIFFS;
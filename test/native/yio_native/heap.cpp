@@ -0,0 +1,135 @@
+// Counts every allocation of the test binary. malloc, calloc and realloc are wrapped with
+// -Wl,--wrap (see env:native), new and delete are routed through them.
+
+#include <native.h>
+#include <malloc.h>
+#include <new>
+
+extern "C" {
+void*   __real_malloc(size_t size);
+void*   __real_calloc(size_t count, size_t size);
+void*   __real_realloc(void* pointer, size_t size);
+void    __real_free(void* pointer);
+}
+
+static uint32_t s_allocations = 0;
+static int64_t  s_inUse = 0;
+static int64_t  s_peak = 0;
+
+static void added(void* pointer)
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+    s_inUse += malloc_usable_size(pointer);
+    if (s_inUse > s_peak)
+    {
+        s_peak = s_inUse;
+    }
+}
+
+static void removed(void* pointer)
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+    // blocks from before the counting started aren't known, don't go below zero
+    s_inUse -= malloc_usable_size(pointer);
+    if (s_inUse < 0)
+    {
+        s_inUse = 0;
+    }
+}
+
+extern "C" {
+
+void* __wrap_malloc(size_t size)
+{
+    s_allocations++;
+    void* pointer = __real_malloc(size);
+    added(pointer);
+    return pointer;
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    s_allocations++;
+    void* pointer = __real_calloc(count, size);
+    added(pointer);
+    return pointer;
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    s_allocations++;
+    removed(pointer);
+    void* result = __real_realloc(pointer, size);
+    // a failed realloc leaves the old block alone
+    added(result != nullptr || size == 0 ? result : pointer);
+    return result;
+}
+
+void __wrap_free(void* pointer)
+{
+    removed(pointer);
+    __real_free(pointer);
+}
+
+}
+
+void* operator new(size_t size)
+{
+    void* pointer = malloc(size != 0 ? size : 1);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+Native::Heap Native::heap()
+{
+    return Heap{ s_allocations, s_inUse, s_peak };
+}
+
+void Native::resetPeak()
+{
+    s_peak = s_inUse;
+}
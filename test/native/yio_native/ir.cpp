@@ -0,0 +1,129 @@
+#include <IRrecv.h>
+#include <IRsend.h>
+#include <IRutils.h>
+
+IRsend::Stats IRsend::s_stats = IRsend::Stats();
+
+IRrecv::IRrecv(uint16_t recvPin, uint16_t bufferSize, uint8_t timeout, bool saveBuffer)
+    : m_bufferSize(bufferSize)
+{
+    (void)recvPin;
+    (void)timeout;
+    (void)saveBuffer;
+    m_rawbuf = new uint16_t[bufferSize];
+}
+
+IRrecv::~IRrecv()
+{
+    delete[] m_rawbuf;
+}
+
+bool IRrecv::decode(decode_results* results)
+{
+    if (!m_enabled || !m_pending)
+    {
+        return false;
+    }
+    m_pending = false;
+    *results = m_pendingResults;
+    results->rawbuf = m_rawbuf;
+    return true;
+}
+
+void IRrecv::inject(const decode_results& results, const uint16_t* timings, uint16_t count)
+{
+    m_pendingResults = results;
+    // rawbuf[0] is the gap before the code, the timings follow in kRawTick units
+    uint16_t length = count + 1 < m_bufferSize ? count + 1 : m_bufferSize;
+    m_rawbuf[0] = 0;
+    for (uint16_t i = 1; i < length; i++)
+    {
+        m_rawbuf[i] = timings[i - 1] / kRawTick;
+    }
+    m_pendingResults.rawlen = length;
+    m_pendingResults.overflow = count + 1 > m_bufferSize;
+    m_pending = true;
+}
+
+bool IRsend::send(const decode_type_t type, const uint64_t data, const uint16_t nbits, const uint16_t repeat)
+{
+    if (type <= UNUSED || type == PRONTO)
+    {
+        return false;
+    }
+    s_stats.sends++;
+    s_stats.lastProtocol = type;
+    s_stats.lastValue = data;
+    s_stats.lastBits = nbits;
+    s_stats.lastRepeat = repeat;
+    return true;
+}
+
+void IRsend::sendPronto(uint16_t data[], uint16_t length, uint16_t repeat)
+{
+    // the frequency word and the two sequence lengths come first
+    if (length < 6)
+    {
+        return;
+    }
+    s_stats.prontoSends++;
+    s_stats.lastProtocol = PRONTO;
+    s_stats.lastRepeat = repeat;
+    s_stats.lastFrequency = data[1] != 0 ? static_cast<uint16_t>(1000000 / (data[1] * 0.241246)) : 0;
+    uint16_t once = data[2] * 2;
+    uint16_t again = data[3] * 2;
+    s_stats.timings += once + again * repeat;
+}
+
+void IRsend::sendRaw(const uint16_t buffer[], const uint16_t length, const uint16_t hz)
+{
+    (void)buffer;
+    s_stats.rawSends++;
+    s_stats.lastFrequency = hz;
+    s_stats.timings += length;
+}
+
+String uint64ToString(uint64_t input, uint8_t base)
+{
+    if (base < 2 || base > 36)
+    {
+        base = 10;
+    }
+    char buffer[65];
+    char* end = buffer + sizeof(buffer) - 1;
+    char* start = end;
+    *end = '\0';
+    do
+    {
+        unsigned digit = input % base;
+        *--start = static_cast<char>(digit < 10 ? '0' + digit : 'A' + digit - 10);
+        input /= base;
+    } while (input > 0);
+    return String(start);
+}
+
+bool hasACState(const decode_type_t protocol)
+{
+    switch (protocol)
+    {
+        case DAIKIN:
+        case KELVINATOR:
+        case MITSUBISHI_AC:
+        case GREE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+String resultToHumanReadableBasic(const decode_results* const results)
+{
+    String output("Protocol  : ");
+    output += String(static_cast<int>(results->decode_type));
+    output += "\nCode      : 0x";
+    output += uint64ToString(results->value, 16);
+    output += " (";
+    output += String(static_cast<unsigned int>(results->bits));
+    output += " Bits)\n";
+    return output;
+}
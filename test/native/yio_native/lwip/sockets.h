@@ -0,0 +1,13 @@
+#ifndef LWIP_SOCKETS_H
+#define LWIP_SOCKETS_H
+
+#include <sys/select.h>
+#include <sys/time.h>
+
+// what select() guarantees a writable socket takes, lwIP marks a socket writable once more
+// than TCP_SNDLOWAT bytes of its send buffer are free (the ESP32 default)
+#ifndef TCP_SNDLOWAT
+#define TCP_SNDLOWAT 2873
+#endif
+
+#endif
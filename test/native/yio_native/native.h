@@ -0,0 +1,53 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+// Test side of the native shims: the virtual clock, heap figures and a benchmark helper.
+
+#include <Arduino.h>
+#include <chrono>
+
+namespace Native {
+
+// moves millis(), micros() and the tick count
+void        advance(uint32_t ms);
+void        advanceMicros(uint64_t us);
+uint64_t    now();
+
+struct Heap {
+    uint32_t    allocations;        // malloc, calloc, realloc and new since start
+    int64_t     inUse;              // bytes
+    int64_t     peak;               // bytes, since resetPeak()
+};
+
+Heap        heap();
+// starts a new peak from what is in use now
+void        resetPeak();
+
+uint32_t    restarts();
+uint32_t    btMemoryReleased();
+
+// runs body iterations times and prints ns/op, allocations/op and the peak heap above
+// what was in use before, in the profiler's format
+template<typename F>
+void bench(const char* name, uint32_t iterations, F body)
+{
+    body();     // warm up, first calls may allocate once
+    Heap before = heap();
+    resetPeak();
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        body();
+    }
+    auto end = std::chrono::steady_clock::now();
+    Heap after = heap();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    double allocs = static_cast<double>(after.allocations - before.allocations) / iterations;
+    printf("[BENCH] %-28s %10.1f ns/op %8.2f allocs/op %8lld peak bytes\n", name, ns, allocs,
+           static_cast<long long>(after.peak - before.inUse));
+}
+
+}
+
+#endif
@@ -0,0 +1,137 @@
+#include <Preferences.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <map>
+#include <string>
+
+// namespace -> key -> value, integers are kept as their decimal text
+static std::map<std::string, std::map<std::string, std::string>> s_store;
+static std::map<nvs_handle, std::string> s_handles;
+static nvs_handle s_nextHandle = 1;
+
+esp_err_t nvs_flash_init()
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase()
+{
+    s_store.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode mode, nvs_handle* handle)
+{
+    if (mode == NVS_READONLY && s_store.find(name) == s_store.end())
+    {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *handle = s_nextHandle++;
+    s_handles[*handle] = name;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle handle, const char* key, int32_t value)
+{
+    auto it = s_handles.find(handle);
+    if (it == s_handles.end())
+    {
+        return ESP_FAIL;
+    }
+    s_store[it->second][key] = std::to_string(value);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle handle, const char* key, const char* value)
+{
+    auto it = s_handles.find(handle);
+    if (it == s_handles.end())
+    {
+        return ESP_FAIL;
+    }
+    s_store[it->second][key] = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle handle)
+{
+    return s_handles.count(handle) != 0 ? ESP_OK : ESP_FAIL;
+}
+
+void nvs_close(nvs_handle handle)
+{
+    s_handles.erase(handle);
+}
+
+bool Preferences::begin(const char* name, bool readOnly)
+{
+    if (readOnly && s_store.find(name) == s_store.end())
+    {
+        return false;
+    }
+    m_namespace = name;
+    m_readOnly = readOnly;
+    m_open = true;
+    if (!readOnly)
+    {
+        s_store[name];
+    }
+    return true;
+}
+
+void Preferences::end()
+{
+    m_open = false;
+}
+
+bool Preferences::clear()
+{
+    if (!m_open || m_readOnly)
+    {
+        return false;
+    }
+    s_store[m_namespace.c_str()].clear();
+    return true;
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue)
+{
+    if (!m_open)
+    {
+        return defaultValue;
+    }
+    auto& values = s_store[m_namespace.c_str()];
+    auto it = values.find(key);
+    return it != values.end() ? static_cast<int32_t>(strtol(it->second.c_str(), nullptr, 10)) : defaultValue;
+}
+
+size_t Preferences::putInt(const char* key, int32_t value)
+{
+    if (!m_open || m_readOnly)
+    {
+        return 0;
+    }
+    s_store[m_namespace.c_str()][key] = std::to_string(value);
+    return sizeof(value);
+}
+
+String Preferences::getString(const char* key, const String& defaultValue)
+{
+    if (!m_open)
+    {
+        return defaultValue;
+    }
+    auto& values = s_store[m_namespace.c_str()];
+    auto it = values.find(key);
+    return it != values.end() ? String(it->second.c_str()) : defaultValue;
+}
+
+size_t Preferences::putString(const char* key, const char* value)
+{
+    if (!m_open || m_readOnly)
+    {
+        return 0;
+    }
+    s_store[m_namespace.c_str()][key] = value;
+    return strlen(value);
+}
@@ -0,0 +1,25 @@
+#ifndef NVS_H
+#define NVS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// the same in-memory store Preferences uses, lost when the process ends
+
+typedef uint32_t nvs_handle;
+typedef nvs_handle nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode;
+
+#define ESP_ERR_NVS_NOT_FOUND   0x1102
+
+esp_err_t   nvs_open(const char* name, nvs_open_mode mode, nvs_handle* handle);
+esp_err_t   nvs_set_i32(nvs_handle handle, const char* key, int32_t value);
+esp_err_t   nvs_set_str(nvs_handle handle, const char* key, const char* value);
+esp_err_t   nvs_commit(nvs_handle handle);
+void        nvs_close(nvs_handle handle);
+
+#endif
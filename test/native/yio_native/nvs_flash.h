@@ -0,0 +1,10 @@
+#ifndef NVS_FLASH_H
+#define NVS_FLASH_H
+
+#include "esp_err.h"
+
+esp_err_t   nvs_flash_init();
+// forgets every namespace
+esp_err_t   nvs_flash_erase();
+
+#endif
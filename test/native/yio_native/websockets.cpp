@@ -0,0 +1,187 @@
+#include <WebSocketsServer.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+WebSocketsServer* WebSocketsServer::s_instance = nullptr;
+
+WebSocketsServer::WebSocketsServer(uint16_t port, const String& origin, const String& protocol)
+{
+    (void)port;
+    (void)origin;
+    (void)protocol;
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+    {
+        _clients[i].num = i;
+        _clients[i].status = WSC_NOT_CONNECTED;
+        _clients[i].tcp = nullptr;
+    }
+    s_instance = this;
+}
+
+WebSocketsServer::~WebSocketsServer()
+{
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+    {
+        if (m_tcp[i].m_fd >= 0)
+        {
+            close(m_tcp[i].m_fd);
+        }
+    }
+    if (s_instance == this)
+    {
+        s_instance = nullptr;
+    }
+}
+
+void WebSocketsServer::begin()
+{
+}
+
+bool WebSocketsServer::sendTXT(uint8_t num, const char* payload, size_t length)
+{
+    if (length == 0)
+    {
+        length = strlen(payload);
+    }
+    return sendTXT(num, reinterpret_cast<const uint8_t*>(payload), length);
+}
+
+bool WebSocketsServer::sendTXT(uint8_t num, const uint8_t* payload, size_t length)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !isConnected(num))
+    {
+        return false;
+    }
+    return sendFrame(&_clients[num], WSop_text, const_cast<uint8_t*>(payload), length);
+}
+
+bool WebSocketsServer::sendBIN(uint8_t num, const uint8_t* payload, size_t length)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !isConnected(num))
+    {
+        return false;
+    }
+    return sendFrame(&_clients[num], WSop_binary, const_cast<uint8_t*>(payload), length);
+}
+
+bool WebSocketsServer::sendFrame(WSclient_t* client, WSopcode_t opcode, uint8_t* payload, size_t length,
+                                 bool fin, bool headerToPayload)
+{
+    (void)headerToPayload;
+    if (client == nullptr || client->status != WSC_CONNECTED)
+    {
+        return false;
+    }
+    m_frameCount[client->num]++;
+    if (m_capture)
+    {
+        m_frames[client->num].push_back(Frame{ opcode, fin, std::string(reinterpret_cast<char*>(payload), length) });
+    }
+    if (m_stallAfter[client->num] > 0 && --m_stallAfter[client->num] == 0)
+    {
+        stall(client->num, true);
+    }
+    return true;
+}
+
+void WebSocketsServer::disconnect(uint8_t num)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || _clients[num].status == WSC_NOT_CONNECTED)
+    {
+        return;
+    }
+    _clients[num].status = WSC_NOT_CONNECTED;
+    _clients[num].tcp = nullptr;
+    runEvent(num, WStype_DISCONNECTED, nullptr, 0);
+}
+
+IPAddress WebSocketsServer::remoteIP(uint8_t num)
+{
+    return IPAddress(192, 168, 1, 100 + num);
+}
+
+void WebSocketsServer::connectClient(uint8_t num)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        return;
+    }
+    if (m_tcp[num].m_fd < 0)
+    {
+        m_tcp[num].m_fd = open("/dev/null", O_WRONLY);
+    }
+    m_stalled[num] = false;
+    m_stallAfter[num] = 0;
+    _clients[num].status = WSC_CONNECTED;
+    _clients[num].tcp = &m_tcp[num];
+
+    char url[] = "/";
+    runEvent(num, WStype_CONNECTED, reinterpret_cast<uint8_t*>(url), 1);
+}
+
+void WebSocketsServer::receive(uint8_t num, WStype_t type, const void* data, size_t length)
+{
+    m_receiveBuffer.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + length);
+    m_receiveBuffer.push_back('\0');
+    runEvent(num, type, m_receiveBuffer.data(), length);
+}
+
+void WebSocketsServer::stall(uint8_t num, bool stalled)
+{
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || m_stalled[num] == stalled)
+    {
+        return;
+    }
+    m_stalled[num] = stalled;
+    if (stalled)
+    {
+        if (m_tcp[num].m_fd >= 0)
+        {
+            close(m_tcp[num].m_fd);
+        }
+        m_tcp[num].m_fd = -1;
+    } else {
+        m_tcp[num].m_fd = open("/dev/null", O_WRONLY);
+    }
+}
+
+void WebSocketsServer::stallAfter(uint8_t num, uint32_t frames)
+{
+    if (num < WEBSOCKETS_SERVER_CLIENT_MAX)
+    {
+        m_stallAfter[num] = frames;
+    }
+}
+
+std::vector<std::string> WebSocketsServer::messages(uint8_t num)
+{
+    std::vector<std::string> result;
+    std::string message;
+    for (const Frame& frame : m_frames[num])
+    {
+        message += frame.payload;
+        if (frame.fin)
+        {
+            result.push_back(message);
+            message.clear();
+        }
+    }
+    return result;
+}
+
+void WebSocketsServer::clearFrames()
+{
+    for (uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++)
+    {
+        m_frames[i].clear();
+        m_frameCount[i] = 0;
+    }
+}
+
+void WebSocketsServer::runEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
+{
+    if (m_event)
+    {
+        m_event(num, type, payload, length);
+    }
+}
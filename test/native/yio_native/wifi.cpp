@@ -0,0 +1,135 @@
+#include <WiFi.h>
+#include <ESPmDNS.h>
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+int WiFiClass::onEvent(WiFiEventCb handler, WiFiEvent_t event)
+{
+    return onEvent(WiFiEventFuncCb([handler](WiFiEvent_t event, WiFiEventInfo_t) { handler(event); }), event);
+}
+
+int WiFiClass::onEvent(WiFiEventFuncCb handler, WiFiEvent_t event)
+{
+    if (m_handlerCount == kMaxHandlers)
+    {
+        return 0;
+    }
+    m_handlers[m_handlerCount].handler = handler;
+    m_handlers[m_handlerCount].event = event;
+    return ++m_handlerCount;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2)
+{
+    (void)dns2;
+    bool wasStatic = m_static != IPAddress();
+    m_static = local;
+    m_staticGateway = gateway;
+    m_staticSubnet = subnet;
+    m_staticDns = dns1;
+
+    // back to DHCP on a live connection, the lease comes in with a new got-IP event
+    if (m_status == WL_CONNECTED && wasStatic && local == IPAddress())
+    {
+        m_localIP = IPAddress(192, 168, 1, 50);
+        emit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+    return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* password, int32_t channel, const uint8_t* bssid, bool connect)
+{
+    (void)password;
+    if (m_status == WL_CONNECTED || m_attempting)
+    {
+        disconnect();
+    }
+
+    m_begins++;
+    m_attempt.ssid = ssid;
+    m_attempt.channel = channel;
+    m_attempt.bssid = bssid != nullptr;
+    m_attempt.staticIP = m_static != IPAddress();
+    m_attempting = connect;
+    m_status = WL_DISCONNECTED;
+    return m_status;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp)
+{
+    (void)wifiOff;
+    (void)eraseAp;
+    m_disconnects++;
+    if (m_status == WL_CONNECTED || m_attempting)
+    {
+        m_attempting = false;
+        m_status = WL_DISCONNECTED;
+        m_localIP = IPAddress();
+        emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_ASSOC_LEAVE);
+    }
+    return true;
+}
+
+void WiFiClass::connectAttempt(uint8_t channel)
+{
+    if (!m_attempting)
+    {
+        return;
+    }
+    m_attempting = false;
+    m_status = WL_CONNECTED;
+    m_channel = channel;
+    const uint8_t bssid[6] = { 0x60, 0x31, 0x97, 0x11, 0x22, channel };
+    memcpy(m_bssid, bssid, sizeof(m_bssid));
+
+    bool isStatic = m_static != IPAddress();
+    m_localIP = isStatic ? m_static : IPAddress(192, 168, 1, 50);
+    m_gateway = isStatic ? m_staticGateway : IPAddress(192, 168, 1, 1);
+    m_subnet = isStatic ? m_staticSubnet : IPAddress(255, 255, 255, 0);
+    m_dns = isStatic ? m_staticDns : IPAddress(192, 168, 1, 1);
+
+    emit(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+    emit(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+}
+
+void WiFiClass::failAttempt()
+{
+    if (!m_attempting)
+    {
+        return;
+    }
+    m_attempting = false;
+    m_status = WL_NO_SSID_AVAIL;
+    emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_NO_AP_FOUND);
+}
+
+void WiFiClass::dropConnection()
+{
+    if (m_status != WL_CONNECTED)
+    {
+        return;
+    }
+    m_status = WL_CONNECTION_LOST;
+    m_localIP = IPAddress();
+    emit(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, WIFI_REASON_BEACON_TIMEOUT);
+}
+
+void WiFiClass::reset()
+{
+    *this = WiFiClass();
+}
+
+void WiFiClass::emit(WiFiEvent_t event, uint8_t reason)
+{
+    WiFiEventInfo_t info;
+    memset(&info, 0, sizeof(info));
+    info.wifi_sta_disconnected.reason = reason;
+    for (uint8_t i = 0; i < m_handlerCount; i++)
+    {
+        if (m_handlers[i].event == ARDUINO_EVENT_MAX || m_handlers[i].event == event)
+        {
+            m_handlers[i].handler(event, info);
+        }
+    }
+}
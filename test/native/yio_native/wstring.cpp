@@ -0,0 +1,215 @@
+#include <WString.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <utility>
+
+String::String(const char* text)
+{
+    if (text != nullptr)
+    {
+        assign(text, strlen(text));
+    }
+}
+
+String::String(const char* text, size_t length)
+{
+    assign(text, length);
+}
+
+String::String(const String& other)
+{
+    assign(other.c_str(), other.m_length);
+}
+
+String::String(String&& other) noexcept
+    : m_buffer(other.m_buffer), m_capacity(other.m_capacity), m_length(other.m_length)
+{
+    other.m_buffer = nullptr;
+    other.m_capacity = 0;
+    other.m_length = 0;
+}
+
+String::String(char c)
+{
+    assign(&c, 1);
+}
+
+static void formatNumber(char* buffer, unsigned long long value, bool negative, unsigned char base)
+{
+    char digits[72];
+    size_t count = 0;
+    do
+    {
+        unsigned digit = value % base;
+        digits[count++] = static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value > 0);
+
+    size_t i = 0;
+    if (negative)
+    {
+        buffer[i++] = '-';
+    }
+    while (count > 0)
+    {
+        buffer[i++] = digits[--count];
+    }
+    buffer[i] = '\0';
+}
+
+String::String(int value, unsigned char base) : String(static_cast<long>(value), base)
+{
+}
+
+String::String(unsigned int value, unsigned char base) : String(static_cast<unsigned long>(value), base)
+{
+}
+
+String::String(long value, unsigned char base)
+{
+    char buffer[72];
+    bool negative = value < 0 && base == 10;
+    unsigned long long magnitude = negative ? 0ULL - static_cast<unsigned long long>(value)
+                                            : static_cast<unsigned long>(value);
+    formatNumber(buffer, magnitude, negative, base);
+    assign(buffer, strlen(buffer));
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+    char buffer[72];
+    formatNumber(buffer, value, false, base);
+    assign(buffer, strlen(buffer));
+}
+
+String::~String()
+{
+    free(m_buffer);
+}
+
+String& String::operator=(const String& other)
+{
+    if (this != &other)
+    {
+        assign(other.c_str(), other.m_length);
+    }
+    return *this;
+}
+
+String& String::operator=(String&& other) noexcept
+{
+    if (this != &other)
+    {
+        free(m_buffer);
+        m_buffer = other.m_buffer;
+        m_capacity = other.m_capacity;
+        m_length = other.m_length;
+        other.m_buffer = nullptr;
+        other.m_capacity = 0;
+        other.m_length = 0;
+    }
+    return *this;
+}
+
+String& String::operator=(const char* text)
+{
+    assign(text != nullptr ? text : "", text != nullptr ? strlen(text) : 0);
+    return *this;
+}
+
+bool String::reserve(size_t size)
+{
+    if (m_buffer != nullptr && m_capacity >= size)
+    {
+        return true;
+    }
+    char* buffer = static_cast<char*>(realloc(m_buffer, size + 1));
+    if (buffer == nullptr)
+    {
+        return false;
+    }
+    if (m_buffer == nullptr)
+    {
+        buffer[0] = '\0';
+    }
+    m_buffer = buffer;
+    m_capacity = size;
+    return true;
+}
+
+bool String::concat(const char* text, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+    if (!reserve(m_length + length))
+    {
+        return false;
+    }
+    // text may point into this string
+    memmove(m_buffer + m_length, text, length);
+    m_length += length;
+    m_buffer[m_length] = '\0';
+    return true;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    if (from >= m_length)
+    {
+        return -1;
+    }
+    const char* found = static_cast<const char*>(memchr(m_buffer + from, c, m_length - from));
+    return found != nullptr ? static_cast<int>(found - m_buffer) : -1;
+}
+
+// like the core: the bounds are swapped when reversed and clipped to the length
+String String::substring(unsigned int left, unsigned int right) const
+{
+    if (left > right)
+    {
+        std::swap(left, right);
+    }
+    if (right > m_length)
+    {
+        right = m_length;
+    }
+    if (left >= right)
+    {
+        return String();
+    }
+    return String(m_buffer + left, right - left);
+}
+
+void String::assign(const char* text, size_t length)
+{
+    if (!reserve(length))
+    {
+        return;
+    }
+    memmove(m_buffer, text, length);
+    m_length = length;
+    m_buffer[m_length] = '\0';
+}
+
+String operator+(const String& left, const String& right)
+{
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const String& left, const char* right)
+{
+    String result(left);
+    result += right;
+    return result;
+}
+
+String operator+(const char* left, const String& right)
+{
+    String result(left);
+    result += right;
+    return result;
+}
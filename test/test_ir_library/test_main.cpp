@@ -0,0 +1,224 @@
+// The code library on the in-memory SPIFFS: replacing codes, a full partition and resets in the
+// middle of a compaction. A new IrLibrary on the same files plays a reboot.
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <SPIFFS.h>
+#include <log.h>
+#include <fnv_hash.h>
+#include <service_ir.h>
+#include <ir_library.h>
+#include <memory>
+#include <string>
+
+static const char* kPath = "/ircodes.bin";
+static const char* kTempPath = "/ircodes.tmp";
+
+class IrLibraryTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        Log::init();
+    }
+
+    void SetUp() override
+    {
+        SPIFFS.reset();
+        reboot();
+    }
+
+    void TearDown() override
+    {
+        SPIFFS.failWritesAfter(-1);
+        SPIFFS.failRenames(false);
+    }
+
+    // a fresh library on the files the last one left
+    bool reboot()
+    {
+        m_library.reset(new IrLibrary());
+        return m_library->init();
+    }
+
+    static InfraredService::IrCommand hex(uint64_t value)
+    {
+        InfraredService::IrCommand command = {};
+        command.type = InfraredService::IrCommand::TYPE_HEX;
+        command.protocol = NEC;
+        command.bits = 32;
+        command.value = value;
+        return command;
+    }
+
+    uint64_t loadValue(uint32_t id)
+    {
+        InfraredService::IrCommand command = {};
+        return m_library->load(id, command) ? command.value : 0;
+    }
+
+    std::unique_ptr<IrLibrary> m_library;
+};
+
+TEST_F(IrLibraryTest, ReplacedCodeWinsAfterReboot)
+{
+    InfraredService::IrCommand first = hex(0x20DF10EF);
+    InfraredService::IrCommand second = hex(0x20DF40BF);
+
+    EXPECT_EQ(m_library->store(5, "power", first), 5u);
+    EXPECT_EQ(m_library->store(5, "power", second), 5u);
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(loadValue(5), 0x20DF40BFu);
+
+    ASSERT_TRUE(reboot());
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(loadValue(5), 0x20DF40BFu);
+    EXPECT_EQ(m_library->findByName("power"), 5u);
+}
+
+TEST_F(IrLibraryTest, SameNameReplacesCode)
+{
+    InfraredService::IrCommand first = hex(0x20DF10EF);
+    InfraredService::IrCommand second = hex(0x20DF40BF);
+    InfraredService::IrCommand third = hex(0x20DF906F);
+
+    uint32_t id = m_library->store(0, "power", first);
+    ASSERT_NE(id, 0u);
+    EXPECT_EQ(m_library->store(0, "power", second), id);
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(m_library->findByName("power"), id);
+    EXPECT_EQ(loadValue(id), 0x20DF40BFu);
+
+    // another id can't take the name
+    EXPECT_EQ(m_library->store(id + 1, "power", third), 0u);
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(loadValue(m_library->findByName("power")), 0x20DF40BFu);
+
+    // codes without a name don't clash
+    EXPECT_NE(m_library->store(0, "", first), 0u);
+    EXPECT_NE(m_library->store(0, "", third), 0u);
+    EXPECT_EQ(m_library->count(), 3u);
+
+    ASSERT_TRUE(reboot());
+    EXPECT_EQ(m_library->findByName("power"), id);
+    EXPECT_EQ(loadValue(id), 0x20DF40BFu);
+}
+
+TEST_F(IrLibraryTest, FailedReplaceKeepsOldCode)
+{
+    InfraredService::IrCommand first = hex(0x20DF10EF);
+    InfraredService::IrCommand second = hex(0x20DF40BF);
+    ASSERT_EQ(m_library->store(5, "power", first), 5u);
+
+    // the partition fills up halfway through the new record
+    SPIFFS.failWritesAfter(8);
+    EXPECT_EQ(m_library->store(5, "power", second), 0u);
+    EXPECT_EQ(loadValue(5), 0x20DF10EFu);
+
+    SPIFFS.failWritesAfter(-1);
+    ASSERT_TRUE(reboot());
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(loadValue(5), 0x20DF10EFu);
+}
+
+TEST_F(IrLibraryTest, UnfinishedCompactionIsPromoted)
+{
+    InfraredService::IrCommand command = hex(0x20DF10EF);
+    ASSERT_EQ(m_library->store(1, "one", command), 1u);
+    ASSERT_EQ(m_library->store(2, "two", command), 2u);
+
+    // reset after the old file was removed, before the rename
+    SPIFFS.setContents(kTempPath, SPIFFS.contents(kPath));
+    SPIFFS.remove(kPath);
+
+    ASSERT_TRUE(reboot());
+    EXPECT_EQ(m_library->count(), 2u);
+    EXPECT_EQ(loadValue(2), 0x20DF10EFu);
+    EXPECT_TRUE(SPIFFS.exists(kPath));
+    EXPECT_FALSE(SPIFFS.exists(kTempPath));
+}
+
+TEST_F(IrLibraryTest, PartialCompactionIsDropped)
+{
+    InfraredService::IrCommand command = hex(0x20DF10EF);
+    ASSERT_EQ(m_library->store(1, "one", command), 1u);
+
+    // reset while the new file was being written
+    std::vector<uint8_t> partial = SPIFFS.contents(kPath);
+    partial.resize(partial.size() / 2);
+    SPIFFS.setContents(kTempPath, partial);
+
+    ASSERT_TRUE(reboot());
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(loadValue(1), 0x20DF10EFu);
+    EXPECT_FALSE(SPIFFS.exists(kTempPath));
+}
+
+TEST_F(IrLibraryTest, FailedRenameKeepsCodesForNextBoot)
+{
+    InfraredService::IrCommand command = hex(0x20DF10EF);
+    ASSERT_EQ(m_library->store(1, "one", command), 1u);
+    ASSERT_EQ(m_library->store(2, "two", command), 2u);
+
+    SPIFFS.failRenames(true);
+    EXPECT_FALSE(m_library->remove(1));
+    // no writes on top of a file system in that state
+    EXPECT_EQ(m_library->store(3, "three", command), 0u);
+
+    SPIFFS.failRenames(false);
+    ASSERT_TRUE(reboot());
+    EXPECT_EQ(m_library->count(), 1u);
+    EXPECT_EQ(loadValue(2), 0x20DF10EFu);
+}
+
+TEST_F(IrLibraryTest, LongNamesAreRejected)
+{
+    InfraredService::IrCommand command = hex(0x20DF10EF);
+    std::string name(IrLibrary::kMaxNameLength, 'x');
+
+    EXPECT_EQ(m_library->store(1, name.c_str(), command), 1u);
+    EXPECT_EQ(m_library->findByName(name.c_str()), 1u);
+
+    name += 'x';
+    EXPECT_EQ(m_library->store(2, name.c_str(), command), 0u);
+    EXPECT_EQ(m_library->count(), 1u);
+}
+
+TEST_F(IrLibraryTest, RawCodeWithOnceCountBeyondCountIsRejected)
+{
+    InfraredService::IrCommand command = {};
+    command.type = InfraredService::IrCommand::TYPE_RAW;
+    command.frequency = 38000;
+    command.count = 4;
+    command.onceCount = 4;
+    for (uint16_t i = 0; i < command.count; i++)
+    {
+        command.words[i] = 560;
+    }
+    ASSERT_EQ(m_library->store(1, "valid", command), 1u);
+
+    command.onceCount = 5;
+    ASSERT_EQ(m_library->store(2, "broken", command), 2u);
+
+    InfraredService::IrCommand loaded = {};
+    EXPECT_TRUE(m_library->load(1, loaded));
+    EXPECT_EQ(loaded.onceCount, 4u);
+    EXPECT_FALSE(m_library->load(2, loaded));
+}
+
+TEST(FnvHash, FormsAgree)
+{
+    static_assert(fnvHash("") == 2166136261u, "offset basis");
+    static_assert(fnvHash("a") == 0xE40C292Cu, "FNV-1a test vector");
+
+    const char* name = "ir_send_batch";
+    EXPECT_EQ(fnvHash(name, strlen(name)), fnvHash("ir_send_batch"));
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef LEGACY_PARSER_H
+#define LEGACY_PARSER_H
+
+// InfraredService::parseCode as it was before the single pass parser, the baseline for the
+// benchmark. Kept as it was apart from being a free function: one String per field and pronto
+// word, bad input read as zeros, no bound on the words written beyond the off-by-one count.
+
+#include <Arduino.h>
+#include <ctype.h>
+#include <service_ir.h>
+
+namespace Legacy {
+
+inline uint64_t getUInt64fromHex(char const *str) {
+  uint64_t result = 0;
+  uint16_t offset = 0;
+  // Skip any leading '0x' or '0X' prefix.
+  if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) offset = 2;
+  for (; isxdigit((unsigned char)str[offset]); offset++) {
+    char c = str[offset];
+    result *= 16;
+    if (isdigit(c))
+      result += c - '0';  // '0' .. '9'
+    else if (isupper(c))
+      result += c - 'A' + 10;  // 'A' .. 'F'
+    else
+      result += c - 'a' + 10;  // 'a' .. 'f'
+  }
+  return result;
+}
+
+inline uint16_t countValuesInStr(const String str, char sep) {
+  int16_t index = -1;
+  uint16_t count = 1;
+  do {
+    index = str.indexOf(sep, index + 1);
+    count++;
+  } while (index != -1);
+  return count;
+}
+
+inline bool parseCode(const char* code, const char* format, InfraredService::IrCommand& command)
+{
+    if (code == nullptr || format == nullptr) {
+        return false;
+    }
+
+    // Format is: "<protocol>,<hex-ir-code>,<bits>,<repeat-count>" e.g. "4,0x640C,15,0"
+    const String message = code;
+    const int firstIndex = message.indexOf(';');
+    const int secondIndex =  message.indexOf(';', firstIndex + 1);
+    const int thirdIndex = message.indexOf(';', secondIndex + 1);
+
+    command.protocol = static_cast<decode_type_t>(message.substring(0, firstIndex).toInt());
+    String commandStr = message.substring(firstIndex + 1, secondIndex).c_str();
+    command.value = getUInt64fromHex(commandStr.c_str());
+    command.bits = message.substring(secondIndex + 1, thirdIndex).toInt();
+    command.repeat = message.substring(thirdIndex + 1).toInt();
+
+    if (strcmp(format, "hex") == 0) {
+        command.type = InfraredService::IrCommand::TYPE_HEX;
+        return true;
+    }
+
+    command.type = InfraredService::IrCommand::TYPE_PRONTO;
+
+    if (countValuesInStr(commandStr, ',') > InfraredService::kMaxCodeWords + 1) {
+        return false;
+    }
+
+    int16_t index = -1;
+    uint16_t start_from = 0;
+    uint16_t count = 0;
+
+    do {
+        index = commandStr.indexOf(',', start_from);
+        command.words[count] = strtoul(commandStr.substring(start_from, index).c_str(),  NULL, 16);
+        start_from = index + 1;
+        count++;
+    } while (index != -1);
+
+    command.count = count;
+    return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,206 @@
+// InfraredService::parseCode: the single pass parser against the String based one it replaced,
+// and random input that must never write past the words buffer.
+//   platformio test -e native -f test_ir_parse -v
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <service_ir.h>
+#include <random>
+#include <string>
+#include "legacy_parser.h"
+
+static InfraredService* ir;
+
+// an NEC pronto code, 34 once pairs and 2 repeat pairs
+static std::string prontoCode(char separator)
+{
+    static const char* kHeader[] = { "0000", "006D", "0022", "0002", "0157", "00AC" };
+    std::string code;
+    for (const char* word : kHeader)
+    {
+        code += word;
+        code += separator;
+    }
+    for (uint16_t i = 0; i < 32; i++)
+    {
+        code += "0015";
+        code += separator;
+        code += (0x20DF10EF >> (31 - i)) & 1 ? "0040" : "0015";
+        code += separator;
+    }
+    code += "0015";
+    code += separator;
+    code += "0689";
+    code += separator;
+    code += "0157";
+    code += separator;
+    code += "0056";
+    code += separator;
+    code += "0015";
+    code += separator;
+    code += "0E94";
+    return code;
+}
+
+// a command with a guard area behind the words buffer
+struct GuardedCommand {
+    static const uint8_t        kGuard = 0xA5;
+
+    InfraredService::IrCommand  command;
+    uint8_t                     guard[64];
+
+    GuardedCommand()
+    {
+        memset(&command, 0, sizeof(command));
+        memset(guard, kGuard, sizeof(guard));
+    }
+
+    bool intact() const
+    {
+        for (uint8_t byte : guard)
+        {
+            if (byte != kGuard)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+class IrParseTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        ir = new InfraredService();
+    }
+};
+
+TEST_F(IrParseTest, AgreesWithLegacyParser)
+{
+    const struct {
+        const char*     code;
+        const char*     format;
+    } cases[] = {
+        { "3;0x20DF10EF;32;0",      "hex" },
+        { "3;20DF10EF;32;2",        "hex" },
+        { "4;0x640C;15;0",          "hex" },
+        { "16;0xFFFFFFFFFFFFFFFF;64;1", "hex" },
+    };
+    std::string pronto = "0;" + prontoCode(',') + ";0;1";
+
+    for (const auto& c : cases)
+    {
+        GuardedCommand legacy;
+        GuardedCommand current;
+        ASSERT_TRUE(Legacy::parseCode(c.code, c.format, legacy.command)) << c.code;
+        ASSERT_EQ(ir->parseCode(c.code, c.format, current.command), InfraredService::PARSE_OK) << c.code;
+        EXPECT_EQ(current.command.protocol, legacy.command.protocol) << c.code;
+        EXPECT_EQ(current.command.value, legacy.command.value) << c.code;
+        EXPECT_EQ(current.command.bits, legacy.command.bits) << c.code;
+        EXPECT_EQ(current.command.repeat, legacy.command.repeat) << c.code;
+    }
+
+    GuardedCommand legacy;
+    GuardedCommand current;
+    ASSERT_TRUE(Legacy::parseCode(pronto.c_str(), "pronto", legacy.command));
+    ASSERT_EQ(ir->parseCode(pronto.c_str(), "pronto", current.command), InfraredService::PARSE_OK);
+    ASSERT_EQ(current.command.count, legacy.command.count);
+    EXPECT_EQ(memcmp(current.command.words, legacy.command.words, current.command.count * sizeof(uint16_t)), 0);
+    EXPECT_EQ(current.command.repeat, legacy.command.repeat);
+}
+
+TEST_F(IrParseTest, BenchmarkAgainstLegacyParser)
+{
+    const char* hex = "3;0x20DF10EF;32;0";
+    // the legacy parser only splits pronto words at commas
+    std::string pronto = "0;" + prontoCode(',') + ";0;0";
+    GuardedCommand command;
+
+    Native::bench("parse hex legacy", 100000, [&] { Legacy::parseCode(hex, "hex", command.command); });
+    Native::bench("parse hex", 100000, [&] { ir->parseCode(hex, "hex", command.command); });
+    Native::bench("parse pronto legacy", 20000, [&] { Legacy::parseCode(pronto.c_str(), "pronto", command.command); });
+    Native::bench("parse pronto", 20000, [&] { ir->parseCode(pronto.c_str(), "pronto", command.command); });
+
+    Native::Heap before = Native::heap();
+    ir->parseCode(pronto.c_str(), "pronto", command.command);
+    EXPECT_EQ(Native::heap().allocations, before.allocations);
+    EXPECT_TRUE(command.intact());
+}
+
+TEST_F(IrParseTest, CodeBeyondBufferIsRejected)
+{
+    std::string code = "0;";
+    for (uint16_t i = 0; i <= InfraredService::kMaxCodeWords; i++)
+    {
+        code += i > 0 ? ",0015" : "0000";
+    }
+
+    GuardedCommand command;
+    EXPECT_EQ(ir->parseCode(code.c_str(), "pronto", command.command), InfraredService::PARSE_TOO_LONG);
+    EXPECT_TRUE(command.intact());
+}
+
+// random and mutated codes, with a fixed seed so a failure can be replayed
+TEST_F(IrParseTest, Fuzz)
+{
+    static const uint32_t kIterations = 200000;
+    static const char kAlphabet[] = "0123456789abcdefABCDEFxX;, -+\t";
+
+    std::mt19937 random(0x59494F);
+    const std::string seeds[] = {
+        "3;0x20DF10EF;32;0",
+        "0;" + prontoCode(',') + ";0;1",
+        prontoCode(' '),
+    };
+
+    for (uint32_t i = 0; i < kIterations; i++)
+    {
+        std::string code;
+        if (random() % 2)
+        {
+            size_t length = random() % (InfraredService::kMaxCodeWords * 6);
+            for (size_t j = 0; j < length; j++)
+            {
+                code += random() % 16 ? kAlphabet[random() % (sizeof(kAlphabet) - 1)]
+                                      : static_cast<char>(1 + random() % 255);
+            }
+        }
+        else
+        {
+            code = seeds[random() % 3];
+            for (uint32_t edits = 1 + random() % 8; edits > 0 && !code.empty(); edits--)
+            {
+                size_t at = random() % code.size();
+                switch (random() % 4)
+                {
+                    case 0: code[at] = kAlphabet[random() % (sizeof(kAlphabet) - 1)]; break;
+                    case 1: code.erase(at, 1 + random() % 8); break;
+                    case 2: code.insert(at, code.substr(random() % code.size(), random() % 64)); break;
+                    case 3: code.resize(at); break;
+                }
+            }
+        }
+
+        const char* format = random() % 2 ? "pronto" : "hex";
+        GuardedCommand command;
+        InfraredService::ParseResult result = ir->parseCode(code.c_str(), format, command.command);
+
+        ASSERT_TRUE(command.intact()) << format << " \"" << code << "\"";
+        ASSERT_LE(result, InfraredService::PARSE_TRAILING_DATA);
+        if (result == InfraredService::PARSE_OK && command.command.type == InfraredService::IrCommand::TYPE_PRONTO)
+        {
+            ASSERT_GT(command.command.count, 0u) << code;
+            ASSERT_LE(command.command.count, static_cast<uint16_t>(InfraredService::kMaxCodeWords)) << code;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
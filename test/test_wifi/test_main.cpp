@@ -0,0 +1,156 @@
+// WifiService against the scripted station: when attempts start, how long they are left
+// running and how the delay between them grows. handleReconnect() runs once a second, like
+// the wifiCheck timer makes it.
+
+#include <gtest/gtest.h>
+#include <native.h>
+#include <WiFi.h>
+#include <config.h>
+#include <state.h>
+#include <events.h>
+#include <log.h>
+#include <service_wifi.h>
+#include <memory>
+
+class WifiTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        Log::init();
+        Events::init();
+        new Config();
+        new State();
+        Config::getInstance()->setWifiSsid("home");
+        Config::getInstance()->setWifiPassword("secret");
+    }
+
+    void SetUp() override
+    {
+        WiFi.reset();
+        m_wifi.reset(new WifiService());
+        m_wifi->initiateWifi();
+    }
+
+    // seconds of wifiCheck ticks
+    void run(uint32_t seconds)
+    {
+        for (uint32_t i = 0; i < seconds; i++)
+        {
+            Native::advance(1000);
+            m_wifi->handleReconnect();
+        }
+    }
+
+    // the event wakes the main loop right away
+    void fail()
+    {
+        WiFi.failAttempt();
+        m_wifi->handleReconnect();
+    }
+
+    void connect()
+    {
+        WiFi.connectAttempt();
+        m_wifi->handleReconnect();
+        ASSERT_TRUE(m_wifi->isConnected());
+    }
+
+    std::unique_ptr<WifiService> m_wifi;
+};
+
+TEST_F(WifiTest, RunningAttemptIsLeftAlone)
+{
+    ASSERT_TRUE(WiFi.attempting());
+    uint32_t disconnects = WiFi.disconnects();
+
+    run(14);
+    EXPECT_TRUE(WiFi.attempting());
+    EXPECT_EQ(WiFi.begins(), 1u);
+    EXPECT_EQ(WiFi.disconnects(), disconnects);
+
+    // a slow association still gets through
+    connect();
+    EXPECT_EQ(WiFi.begins(), 1u);
+}
+
+TEST_F(WifiTest, AttemptIsGivenUpAfterTimeout)
+{
+    uint32_t disconnects = WiFi.disconnects();
+
+    run(15);
+    EXPECT_FALSE(WiFi.attempting());
+    EXPECT_EQ(WiFi.disconnects(), disconnects + 1);
+
+    // the backoff starts at the timeout
+    run(4);
+    EXPECT_EQ(WiFi.begins(), 1u);
+    run(1);
+    EXPECT_EQ(WiFi.begins(), 2u);
+    EXPECT_TRUE(WiFi.attempting());
+}
+
+TEST_F(WifiTest, BackoffGrowsFromEachFailure)
+{
+    const uint32_t delays[] = { 5, 10, 20, 40, 60, 60 };
+
+    for (uint32_t delay : delays)
+    {
+        uint32_t begins = WiFi.begins();
+        fail();
+        run(delay - 1);
+        EXPECT_EQ(WiFi.begins(), begins) << delay;
+        run(1);
+        EXPECT_EQ(WiFi.begins(), begins + 1) << delay;
+    }
+}
+
+TEST_F(WifiTest, DropRetriesCachedAccessPointFirst)
+{
+    connect();
+    uint32_t begins = WiFi.begins();
+
+    WiFi.dropConnection();
+    m_wifi->handleReconnect();
+    EXPECT_FALSE(m_wifi->isConnected());
+    EXPECT_EQ(WiFi.begins(), begins + 1);
+    EXPECT_EQ(WiFi.lastAttempt().channel, 6);
+    EXPECT_TRUE(WiFi.lastAttempt().bssid);
+    // the lease is only reused when built with WIFI_REUSE_LEASE
+    EXPECT_EQ(WiFi.lastAttempt().staticIP, WIFI_REUSE_LEASE != 0);
+
+    // the cached access point is gone, the next attempt scans after the first delay
+    fail();
+    run(4);
+    EXPECT_EQ(WiFi.begins(), begins + 1);
+    run(1);
+    EXPECT_EQ(WiFi.begins(), begins + 2);
+    EXPECT_EQ(WiFi.lastAttempt().channel, 0);
+
+    WiFi.connectAttempt(11);
+    m_wifi->handleReconnect();
+    EXPECT_TRUE(m_wifi->isConnected());
+    EXPECT_EQ(m_wifi->reconnects(), 1u);
+    EXPECT_TRUE(WiFi.usesDhcp());
+}
+
+TEST_F(WifiTest, FastReconnectEndsOnDhcp)
+{
+    connect();
+    WiFi.dropConnection();
+    m_wifi->handleReconnect();
+
+    connect();
+    EXPECT_EQ(m_wifi->reconnects(), 1u);
+    EXPECT_EQ(WiFi.begins(), 2u);
+    // a reused lease only bridges the reconnect
+    EXPECT_TRUE(WiFi.usesDhcp());
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    // PlatformIO reads the results from the output, the exit code stays zero
+    if (RUN_ALL_TESTS()) {}
+    return 0;
+}
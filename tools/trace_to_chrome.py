@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Turns a dock trace dump into a Chrome trace for chrome://tracing or ui.perfetto.dev.
+
+The input is the binary message a websocket client gets after trace_dump, or the
+trace_dump reply of the serial port with the dump as hex in "data".
+
+    trace_to_chrome.py dump.bin > trace.json
+
+Each task that recorded is a thread of its own, the core it ran on is in the args.
+"""
+
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<cBBBHHI")
+ENTRY = struct.Struct("<IBBHI")
+TASK_NAME_SIZE = 16
+
+SOURCES = ["websocket", "serial", "bluetooth"]
+STATES = ["setup", "connecting", "conn_success", "normal", "normal_charging",
+          "error", "led_setup", "normal_fullycharged", "normal_lowbattery"]
+# the dock command table, traced by the FNV-1a hash of the name
+COMMANDS = ["ping", "led_brightness_start", "led_brightness_stop", "ir_send", "ir_send_batch",
+            "ir_send_id", "ir_send_raw", "ir_store", "ir_delete", "ir_list", "ir_receive_on",
+            "ir_receive_off", "ir_receive_raw", "ir_learn_start", "ir_learn_cancel",
+            "remote_charged", "remote_lowbattery", "set_friendly_name", "reboot", "reset",
+            "set_protocol", "config_stats", "get_state", "client_stats", "stats", "trace_dump"]
+
+
+def api_hash(name):
+    value = 2166136261
+    for byte in name.encode():
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+COMMAND_NAMES = {api_hash(name): name for name in COMMANDS}
+
+
+def name_of(names, index):
+    return names[index] if 0 <= index < len(names) else str(index)
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:1] != b"T":
+        text = data.decode().strip()
+        if text.startswith("{"):
+            text = json.loads(text)["data"]
+        data = bytes.fromhex(text)
+    return data
+
+
+def decode(data):
+    magic, version, entry_size, tasks, count, total, now = HEADER.unpack_from(data)
+    if magic != b"T" or version != 2 or entry_size != ENTRY.size:
+        raise ValueError("not a version 2 dock trace")
+
+    entries = []
+    offset = HEADER.size
+    for _ in range(count):
+        if offset + ENTRY.size > len(data):
+            break
+        entries.append(ENTRY.unpack_from(data, offset))
+        offset += ENTRY.size
+
+    names = []
+    for _ in range(tasks):
+        name = data[offset:offset + TASK_NAME_SIZE].split(b"\0")[0]
+        names.append(name.decode(errors="replace"))
+        offset += TASK_NAME_SIZE
+    return entries, names, total, now
+
+
+def to_chrome(entries, names):
+    events = []
+    base = None
+    last = None
+    wraps = 0
+    for time, event, task, arg, value in entries:
+        # the dock keeps 32 bits of microseconds, they wrap every 71 minutes
+        if last is not None and time < last and last - time > 1 << 31:
+            wraps += 1
+        last = time
+        ts = time + (wraps << 32)
+        if base is None:
+            base = ts
+
+        # slices nest per task, tasks on the same core interleave
+        common = {"ts": ts - base, "pid": 0, "tid": task & 0x7F}
+        core = task >> 7
+        if event == 1:
+            events.append(dict(common, ph="i", s="t", name="ingress",
+                               args={"source": name_of(SOURCES, arg), "length": value, "core": core}))
+        elif event in (2, 3):
+            events.append(dict(common, ph="B" if event == 2 else "E",
+                               name=COMMAND_NAMES.get(value, hex(value)), cat="api", args={"core": core}))
+        elif event in (4, 5):
+            args = {"req_id": value, "core": core}
+            if event == 5:
+                args["success"] = bool(arg)
+            events.append(dict(common, ph="B" if event == 4 else "E", name="ir_send", cat="ir", args=args))
+        elif event == 6:
+            events.append(dict(common, ph="i", s="t", name="ir_decode",
+                               args={"protocol": value, "bits": arg, "core": core}))
+        elif event == 7:
+            events.append(dict(common, ph="i", s="g", name="wifi", args={"event": arg, "core": core}))
+        elif event == 8:
+            events.append(dict(common, ph="i", s="g", name="state",
+                               args={"from": name_of(STATES, arg), "to": name_of(STATES, value), "core": core}))
+        elif event == 9:
+            events.append(dict(common, ph="i", s="g", name="mdns_restart",
+                               args={"success": bool(arg), "core": core}))
+        # anything else is a slot torn by a write during the dump
+
+    for tid in sorted({e["tid"] for e in events}):
+        name = names[tid] if tid < len(names) and names[tid] else "task %d" % tid
+        events.append({"ph": "M", "pid": 0, "tid": tid, "name": "thread_name", "args": {"name": name}})
+    return events
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    entries, names, total, _ = decode(load(sys.argv[1]))
+    if total > len(entries):
+        print("%d older events were overwritten" % (total - len(entries)), file=sys.stderr)
+    json.dump({"traceEvents": to_chrome(entries, names), "displayTimeUnit": "ms"}, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()